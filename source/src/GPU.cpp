@@ -222,6 +222,8 @@ void GPU_Reset(GPU *g, u8 l)
 
 	g->bg0HasHighestPrio = TRUE;
 
+	g->lineProgramDirty = true;
+
 	if(g->core == GPU_SUB)
 	{
 		g->oam = (OAM *)(MMU.ARM9_OAM + ADDRESS_STEP_1KB);
@@ -290,6 +292,8 @@ static void GPU_resortBGs(GPU *gpu)
 			}
 		}
 	}
+
+	gpu->lineProgramDirty = true;
 	
 #if 0
 //debug
@@ -340,7 +344,9 @@ void SetupFinalPixelBlitter (GPU *gpu)
 	gpu->setFinalColorSpr_funcNum = winUsedBlend;
 	gpu->setFinalColorBck_funcNum = winUsedBlend;
 	gpu->setFinalColor3d_funcNum  = winUsedBlend;
-	
+
+	//the blend targets are resolved in the line program
+	gpu->lineProgramDirty = true;
 }
     
 //Sets up LCD control variables for Display Engines A and B for quick reading
@@ -503,67 +509,43 @@ void GPU_addBack(GPU * gpu, u8 num)
 //		ROUTINES FOR INSIDE / OUTSIDE WINDOW CHECKS
 /*****************************************************************************/
 
-template<int WIN_NUM>
-FORCEINLINE u8 GPU::withinRect(u16 x) const
+//resolves the window priorities (win0, win1, obj window, outside) once for the whole line,
+//so the pixel routines only have to look up their layer's mask.
+//must run after the sprites, which produce the obj window
+void GPU::setup_windowMasks()
 {
-	assert(x<256); //only way to be >256 is in debug views, and mosaic shouldnt be enabled for those
-	return curr_win[WIN_NUM][x];
-}
-
-
+	//each control byte has the WINxCNT layout: a draw bit per layer, the effect enable in bit 5
+	const u8 in0 = WININ0 | (WININ0_SPECIAL ? 0x20 : 0);
+	const u8 in1 = WININ1 | (WININ1_SPECIAL ? 0x20 : 0);
+	const u8 obj = WINOBJ_ENABLED ? (WINOBJ | (WINOBJ_SPECIAL ? 0x20 : 0)) : 0xFF;
+	const u8 out = WINOUT | (WINOUT_SPECIAL ? 0x20 : 0);
 
-//  Now assumes that *draw and *effect are different from 0 when called, so we can avoid
-// setting some values twice
-FORCEINLINE void GPU::renderline_checkWindows(u16 x, bool &draw, bool &effect) const
-{
-	// Check if win0 if enabled, and only check if it is
-	// howevever, this has already been taken care of by the window precalculation
-	//if (WIN0_ENABLED)
+	u8 all = 0x3F, any = 0;
+	for(int x = 0; x < 256; x++)
 	{
-		// it is in win0, do we display ?
-		// high priority	
-		if (withinRect<0>(x))
-		{
-			//INFO("bg%i passed win0 : (%i %i) was within (%i %i)(%i %i)\n", bgnum, x, gpu->currLine, gpu->WIN0H0, gpu->WIN0V0, gpu->WIN0H1, gpu->WIN0V1);
-			draw = (WININ0 >> currBgNum)&1;
-			effect = (WININ0_SPECIAL);
-			return;
-		}
-	}
-
-	// Check if win1 if enabled, and only check if it is
-	//if (WIN1_ENABLED)
-	// howevever, this has already been taken care of by the window precalculation
+		u8 ctl;
+		if(curr_win[0][x]) ctl = in0;
+		else if(curr_win[1][x]) ctl = in1;
+		else if(obj != 0xFF && sprWin[x]) ctl = obj;
+		else ctl = out;
+
+		all &= ctl;
+		any |= ctl;
+		windowDrawMask[0][x] = ctl & 1;
+		windowDrawMask[1][x] = (ctl >> 1) & 1;
+		windowDrawMask[2][x] = (ctl >> 2) & 1;
+		windowDrawMask[3][x] = (ctl >> 3) & 1;
+		windowDrawMask[4][x] = (ctl >> 4) & 1;
+		windowEffectMask[x] = (ctl >> 5) & 1;
+	}
+
+	for(int i = 0; i < 5; i++)
 	{
-		// it is in win1, do we display ?
-		// mid priority
-		if(withinRect<1>(x))
-		{
-			//INFO("bg%i passed win1 : (%i %i) was within (%i %i)(%i %i)\n", bgnum, x, gpu->currLine, gpu->WIN1H0, gpu->WIN1V0, gpu->WIN1H1, gpu->WIN1V1);
-			draw	= (WININ1 >> currBgNum)&1;
-			effect = (WININ1_SPECIAL);
-			return;
-		}
-	}
-
-	//if(true) //sprwin test hack
-	if (WINOBJ_ENABLED)
-	{
-		// it is in winOBJ, do we display ?
-		// low priority
-		if (sprWin[x])
-		{
-			draw	= (WINOBJ >> currBgNum)&1;
-			effect	= (WINOBJ_SPECIAL);
-			return;
-		}
-	}
-
-	if (WINOBJ_ENABLED | WIN1_ENABLED | WIN0_ENABLED)
-	{
-		draw	= (WINOUT >> currBgNum) & 1;
-		effect	= (WINOUT_SPECIAL);
+		windowDrawAny[i] = (any >> i) & 1;
+		windowDrawAll[i] = (all >> i) & 1;
 	}
+	windowEffectAny = (any >> 5) & 1;
+	windowEffectAll = (all >> 5) & 1;
 }
 
 /*****************************************************************************/
@@ -603,11 +585,8 @@ FORCEINLINE FASTCALL void GPU::_master_setFinal3dColor(int l,int i16)
 
 		if(WINDOW)
 		{
-			bool windowDraw = false;
-			renderline_checkWindows(k, windowDraw, windowEffect);
-
-			//we never have anything more to do if the window rejected us
-			if(!windowDraw) return;
+			if(!windowDrawMask[0][k]) continue;
+			windowEffect = blend1 && windowEffectMask[k];
 		}
 
 		bg_under = bgPixels[k];
@@ -657,14 +636,12 @@ FORCEINLINE FASTCALL bool GPU::_master_setFinalBGColor(u16 &color, const u32 x,
 	bool windowEffect = true;
 
 	if(WINDOW){
-		bool windowDraw = false;
-		renderline_checkWindows(x, windowDraw, windowEffect);
+		assert(x<256); //only way to be >256 is in debug views, and windows shouldnt be enabled for those
 
 		//backdrop must always be drawn
-		if(BACKDROP) windowDraw = true;
-
 		//we never have anything more to do if the window rejected us
-		if(!windowDraw) return false;
+		if(!BACKDROP && !windowDrawMask[currBgNum][x]) return false;
+		windowEffect = windowEffectMask[x];
 	}
 
 	//special effects rejected. just draw it.
@@ -692,7 +669,8 @@ FORCEINLINE FASTCALL void GPU::_master_setFinalOBJColor(u16 color, u8 alpha, u8
 
 	if(WINDOW)
 	{
-		renderline_checkWindows(x, windowDraw, windowEffect);
+		windowDraw = windowDrawMask[4][x];
+		windowEffect = windowEffectMask[x];
 		if(!windowDraw)
 			return;
 	}
@@ -1115,9 +1093,138 @@ template<bool MOSAIC> FORCEINLINE void rot_BMP_map(GPU * gpu, s32 auxX, s32 auxY
 	gpu->__setFinalColorBck<MOSAIC,false>(color, i, color&0x8000);
 }
 
+//the line routines below draw count pixels of a single row of the layer, starting at (auxX,auxY)
+//and at screen position i, for the unrotated and unscaled case. the caller has already clipped or
+//wrapped the run so that it stays inside the layer. vram is resolved once per tile or per 16KB page
+//instead of once per pixel
+
+template<bool MOSAIC> FORCEINLINE void rot_tiled_8bit_line(GPU * gpu, s32 auxX, s32 auxY, int lg, u32 map, u32 tile, u8 * pal, int i, int count) {
+	const u32 maprow = map + (auxY>>3) * (lg>>3);
+	const u32 y = auxY&7;
+	while(count > 0)
+	{
+		const u16 tileindex = *(u8*)MMU_gpu_map(maprow + (auxX>>3));
+		//the 8 pixels of a tile row never cross a page
+		const u8 *src = (u8*)MMU_gpu_map(tile + (tileindex<<6) + (y<<3));
+		int x = auxX&7;
+		const int n = std::min(count, 8 - x);
+		for(int k = 0; k < n; k++, x++, i++)
+		{
+			const u8 palette_entry = src[x];
+			gpu->__setFinalColorBck<MOSAIC,false>(T1ReadWord(pal, palette_entry << 1), i, palette_entry);
+		}
+		auxX += n;
+		count -= n;
+	}
+}
+
+template<bool MOSAIC, bool extPal> FORCEINLINE void rot_tiled_16bit_line(GPU * gpu, s32 auxX, s32 auxY, int lg, u32 map, u32 tile, u8 * pal, int i, int count) {
+	const u32 maprow = map + (((auxY>>3) * (lg>>3))<<1);
+	while(count > 0)
+	{
+		TILEENTRY tileentry;
+		tileentry.val = T1ReadWord(MMU_gpu_map(maprow + ((auxX>>3)<<1)), 0);
+
+		const u16 y = ((tileentry.bits.VFlip) ? 7 - (auxY) : (auxY))&7;
+		const u8 *src = (u8*)MMU_gpu_map(tile + (tileentry.bits.TileNum<<6) + (y<<3));
+		u8 *tilepal = pal + (extPal ? (tileentry.bits.Palette<<9) : 0);
+		const int xor7 = tileentry.bits.HFlip ? 7 : 0;
+		int x = auxX&7;
+		const int n = std::min(count, 8 - x);
+		for(int k = 0; k < n; k++, x++, i++)
+		{
+			const u8 palette_entry = src[x^xor7];
+			gpu->__setFinalColorBck<MOSAIC,false>(T1ReadWord(tilepal, palette_entry << 1), i, palette_entry);
+		}
+		auxX += n;
+		count -= n;
+	}
+}
+
+template<bool MOSAIC> FORCEINLINE void rot_256_line(GPU * gpu, s32 auxX, s32 auxY, int lg, u32 map, u32 tile, u8 * pal, int i, int count) {
+	u32 adr = map + auxX + auxY * lg;
+	while(count > 0)
+	{
+		const u8 *src = (u8*)MMU_gpu_map(adr);
+		const int run = std::min<int>(count, 0x4000 - (adr & 0x3FFF));
+		int n = run;
+		for(; n >= 8; n -= 8, i += 8, src += 8)
+		{
+			for(int k = 0; k < 8; k++)
+				gpu->__setFinalColorBck<MOSAIC,false>(T1ReadWord(pal, src[k] << 1), i+k, src[k]);
+		}
+		for(; n > 0; n--, i++, src++)
+			gpu->__setFinalColorBck<MOSAIC,false>(T1ReadWord(pal, *src << 1), i, *src);
+		adr += run;
+		count -= run;
+	}
+}
+
+template<bool MOSAIC> FORCEINLINE void rot_BMP_line(GPU * gpu, s32 auxX, s32 auxY, int lg, u32 map, u32 tile, u8 * pal, int i, int count) {
+	u32 adr = map + ((auxX + auxY * lg) << 1);
+	while(count > 0)
+	{
+		const u8 *src = (u8*)MMU_gpu_map(adr);
+		const int run = std::min<int>(count, (0x4000 - (adr & 0x3FFF)) >> 1);
+		int n = run;
+		for(; n >= 8; n -= 8, i += 8, src += 16)
+		{
+			for(int k = 0; k < 8; k++)
+			{
+				const u16 color = T1ReadWord((u8*)src, k << 1);
+				gpu->__setFinalColorBck<MOSAIC,false>(color, i+k, color&0x8000);
+			}
+		}
+		for(; n > 0; n--, i++, src += 2)
+		{
+			const u16 color = T1ReadWord((u8*)src, 0);
+			gpu->__setFinalColorBck<MOSAIC,false>(color, i, color&0x8000);
+		}
+		adr += run << 1;
+		count -= run;
+	}
+}
+
 typedef void (*rot_fun)(GPU * gpu, s32 auxX, s32 auxY, int lg, u32 map, u32 tile, u8 * pal, int i);
+typedef void (*rot_line_fun)(GPU * gpu, s32 auxX, s32 auxY, int lg, u32 map, u32 tile, u8 * pal, int i, int count);
+
+//the reference points are 20.8 fixed point values in 28 bits
+static FORCEINLINE s32 rot_sext28(s32 val)
+{
+	return (s32)((u32)val << 4) >> 4;
+}
+
+static FORCEINLINE s64 rot_floordiv(s64 a, s64 b)
+{
+	return (a >= 0) ? a / b : -((-a + b - 1) / b);
+}
 
-template<rot_fun fun, bool WRAP>
+//narrows [start,end) to the pixels i whose coordinate base + i*d has its integer part in [0,size).
+//base is the sign extended reference point, d the per pixel step
+static FORCEINLINE void rot_span(s64 base, s64 d, s32 size, int &start, int &end)
+{
+	const s64 lim = (s64)size << 8;
+	s64 lo, hi;
+	if(d == 0)
+	{
+		if(base >= 0 && base < lim) return;
+		lo = hi = 0;
+	}
+	else if(d > 0)
+	{
+		lo = -rot_floordiv(base, d);
+		hi = -rot_floordiv(base - lim, d);
+	}
+	else
+	{
+		lo = rot_floordiv(base - lim, -d) + 1;
+		hi = rot_floordiv(base, -d) + 1;
+	}
+	if(lo > start) start = (int)std::min<s64>(lo, end);
+	if(hi < end) end = (int)std::max<s64>(hi, start);
+}
+
+template<rot_fun fun, rot_line_fun line, bool WRAP>
 FORCEINLINE void rot_scale_op(GPU * gpu, s32 X, s32 Y, s16 PA, s16 PB, s16 PC, s16 PD, u16 LG, s32 wh, s32 ht, u32 map, u32 tile, u8 * pal)
 {
 	ROTOCOORD x, y;
@@ -1128,42 +1235,71 @@ FORCEINLINE void rot_scale_op(GPU * gpu, s32 X, s32 Y, s16 PA, s16 PB, s16 PC, s
 	const s32 dy = (s32)PC;
 
 	// as an optimization, specially handle the fairly common case of
-	// "unrotated + unscaled + no boundary checking required"
+	// "unrotated + unscaled": the row goes to the line routine in runs which stay inside the layer
 	if(dx==0x100 && dy==0)
 	{
 		s32 auxX = x.bits.Integer;
 		s32 auxY = y.bits.Integer;
-		if(WRAP || (auxX + LG < wh && auxX >= 0 && auxY < ht && auxY >= 0))
+		if(WRAP)
 		{
-			if(WRAP)
+			auxY = auxY & (ht-1);
+			for(int i = 0; i < LG; )
 			{
-				auxY = auxY & (ht-1);
 				auxX = auxX & (wh-1);
+				const int count = std::min<int>(LG - i, wh - auxX);
+				line(gpu, auxX, auxY, wh, map, tile, pal, i, count);
+				i += count;
+				auxX += count;
 			}
-			for(int i = 0; i < LG; ++i)
-			{
-				fun(gpu, auxX, auxY, wh, map, tile, pal, i);
-				auxX++;
-				if(WRAP)
-					auxX = auxX & (wh-1);
-			}
-			return;
 		}
+		else if(auxY >= 0 && auxY < ht)
+		{
+			const int start = std::max<s32>(0, -auxX);
+			const int end = std::min<s32>(LG, wh - auxX);
+			if(start < end)
+				line(gpu, auxX + start, auxY, wh, map, tile, pal, start, end - start);
+		}
+		return;
 	}
-	
-	for(int i = 0; i < LG; ++i)
+
+	if(WRAP)
 	{
-		s32 auxX, auxY;
-		auxX = x.bits.Integer;
-		auxY = y.bits.Integer;
-	
-		if(WRAP)
+		for(int i = 0; i < LG; ++i)
 		{
-			auxX = auxX & (wh-1);
-			auxY = auxY & (ht-1);
+			fun(gpu, x.bits.Integer & (wh-1), y.bits.Integer & (ht-1), wh, map, tile, pal, i);
+			x.val += dx;
+			y.val += dy;
 		}
-		
-		if(WRAP || ((auxX >= 0) && (auxX < wh) && (auxY >= 0) && (auxY < ht)))
+		return;
+	}
+
+	//the pixels inside the layer are a single span, found up front so the loop needs no bounds checks.
+	//that only holds while the coordinates do not wrap around the 28 bits within the line
+	const s64 x0 = rot_sext28(X), y0 = rot_sext28(Y);
+	const s64 x1 = x0 + (s64)dx * (LG-1), y1 = y0 + (s64)dy * (LG-1);
+	const s64 lo = -(1<<27), hi = (1<<27);
+	if(x1 >= lo && x1 < hi && y1 >= lo && y1 < hi)
+	{
+		int start = 0, end = LG;
+		rot_span(x0, dx, wh, start, end);
+		rot_span(y0, dy, ht, start, end);
+
+		x.val += start * dx;
+		y.val += start * dy;
+		for(int i = start; i < end; ++i)
+		{
+			fun(gpu, x.bits.Integer, y.bits.Integer, wh, map, tile, pal, i);
+			x.val += dx;
+			y.val += dy;
+		}
+		return;
+	}
+	
+	for(int i = 0; i < LG; ++i)
+	{
+		const s32 auxX = x.bits.Integer;
+		const s32 auxY = y.bits.Integer;
+		if((auxX >= 0) && (auxX < wh) && (auxY >= 0) && (auxY < ht))
 			fun(gpu, auxX, auxY, wh, map, tile, pal, i);
 
 		x.val += dx;
@@ -1171,15 +1307,15 @@ FORCEINLINE void rot_scale_op(GPU * gpu, s32 X, s32 Y, s16 PA, s16 PB, s16 PC, s
 	}
 }
 
-template<rot_fun fun>
+template<rot_fun fun, rot_line_fun line>
 FORCEINLINE void apply_rot_fun(GPU * gpu, s32 X, s32 Y, s16 PA, s16 PB, s16 PC, s16 PD, u16 LG, u32 map, u32 tile, u8 * pal)
 {
 	struct _BGxCNT * bgCnt = &(gpu->dispx_st)->dispx_BGxCNT[gpu->currBgNum].bits;
 	s32 wh = gpu->BGSize[gpu->currBgNum][0];
 	s32 ht = gpu->BGSize[gpu->currBgNum][1];
 	if(bgCnt->PaletteSet_Wrap)
-		rot_scale_op<fun,true>(gpu, X, Y, PA, PB, PC, PD, LG, wh, ht, map, tile, pal);	
-	else rot_scale_op<fun,false>(gpu, X, Y, PA, PB, PC, PD, LG, wh, ht, map, tile, pal);	
+		rot_scale_op<fun,line,true>(gpu, X, Y, PA, PB, PC, PD, LG, wh, ht, map, tile, pal);	
+	else rot_scale_op<fun,line,false>(gpu, X, Y, PA, PB, PC, PD, LG, wh, ht, map, tile, pal);	
 }
 
 
@@ -1188,7 +1324,7 @@ template<bool MOSAIC> FORCEINLINE void rotBG2(GPU * gpu, s32 X, s32 Y, s16 PA, s
 	u8 num = gpu->currBgNum;
 	u8 * pal = MMU.ARM9_VMEM + gpu->core * 0x400;
 //	printf("rot mode\n");
-	apply_rot_fun<rot_tiled_8bit_entry<MOSAIC> >(gpu,X,Y,PA,PB,PC,PD,LG, gpu->BG_map_ram[num], gpu->BG_tile_ram[num], pal);
+	apply_rot_fun<rot_tiled_8bit_entry<MOSAIC>, rot_tiled_8bit_line<MOSAIC> >(gpu,X,Y,PA,PB,PC,PD,LG, gpu->BG_map_ram[num], gpu->BG_tile_ram[num], pal);
 }
 
 template<bool MOSAIC> FORCEINLINE void extRotBG2(GPU * gpu, s32 X, s32 Y, s16 PA, s16 PB, s16 PC, s16 PD, s16 LG)
@@ -1208,22 +1344,22 @@ template<bool MOSAIC> FORCEINLINE void extRotBG2(GPU * gpu, s32 X, s32 Y, s16 PA
 		if (!pal) return;
 		// 16  bit bgmap entries
 		if(dispCnt->ExBGxPalette_Enable)
-			apply_rot_fun<rot_tiled_16bit_entry<MOSAIC, true> >(gpu,X,Y,PA,PB,PC,PD,LG, gpu->BG_map_ram[num], gpu->BG_tile_ram[num], pal);
-		else apply_rot_fun<rot_tiled_16bit_entry<MOSAIC, false> >(gpu,X,Y,PA,PB,PC,PD,LG, gpu->BG_map_ram[num], gpu->BG_tile_ram[num], pal);
+			apply_rot_fun<rot_tiled_16bit_entry<MOSAIC, true>, rot_tiled_16bit_line<MOSAIC, true> >(gpu,X,Y,PA,PB,PC,PD,LG, gpu->BG_map_ram[num], gpu->BG_tile_ram[num], pal);
+		else apply_rot_fun<rot_tiled_16bit_entry<MOSAIC, false>, rot_tiled_16bit_line<MOSAIC, false> >(gpu,X,Y,PA,PB,PC,PD,LG, gpu->BG_map_ram[num], gpu->BG_tile_ram[num], pal);
 		return;
 	case BGType_AffineExt_256x1:
 		// 256 colors 
 		pal = MMU.ARM9_VMEM + gpu->core * 0x400;
-		apply_rot_fun<rot_256_map<MOSAIC> >(gpu,X,Y,PA,PB,PC,PD,LG, gpu->BG_bmp_ram[num], 0, pal);
+		apply_rot_fun<rot_256_map<MOSAIC>, rot_256_line<MOSAIC> >(gpu,X,Y,PA,PB,PC,PD,LG, gpu->BG_bmp_ram[num], 0, pal);
 		return;
 	case BGType_AffineExt_Direct:
 		// direct colors / BMP
-		apply_rot_fun<rot_BMP_map<MOSAIC> >(gpu,X,Y,PA,PB,PC,PD,LG, gpu->BG_bmp_ram[num], 0, NULL);
+		apply_rot_fun<rot_BMP_map<MOSAIC>, rot_BMP_line<MOSAIC> >(gpu,X,Y,PA,PB,PC,PD,LG, gpu->BG_bmp_ram[num], 0, NULL);
 		return;
 	case BGType_Large8bpp:
 		// large screen 256 colors
 		pal = MMU.ARM9_VMEM + gpu->core * 0x400;
-		apply_rot_fun<rot_256_map<MOSAIC> >(gpu,X,Y,PA,PB,PC,PD,LG, gpu->BG_bmp_large_ram[num], 0, pal);
+		apply_rot_fun<rot_256_map<MOSAIC>, rot_256_line<MOSAIC> >(gpu,X,Y,PA,PB,PC,PD,LG, gpu->BG_bmp_large_ram[num], 0, pal);
 		return;
 	default: break;
 	}
@@ -2039,6 +2175,8 @@ void GPU_set_DISPCAPCNT(u32 val)
 			break;
 	}
 
+	gpu->dispCapCnt.dirty = TRUE;
+
 	/*INFO("Capture 0x%X:\n EVA=%i, EVB=%i, wBlock=%i, wOffset=%i, capX=%i, capY=%i\n rBlock=%i, rOffset=%i, srcCap=%i, dst=0x%X, src=0x%X\n srcA=%i, srcB=%i\n\n",
 			val, gpu->dispCapCnt.EVA, gpu->dispCapCnt.EVB, gpu->dispCapCnt.writeBlock, gpu->dispCapCnt.writeOffset,
 			gpu->dispCapCnt.capx, gpu->dispCapCnt.capy, gpu->dispCapCnt.readBlock, gpu->dispCapCnt.readOffset, 
@@ -2046,6 +2184,96 @@ void GPU_set_DISPCAPCNT(u32 val)
 			gpu->dispCapCnt.srcA, gpu->dispCapCnt.srcB);*/
 }
 
+//picks the pixel routine for a layer on this line. when the window mask of the layer is uniform,
+//the unwindowed routine gives the same result without the per pixel lookups
+static FORCEINLINE int windowedFuncNum(GPU *gpu, int layer, int funcNum)
+{
+	if(funcNum < 4 || !gpu->windowDrawAll[layer]) return funcNum;
+	if(gpu->windowEffectAll) return funcNum & 3;
+	if(!gpu->windowEffectAny) return 0;
+	return funcNum;
+}
+
+//the line routine of a BG in the current mode, NULL when the mode has none for it
+template<bool MOSAIC> static void (*lineRoutine(BGType type))(GPU*)
+{
+	switch(type)
+	{
+		case BGType_Text: return lineText<MOSAIC>;
+		case BGType_Affine: return lineRot<MOSAIC>;
+		case BGType_AffineExt: return lineExtRot<MOSAIC>;
+		case BGType_Large8bpp: return lineExtRot<MOSAIC>;
+		default: return NULL;
+	}
+}
+
+void GPU::compileLineProgram()
+{
+	const _DISPCNT &cnt = dispCnt();
+	const bool BG_enabled = LayersEnable[0] || LayersEnable[1] || LayersEnable[2] || LayersEnable[3];
+
+	lineProgramDirty = false;
+	lineProgramLength = 0;
+
+	for(int j=0;j<8;j++)
+		blend2[j] = (BLDCNT & (0x100 << j))!=0;
+
+	// paint lower priorities first
+	// then higher priorities on top
+	for(int prio=NB_PRIORITIES; prio > 0; )
+	{
+		prio--;
+		const itemsForPriority_t &item = itemsForPriority[prio];
+
+		if (BG_enabled)
+		{
+			for (int i=0; i < item.nbBGs; i++)
+			{
+				const int layer = item.BGs[i];
+				if (!LayersEnable[layer]) continue;
+
+				LineStep &step = lineProgram[lineProgramLength];
+				step.layer = layer;
+				step.prio = prio;
+				step.blend1 = (BLDCNT & (1 << layer))!=0;
+				step.mosaic = bgcnt(layer).Mosaic_Enable;
+				step.is3D = core == GPU_MAIN && layer == 0 && cnt.BG0_3D;
+				step.render = NULL;
+
+				if (!step.is3D)
+				{
+					const BGType type = GPU_mode2type[cnt.BG_Mode][layer];
+#ifndef DISABLE_MOSAIC
+					if(step.mosaic)
+						step.render = lineRoutine<true>(type);
+					else 
+#endif
+						step.render = lineRoutine<false>(type);
+
+					if (!step.render)
+					{
+						PROGINFO("Attempting to render an invalid BG type\n");
+						continue;
+					}
+				}
+
+				lineProgramLength++;
+			}
+		}
+
+		if (LayersEnable[4])
+		{
+			LineStep &step = lineProgram[lineProgramLength++];
+			step.layer = 4;
+			step.prio = prio;
+			step.blend1 = (BLDCNT & (1 << 4))!=0;
+			step.mosaic = false;
+			step.is3D = false;
+			step.render = NULL;
+		}
+	}
+}
+
 static void GPU_RenderLine_layer(NDS_Screen * screen, u16 l)
 {
 	CACHE_ALIGN u8 spr[512];
@@ -2054,41 +2282,17 @@ static void GPU_RenderLine_layer(NDS_Screen * screen, u16 l)
 	CACHE_ALIGN u8 sprPrio[256];
 
 	GPU * gpu = screen->gpu;
-	struct _DISPCNT * dispCnt = &(gpu->dispx_st)->dispx_DISPCNT.bits;
 	itemsForPriority_t * item;
 	u16 i16;
-	BOOL BG_enabled  = TRUE;
+
+	if (gpu->lineProgramDirty)
+		gpu->compileLineProgram();
 
 	gpu->currentFadeInColors = &fadeInColors[gpu->BLDY_EVY][0];
 	gpu->currentFadeOutColors = &fadeOutColors[gpu->BLDY_EVY][0];
 
 	u16 backdrop_color = LE_TO_LOCAL_16(T1ReadWord(MMU.ARM9_VMEM, gpu->core * 0x400) & 0x7FFF);
 
-	//we need to write backdrop colors in the same way as we do BG pixels in order to do correct window processing
-	//this is currently eating up 2fps or so. it is a reasonable candidate for optimization. 
-	gpu->currBgNum = 5;
-	switch(gpu->setFinalColorBck_funcNum) {
-		case 0: case 1: //for backdrops, (even with window enabled) none and blend are both the same: just copy the color
-			memset_u16_le<256>(gpu->currDst,backdrop_color); 
-			break;
-		case 2:
-			//for non-windowed fade, we can just fade the color and fill
-			memset_u16_le<256>(gpu->currDst,gpu->currentFadeInColors[backdrop_color]);
-			break;
-		case 3:
-			//likewise for non-windowed fadeout
-			memset_u16_le<256>(gpu->currDst,gpu->currentFadeOutColors[backdrop_color]);
-			break;
-
-		//windowed fades need special treatment
-		case 4: for(int x=0;x<256;x++) gpu->___setFinalColorBck<false,true,4>(backdrop_color,x,1); break;
-		case 5: for(int x=0;x<256;x++) gpu->___setFinalColorBck<false,true,5>(backdrop_color,x,1); break;
-		case 6: for(int x=0;x<256;x++) gpu->___setFinalColorBck<false,true,6>(backdrop_color,x,1); break;
-		case 7: for(int x=0;x<256;x++) gpu->___setFinalColorBck<false,true,7>(backdrop_color,x,1); break;
-	}
-	
-	memset(gpu->bgPixels,5,256);
-
 	// init background color & priorities
 	memset(sprAlpha, 0, 256);
 	memset(sprType, 0, 256);
@@ -2126,256 +2330,257 @@ static void GPU_RenderLine_layer(NDS_Screen * screen, u16 l)
 		}
 	}
 
-	
-	if (!gpu->LayersEnable[0] && !gpu->LayersEnable[1] && !gpu->LayersEnable[2] && !gpu->LayersEnable[3])
-		BG_enabled = FALSE;
-
-	for(int j=0;j<8;j++)
-		gpu->blend2[j] = (gpu->BLDCNT & (0x100 << j))!=0;
-
-	// paint lower priorities first
-	// then higher priorities on top
-	for(int prio=NB_PRIORITIES; prio > 0; )
+	//the obj window is known now, so the window masks for this line can be built
+	const int bgFuncNum = gpu->setFinalColorBck_funcNum;
+	const int sprFuncNum = gpu->setFinalColorSpr_funcNum;
+	const int funcNum3d = gpu->setFinalColor3d_funcNum;
+	int backdropFuncNum = bgFuncNum;
+	if(bgFuncNum >= 4)
 	{
-		prio--;
-		item = &(gpu->itemsForPriority[prio]);
-		// render BGs
-		if (BG_enabled)
-		{
-			for (int i=0; i < item->nbBGs; i++) 
-			{
-				i16 = item->BGs[i];
-				if (gpu->LayersEnable[i16])
-				{
-					gpu->currBgNum = (u8)i16;
-					gpu->blend1 = (gpu->BLDCNT & (1 << gpu->currBgNum))!=0;
-
-					struct _BGxCNT *bgCnt = &(gpu->dispx_st)->dispx_BGxCNT[i16].bits;
-					gpu->curr_mosaic_enabled = bgCnt->Mosaic_Enable;
-
-					if (gpu->core == GPU_MAIN)
-					{
-						if (i16 == 0 && dispCnt->BG0_3D)
-						{
-							gpu->currBgNum = 0;
-							gpu->setFinalColor3d(l,i16);
-							continue;
-						}
-					}
-
-					//useful for debugging individual layers
-					//if(gpu->core == 1 || i16 != 2) continue;
-
+		gpu->setup_windowMasks();
+		//the backdrop is always drawn, only the effect depends on the window
+		if(gpu->windowEffectAll) backdropFuncNum = bgFuncNum & 3;
+		else if(!gpu->windowEffectAny) backdropFuncNum = 0;
+	}
 
+	//we need to write backdrop colors in the same way as we do BG pixels in order to do correct window processing
+	gpu->currBgNum = 5;
+	switch(backdropFuncNum) {
+		case 0: case 1: //for backdrops, (even with window enabled) none and blend are both the same: just copy the color
+			memset_u16_le<256>(gpu->currDst,backdrop_color); 
+			break;
+		case 2:
+			//for non-windowed fade, we can just fade the color and fill
+			memset_u16_le<256>(gpu->currDst,gpu->currentFadeInColors[backdrop_color]);
+			break;
+		case 3:
+			//likewise for non-windowed fadeout
+			memset_u16_le<256>(gpu->currDst,gpu->currentFadeOutColors[backdrop_color]);
+			break;
 
+		//windowed fades need special treatment
+		case 4: for(int x=0;x<256;x++) gpu->___setFinalColorBck<false,true,4>(backdrop_color,x,1); break;
+		case 5: for(int x=0;x<256;x++) gpu->___setFinalColorBck<false,true,5>(backdrop_color,x,1); break;
+		case 6: for(int x=0;x<256;x++) gpu->___setFinalColorBck<false,true,6>(backdrop_color,x,1); break;
+		case 7: for(int x=0;x<256;x++) gpu->___setFinalColorBck<false,true,7>(backdrop_color,x,1); break;
+	}
+	
+	memset(gpu->bgPixels,5,256);
 
-#ifndef DISABLE_MOSAIC
-					if(gpu->curr_mosaic_enabled)
-						gpu->modeRender<true>(i16);
-					else 
-#endif
-						gpu->modeRender<false>(i16);
-				} //layer enabled
-			}
-		}
+	for (int s=0; s < gpu->lineProgramLength; s++)
+	{
+		const GPU::LineStep &step = gpu->lineProgram[s];
+		gpu->currBgNum = step.layer;
+		gpu->blend1 = step.blend1;
 
 		// render sprite Pixels
-		if (gpu->LayersEnable[4])
+		if (step.layer == 4)
 		{
-			gpu->currBgNum = 4;
-			gpu->blend1 = (gpu->BLDCNT & (1 << gpu->currBgNum))!=0;
+			item = &(gpu->itemsForPriority[step.prio]);
+			if (!item->nbPixelsX || (sprFuncNum >= 4 && !gpu->windowDrawAny[4]))
+				continue;
+
+			gpu->setFinalColorSpr_funcNum = windowedFuncNum(gpu, 4, sprFuncNum);
 			
 			for (int i=0; i < item->nbPixelsX; i++)
 			{
 				i16=item->PixelsX[i];
 				gpu->setFinalColorSpr(T2ReadWord(spr, (i16<<1)), sprAlpha[i16], sprType[i16], i16);
 			}
+			gpu->setFinalColorSpr_funcNum = sprFuncNum;
+			continue;
 		}
+
+		gpu->curr_mosaic_enabled = step.mosaic;
+
+		//a layer the windows hide on the whole line needs no rendering at all.
+		//mosaic layers still run, they carry colors over to the following lines
+		if (bgFuncNum >= 4 && !gpu->windowDrawAny[step.layer] && !step.mosaic)
+			continue;
+
+		if (step.is3D)
+		{
+			gpu->setFinalColor3d_funcNum = windowedFuncNum(gpu, 0, funcNum3d);
+			gpu->setFinalColor3d(l,0);
+			gpu->setFinalColor3d_funcNum = funcNum3d;
+			continue;
+		}
+
+		//useful for debugging individual layers
+		//if(gpu->core == 1 || step.layer != 2) continue;
+
+		gpu->setFinalColorBck_funcNum = windowedFuncNum(gpu, step.layer, bgFuncNum);
+		step.render(gpu);
+		gpu->setFinalColorBck_funcNum = bgFuncNum;
+	}
+}
+
+//works out the parts of the capture which only change with DISPCAPCNT or the vram banks.
+//this runs when a capture starts and after either of them is written, rather than every line
+static void GPU_validateCapture(GPU *gpu)
+{
+	DISPCAPCNT &cap = gpu->dispCapCnt;
+	cap.dirty = FALSE;
+
+	cap.width = cap.capx==DISPCAPCNT::_128?128:256;
+
+	//128-wide captures should write linearly into memory, with no gaps
+	//this is tested by hotel dusk
+	cap.dstStride = cap.width*2;
+
+	//we must block captures when the capture dest is not mapped to LCDC
+	if(vramConfiguration.banks[cap.writeBlock].purpose != VramConfiguration::LCDC)
+		cap.dstBank = NULL;
+	else
+		cap.dstBank = MMU.ARM9_LCD + cap.writeBlock * 0x20000;
+
+	//we must return zero from reads from memory not mapped to lcdc
+	if(vramConfiguration.banks[cap.readBlock].purpose != VramConfiguration::LCDC)
+		cap.srcBank = NULL;
+	else
+		cap.srcBank = MMU.ARM9_LCD + cap.readBlock * 0x20000;
+}
+
+//a 3d pixel in the 15 bit format the capture unit stores
+static FORCEINLINE u16 GPU_capture3DColor(const u8 *colorLine, int i)
+{
+	COLOR32 color;
+	color.val = *(const u32*)&colorLine[i<<2];
+	return R6G6B6TORGB15(color.bits.r, color.bits.g, color.bits.b) | (color.bits.a == 0 ? 0 : 0x8000);
+}
+
+//copies with bit 15 set, two pixels per word. widths and line addresses are multiples of 4 bytes
+static void GPU_captureCopy(u16 *dst, const u16 *src, int todo)
+{
+	u32 *dst32 = (u32*)dst;
+	const u32 *src32 = (const u32*)src;
+	for(int i = todo>>1; i--;)
+		dst32[i] = src32[i] | 0x80008000;
+}
+
+//the channels of a pixel spread out with room for the blend products:
+//red at bit 0, blue at bit 10 and green at bit 21, ten bits each
+static FORCEINLINE u32 GPU_captureSpread(u16 c)
+{
+	return (c & 0x7C1F) | ((u32)(c & 0x03E0) << 16);
+}
+
+//(a*EVA + b*EVB) >> 4 with every channel clamped at 31. a source only counts when its bit 15 is set.
+//one multiply weights all three channels; a channel which reaches 512 before the shift is the one
+//that saturates, so its tenth bit selects 31
+static FORCEINLINE u16 GPU_captureBlendPixel(u16 a, u16 b, u32 eva, u32 evb)
+{
+	const u32 sum = GPU_captureSpread(a) * ((a & 0x8000) ? eva : 0)
+				+ GPU_captureSpread(b) * ((b & 0x8000) ? evb : 0);
+	const u32 saturate = ((sum >> 9) & 0x00200401) * 31;
+	const u32 c = ((sum >> 4) & 0x03E07C1F) | saturate;
+	return ((a | b) & 0x8000) | (c & 0x7C1F) | ((c >> 16) & 0x03E0);
+}
+
+template<bool SRCA_3D>
+static void GPU_captureBlend(u16 *dst, const void *srcA, const u16 *srcB, int todo, u32 eva, u32 evb)
+{
+	for(int i = 0; i < todo; i++)
+	{
+		const u16 a = SRCA_3D ? GPU_capture3DColor((const u8*)srcA, i) : ((const u16*)srcA)[i];
+		dst[i] = GPU_captureBlendPixel(a, srcB[i], eva, evb);
 	}
 }
 
 template<bool SKIP> static void GPU_RenderLine_DispCapture(u16 l)
 {
-	//this macro takes advantage of the fact that there are only two possible values for capx
-	#define CAPCOPY(SRC,DST) \
-	switch(gpu->dispCapCnt.capx) { \
-		case DISPCAPCNT::_128: \
-			for (int i = 128; i--;)  \
-				T2WriteWord(DST, i << 1, T2ReadWord(SRC, i << 1) | (1<<15)); \
-			break; \
-		case DISPCAPCNT::_256: \
-			for (int i = 256; i--;)  \
-				T2WriteWord(DST, i << 1, T2ReadWord(SRC, i << 1) | (1<<15)); \
-			break; \
-			default: assert(false); \
-		}
-	
 	GPU * gpu = MainScreen.gpu;
+	DISPCAPCNT &cap = gpu->dispCapCnt;
 
 	if (l == 0)
 	{
-		if (gpu->dispCapCnt.val & 0x80000000)
+		if (cap.val & 0x80000000)
 		{
-			gpu->dispCapCnt.enabled = TRUE;
-			T1WriteLong(MMU.ARM9_REG, 0x64, gpu->dispCapCnt.val);
+			cap.enabled = TRUE;
+			cap.dirty = TRUE;
+			T1WriteLong(MMU.ARM9_REG, 0x64, cap.val);
 		}
 	}
 
-	bool skip = SKIP;
+	if (!cap.enabled) return;
 
-	if (gpu->dispCapCnt.enabled)
-	{
-		//128-wide captures should write linearly into memory, with no gaps
-		//this is tested by hotel dusk
-		u32 ofsmul = gpu->dispCapCnt.capx==DISPCAPCNT::_128?256:512;
-		u32 cap_src_adr = gpu->dispCapCnt.readOffset * 0x8000 + (l * 512);
-		u32 cap_dst_adr = gpu->dispCapCnt.writeOffset * 0x8000 + (l * ofsmul);
+	if (cap.dirty)
+		GPU_validateCapture(gpu);
 
+	if (!SKIP && cap.dstBank && l < cap.capy)
+	{
 		//Read/Write block wrap to 00000h when exceeding 1FFFFh (128k)
 		//this has not been tested yet (I thought I needed it for hotel dusk, but it was fixed by the above)
-		cap_src_adr &= 0x1FFFF;
-		cap_dst_adr &= 0x1FFFF;
-
-		cap_src_adr += gpu->dispCapCnt.readBlock * 0x20000;
-		cap_dst_adr += gpu->dispCapCnt.writeBlock * 0x20000;
-
-		u8* cap_src = MMU.ARM9_LCD + cap_src_adr;
-		u8* cap_dst = MMU.ARM9_LCD + cap_dst_adr;
-
-		//we must block captures when the capture dest is not mapped to LCDC
-		if(vramConfiguration.banks[gpu->dispCapCnt.writeBlock].purpose != VramConfiguration::LCDC)
-			skip = true;
+		u16 *cap_dst = (u16*)(cap.dstBank + ((cap.writeOffset * 0x8000 + l * cap.dstStride) & 0x1FFFF));
+		const u16 *cap_src = cap.srcBank ? (const u16*)(cap.srcBank + ((cap.readOffset * 0x8000 + l * 512) & 0x1FFFF))
+								: (const u16*)MMU.blank_memory;
+		const int todo = cap.width;
 
-		//we must return zero from reads from memory not mapped to lcdc
-		if(vramConfiguration.banks[gpu->dispCapCnt.readBlock].purpose != VramConfiguration::LCDC)
-			cap_src = MMU.blank_memory;
-
-		if(!skip)
-		if (l < gpu->dispCapCnt.capy)
+		switch (cap.capSrc)
 		{
-			switch (gpu->dispCapCnt.capSrc)
-			{
-				case 0:		// Capture source is SourceA
-					{
-						//INFO("Capture source is SourceA\n");
-						switch (gpu->dispCapCnt.srcA)
-						{
-							case 0:			// Capture screen (BG + OBJ + 3D)
-								{
-									//INFO("Capture screen (BG + OBJ + 3D)\n");
-
-									u8 *src = (u8*)(gpu->tempScanline);
-									CAPCOPY(src,cap_dst);
-								}
-							break;
-							case 1:			// Capture 3D
-								{
-									//INFO("Capture 3D\n");
-									u16* colorLine;
-									gfx3d_GetLineData15bpp(l, &colorLine);
-									CAPCOPY(((u8*)colorLine),cap_dst);
-								}
-							break;
-						}
-					}
-				break;
-				case 1:		// Capture source is SourceB
-					{
-						//INFO("Capture source is SourceB\n");
-						switch (gpu->dispCapCnt.srcB)
-						{
-							case 0:	
-								//Capture VRAM
-								CAPCOPY(cap_src,cap_dst);
-								break;
-							case 1:
-								//capture dispfifo
-								//(not yet tested)
-								for(int i=128; i--;)
-									T1WriteLong(cap_dst, i << 2, DISP_FIFOrecv());
-								break;
-						}
-					}
+			case 0:		// Capture source is SourceA
+				if (cap.srcA == 0)
+				{
+					// Capture screen (BG + OBJ + 3D)
+					GPU_captureCopy(cap_dst, (const u16*)gpu->tempScanline, todo);
+				}
+				else
+				{
+					// Capture 3D, converted straight out of the render target
+					u8 *colorLine;
+					gfx3d_GetLineData(l, &colorLine);
+					for(int i = 0; i < todo; i++)
+						cap_dst[i] = GPU_capture3DColor(colorLine, i) | 0x8000;
+				}
 				break;
-				default:	// Capture source is SourceA+B blended
-					{
-						//INFO("Capture source is SourceA+B blended\n");
-						u16 *srcA = NULL;
-						u16 *srcB = NULL;
 
-						if (gpu->dispCapCnt.srcA == 0)
-						{
-							// Capture screen (BG + OBJ + 3D)
-							srcA = (u16*)(gpu->tempScanline);
-						}
-						else
-						{
-							gfx3d_GetLineData15bpp(l, &srcA);
-						}
-
-						static u16 fifoLine[256];
-
-						if (gpu->dispCapCnt.srcB == 0)			// VRAM screen
-							srcB = (u16 *)cap_src;
-						else
-						{
-							//fifo - tested by splinter cell chaos theory thermal view
-							srcB = fifoLine;
-							for (int i=128; i--;)
-								T1WriteLong((u8*)srcB, i << 2, DISP_FIFOrecv());
-						}
+			case 1:		// Capture source is SourceB
+				if (cap.srcB == 0)
+				{
+					//Capture VRAM
+					GPU_captureCopy(cap_dst, cap_src, todo);
+				}
+				else
+				{
+					//capture dispfifo
+					//(not yet tested)
+					for(int i=128; i--;)
+						T1WriteLong((u8*)cap_dst, i << 2, DISP_FIFOrecv());
+				}
+				break;
 
+			default:	// Capture source is SourceA+B blended
+				{
+					static u16 fifoLine[256];
 
-						const int todo = (gpu->dispCapCnt.capx==DISPCAPCNT::_128?128:256);
+					const u16 *srcB = cap_src;
+					if (cap.srcB != 0)
+					{
+						//fifo - tested by splinter cell chaos theory thermal view
+						for (int i=128; i--;)
+							T1WriteLong((u8*)fifoLine, i << 2, DISP_FIFOrecv());
+						srcB = fifoLine;
+					}
 
-						for(u16 i = 0; i < todo; i++) 
-						{
-							u16 a,r,g,b;
-
-							u16 a_alpha = srcA[i] & 0x8000;
-							u16 b_alpha = srcB[i] & 0x8000;
-
-							if(a_alpha)
-							{
-								a = 0x8000;
-								r = ((srcA[i] & 0x1F) * gpu->dispCapCnt.EVA);
-								g = (((srcA[i] >>  5) & 0x1F) * gpu->dispCapCnt.EVA);
-								b = (((srcA[i] >>  10) & 0x1F) * gpu->dispCapCnt.EVA);
-							} 
-							else
-								a = r = g = b = 0;
-
-							if(b_alpha)
-							{
-								a = 0x8000;
-								r += ((srcB[i] & 0x1F) * gpu->dispCapCnt.EVB);
-								g += (((srcB[i] >>  5) & 0x1F) * gpu->dispCapCnt.EVB);
-								b += (((srcB[i] >> 10) & 0x1F) * gpu->dispCapCnt.EVB);
-							}
-
-							r >>= 4;
-							g >>= 4;
-							b >>= 4;
-
-							//freedom wings sky will overflow while doing some fsaa/motionblur effect without this
-							r = std::min((u16)31,r);
-							g = std::min((u16)31,g);
-							b = std::min((u16)31,b);
-
-							T2WriteWord(cap_dst, i << 1, a | (b << 10) | (g << 5) | r);
-						}
+					//freedom wings sky will overflow while doing some fsaa/motionblur effect without the clamping
+					if (cap.srcA == 0)
+						GPU_captureBlend<false>(cap_dst, gpu->tempScanline, srcB, todo, cap.EVA, cap.EVB);
+					else
+					{
+						u8 *colorLine;
+						gfx3d_GetLineData(l, &colorLine);
+						GPU_captureBlend<true>(cap_dst, colorLine, srcB, todo, cap.EVA, cap.EVB);
 					}
+				}
 				break;
-			}
 		}
+	}
 
-		if (l>=191)
-		{
-			gpu->dispCapCnt.enabled = FALSE;
-			gpu->dispCapCnt.val &= 0x7FFFFFFF;
-			T1WriteLong(MMU.ARM9_REG, 0x64, gpu->dispCapCnt.val);
-			return;
-		}
+	if (l>=191)
+	{
+		cap.enabled = FALSE;
+		cap.val &= 0x7FFFFFFF;
+		T1WriteLong(MMU.ARM9_REG, 0x64, cap.val);
 	}
 }
 
@@ -2513,22 +2718,17 @@ void GPU::update_winh(int WIN_NUM)
 	//	if((x < startX) || (x >= endX)) return false;
 	//}
 
+	u8 *win = h_win[WIN_NUM];
 	if(startX > endX)
 	{
-		for(int i=0;i<=endX;i++)
-			h_win[WIN_NUM][i] = 1;
-		for(int i=endX+1;i<startX;i++)
-			h_win[WIN_NUM][i] = 0;
-		for(int i=startX;i<256;i++)
-			h_win[WIN_NUM][i] = 1;
+		memset(win, 1, endX+1);
+		memset(win+endX+1, 0, startX-(endX+1));
+		memset(win+startX, 1, 256-startX);
 	} else
 	{
-		for(int i=0;i<startX;i++)
-			h_win[WIN_NUM][i] = 0;
-		for(int i=startX;i<endX;i++)
-			h_win[WIN_NUM][i] = 1;
-		for(int i=endX;i<256;i++)
-			h_win[WIN_NUM][i] = 0;
+		memset(win, 0, startX);
+		memset(win+startX, 1, endX-startX);
+		memset(win+endX, 0, 256-endX);
 	}
 }
 
@@ -2670,14 +2870,10 @@ void gpu_savestate(EMUFILE* os)
 	
 	os->fwrite((char*)GPU_screen,sizeof(GPU_screen));
 	
-	write32le(MainScreen.gpu->affineInfo[0].x,os);
-	write32le(MainScreen.gpu->affineInfo[0].y,os);
-	write32le(MainScreen.gpu->affineInfo[1].x,os);
-	write32le(MainScreen.gpu->affineInfo[1].y,os);
-	write32le(SubScreen.gpu->affineInfo[0].x,os);
-	write32le(SubScreen.gpu->affineInfo[0].y,os);
-	write32le(SubScreen.gpu->affineInfo[1].x,os);
-	write32le(SubScreen.gpu->affineInfo[1].y,os);
+	//each affineInfo[2] is four consecutive u32s: x,y of bg2 then x,y of bg3
+	CTASSERT(sizeof(MainScreen.gpu->affineInfo) == 4*sizeof(u32));
+	writeArrayLE((u32*)MainScreen.gpu->affineInfo,4,os);
+	writeArrayLE((u32*)SubScreen.gpu->affineInfo,4,os);
 }
 
 bool gpu_loadstate(EMUFILE* is, int size)
@@ -2703,14 +2899,8 @@ bool gpu_loadstate(EMUFILE* is, int size)
 
 	if(version==1)
 	{
-		read32le(&MainScreen.gpu->affineInfo[0].x,is);
-		read32le(&MainScreen.gpu->affineInfo[0].y,is);
-		read32le(&MainScreen.gpu->affineInfo[1].x,is);
-		read32le(&MainScreen.gpu->affineInfo[1].y,is);
-		read32le(&SubScreen.gpu->affineInfo[0].x,is);
-		read32le(&SubScreen.gpu->affineInfo[0].y,is);
-		read32le(&SubScreen.gpu->affineInfo[1].x,is);
-		read32le(&SubScreen.gpu->affineInfo[1].y,is);
+		readArrayLE((u32*)MainScreen.gpu->affineInfo,4,is);
+		readArrayLE((u32*)SubScreen.gpu->affineInfo,4,is);
 		//removed per nitsuja feedback. anyway, this same thing will happen almost immediately in gpu line=0
 		//MainScreen.gpu->refreshAffineStartRegs(-1,-1);
 		//SubScreen.gpu->refreshAffineStartRegs(-1,-1);
@@ -2718,6 +2908,8 @@ bool gpu_loadstate(EMUFILE* is, int size)
 
 	MainScreen.gpu->updateBLDALPHA();
 	SubScreen.gpu->updateBLDALPHA();
+	MainScreen.gpu->lineProgramDirty = true;
+	SubScreen.gpu->lineProgramDirty = true;
 	return !is->fail();
 }
 
@@ -362,6 +362,13 @@ struct DISPCAPCNT
 	u8 readBlock;
 	u8 readOffset;
 	u8 capSrc;
+
+	//derived by GPU_validateCapture. dirty is set when DISPCAPCNT or the vram banks are written
+	BOOL dirty;
+	u16 width;
+	u16 dstStride;
+	u8 *dstBank;		//NULL when the destination bank isn't mapped to LCDC
+	u8 *srcBank;		//NULL when the source bank isn't mapped to LCDC
 } ;
 
 /*******************************************************************************
@@ -659,6 +666,22 @@ struct GPU
 	BOOL LayersEnable[5];
 	itemsForPriority_t itemsForPriority[NB_PRIORITIES];
 
+	//the layer passes of a line, compiled from the layer registers by compileLineProgram:
+	//every enabled BG and then the sprites of each priority, lowest priority first, with the BG
+	//routine already picked. GPU_resortBGs and SetupFinalPixelBlitter mark it dirty
+	struct LineStep {
+		void (*render)(GPU *gpu);	//NULL for the 3D layer and the sprites
+		u8 layer;					//0-3 BG, 4 OBJ
+		u8 prio;
+		bool is3D;
+		bool mosaic;
+		bool blend1;
+	};
+	LineStep lineProgram[NB_PRIORITIES*(NB_BG+1)];
+	u8 lineProgramLength;
+	bool lineProgramDirty;
+	void compileLineProgram();
+
 #define BGBmpBB BG_bmp_ram
 #define BGChBB BG_tile_ram
 
@@ -687,6 +710,14 @@ struct GPU
 	
 	template<int WIN_NUM> void setup_windows();
 
+	//window coverage of the current line, rebuilt by setup_windowMasks while any window is enabled.
+	//windowDrawMask[layer][x] is 1 where the layer (0-3 BG, 4 OBJ) may be drawn and windowEffectMask[x]
+	//where color special effects are allowed. the Any/All flags summarize each mask over the whole line
+	CACHE_ALIGN u8 windowDrawMask[5][256];
+	CACHE_ALIGN u8 windowEffectMask[256];
+	bool windowDrawAny[5], windowDrawAll[5];
+	bool windowEffectAny, windowEffectAll;
+
 	u8 core;
 
 	u8 dispMode;
@@ -827,11 +858,7 @@ struct GPU
 		u32 x, y;
 	} affineInfo[2];
 
-	void renderline_checkWindows(u16 x, bool &draw, bool &effect) const;
-
-	// check whether (x,y) is within the rectangle (including wraparounds) 
-	template<int WIN_NUM>
-	u8 withinRect(u16 x) const;
+	void setup_windowMasks();
 
 	void setBLDALPHA(u16 val)
 	{
@@ -85,6 +85,13 @@ u32 _MMU_MAIN_MEM_MASK = 0x3FFFFF;
 u32 _MMU_MAIN_MEM_MASK16 = 0x3FFFFF & ~1;
 u32 _MMU_MAIN_MEM_MASK32 = 0x3FFFFF & ~3;
 
+u32 _MMU_MAIN_MEM_REGION = 0x02000000;
+u32 _MMU_DTCM_REGION = 0x027C0000;
+u32 _MMU_ITCM_END = 0x02000000;
+u32 _MMU_ARM7_ERAM_REGION = 0x03800000;
+u32 _MMU_ARM7_SWIRAM_REGION = 0x03000000;
+bool _MMU_watchActive = false;
+
 #define ROM_MASK 3
 
 //#define	_MMU_DEBUG
@@ -746,6 +753,9 @@ static inline void MMU_VRAMmapControl(u8 block, u8 VRAMBankCnt)
 	for(int i=0;i<VRAM_BANKS;i++)
 		MMU_VRAMmapRefreshBank(i);
 
+	//the display capture checks the bank purposes when it is validated
+	MainScreen.gpu->dispCapCnt.dirty = TRUE;
+
 	//printf(vramConfiguration.describe().c_str());
 	//printf("vram remapped at vcount=%d\n",nds.VCount);
 
@@ -755,6 +765,7 @@ static inline void MMU_VRAMmapControl(u8 block, u8 VRAMBankCnt)
 		//if(!nds.isIn3dVblank())
 	//		PROGINFO("Changing texture or texture palette mappings outside of 3d vblank\n");
 		gpu3D->NDS_3D_VramReconfigureSignal();
+		gfx3d_TexMappingChanged();
 	}
 
 	//-------------------------------
@@ -955,6 +966,7 @@ void MMU_Init()
 
 	MMU.DTCMRegion = 0x027C0000;
 	MMU.ITCMRegion = 0x00000000;
+	MMU_updateFastRegions();
 	
 	IPC_FIFOinit(ARMCPU_ARM9);
 	IPC_FIFOinit(ARMCPU_ARM7);
@@ -1023,6 +1035,7 @@ void MMU_Reset()
 	
 	MMU.DTCMRegion = 0x027C0000;
 	MMU.ITCMRegion = 0x00000000;
+	MMU_updateFastRegions();
 	
 	memset(MMU.timer,         0, sizeof(u16) * 2 * 4);
 	memset(MMU.timerMODE,     0, sizeof(s32) * 2 * 4);
@@ -1033,6 +1046,7 @@ void MMU_Reset()
 	memset(MMU.reg_IME,       0, sizeof(u32) * 2);
 	memset(MMU.reg_IE,        0, sizeof(u32) * 2);
 	memset(MMU.reg_IF,        0, sizeof(u32) * 2);
+	memset(MMU.irqPending,    0, sizeof(u32) * 2);
 	
 	memset(MMU.dscard,        0, sizeof(nds_dscard) * 2);
 
@@ -1093,6 +1107,7 @@ void MMU_Reset()
 	MMU_timing.arm9dataFetch.Reset();
 	MMU_timing.arm9codeCache.Reset();
 	MMU_timing.arm9dataCache.Reset();
+	MMU_timing.arm9writeBuffer.Reset();
 }
 
 void MMU_setRom(u8 * rom, u32 mask)
@@ -1541,69 +1556,6 @@ u32 MMU_readFromGC()
 }
 
 
-#ifdef MMU_ENABLE_ACL
-
-INLINE void check_access(u32 adr, u32 access) {
-	/* every other mode: sys */
-	access |= 1;
-	if ((NDS_ARM9.CPSR.val & 0x1F) == 0x10) {
-		/* is user mode access */
-		access ^= 1 ;
-	}
-	if (armcp15_isAccessAllowed((armcp15_t *)NDS_ARM9.coproc[15],adr,access)==FALSE) {
-		execute = FALSE ;
-	}
-}
-INLINE void check_access_write(u32 adr) {
-	u32 access = CP15_ACCESS_WRITE;
-	check_access(adr, access)
-}
-
-u8 FASTCALL MMU_read8_acl(u32 proc, u32 adr, u32 access)
-{
-	/* on arm9 we need to check the MPU regions */
-	if (proc == ARMCPU_ARM9)
-		check_access(u32 adr, u32 access);
-	return MMU_read8(proc,adr);
-}
-u16 FASTCALL MMU_read16_acl(u32 proc, u32 adr, u32 access)
-{
-	/* on arm9 we need to check the MPU regions */
-	if (proc == ARMCPU_ARM9)
-		check_access(u32 adr, u32 access);
-	return MMU_read16(proc,adr);
-}
-u32 FASTCALL MMU_read32_acl(u32 proc, u32 adr, u32 access)
-{
-	/* on arm9 we need to check the MPU regions */
-	if (proc == ARMCPU_ARM9)
-		check_access(u32 adr, u32 access);
-	return MMU_read32(proc,adr);
-}
-
-void FASTCALL MMU_write8_acl(u32 proc, u32 adr, u8 val)
-{
-	/* check MPU region on ARM9 */
-	if (proc == ARMCPU_ARM9)
-		check_access_write(adr);
-	MMU_write8(proc,adr,val);
-}
-void FASTCALL MMU_write16_acl(u32 proc, u32 adr, u16 val)
-{
-	/* check MPU region on ARM9 */
-	if (proc == ARMCPU_ARM9)
-		check_access_write(adr);
-	MMU_write16(proc,adr,val) ;
-}
-void FASTCALL MMU_write32_acl(u32 proc, u32 adr, u32 val)
-{
-	/* check MPU region on ARM9 */
-	if (proc == ARMCPU_ARM9)
-		check_access_write(adr);
-	MMU_write32(proc,adr,val) ;
-}
-#endif
-
 //a stub for memory profiler, if we choose to re-add it
 #define PROFILE_PREFETCH 1
 #define profile_memory_access(X,Y,Z)
@@ -2745,61 +2697,30 @@ void FASTCALL _MMU_ARM9_write16(u32 adr, u16 val)
 
 			case REG_IME:
 				{
-					NDS_Reschedule();
-					u32 old_val = MMU.reg_IME[ARMCPU_ARM9];
 					u32 new_val = val & 0x01;
 					MMU.reg_IME[ARMCPU_ARM9] = new_val;
 					T1WriteLong(MMU.MMU_MEM[ARMCPU_ARM9][0x40], 0x208, val);
-#ifndef NEW_IRQ
-					if ( new_val && old_val != new_val) 
-					{
-						// raise an interrupt request to the CPU if needed
-						if ( MMU.reg_IE[ARMCPU_ARM9] & MMU.reg_IF[ARMCPU_ARM9])
-						{
-							NDS_ARM9.waitIRQ = FALSE;
-						}
-					}
-#endif
+				NDS_UpdateIRQ(ARMCPU_ARM9);
 				return;
 				}
 			case REG_IE :
-				NDS_Reschedule();
 				MMU.reg_IE[ARMCPU_ARM9] = (MMU.reg_IE[ARMCPU_ARM9]&0xFFFF0000) | val;
-#ifndef NEW_IRQ
-				if ( MMU.reg_IME[ARMCPU_ARM9])
-				{
-					// raise an interrupt request to the CPU if needed
-					if ( MMU.reg_IE[ARMCPU_ARM9] & MMU.reg_IF[ARMCPU_ARM9]) 
-					{
-						NDS_ARM9.waitIRQ = FALSE;
-					}
-				}
-#endif
+				NDS_UpdateIRQ(ARMCPU_ARM9);
 				return;
 			case REG_IE + 2 :
-				NDS_Reschedule();
 				MMU.reg_IE[ARMCPU_ARM9] = (MMU.reg_IE[ARMCPU_ARM9]&0xFFFF) | (((u32)val)<<16);
-#ifndef NEW_IRQ
-				if ( MMU.reg_IME[ARMCPU_ARM9])
-				{
-					// raise an interrupt request to the CPU if needed
-					if ( MMU.reg_IE[ARMCPU_ARM9] & MMU.reg_IF[ARMCPU_ARM9]) 
-					{
-						NDS_ARM9.waitIRQ = FALSE;
-					}
-				}
-#endif
+				NDS_UpdateIRQ(ARMCPU_ARM9);
 				return;
 				
 			case REG_IF :
-				NDS_Reschedule();
 				MMU.reg_IF[ARMCPU_ARM9] &= (~((u32)val)); 
 				validateIF_arm9();
+				NDS_UpdateIRQ(ARMCPU_ARM9);
 				return;
 			case REG_IF + 2 :
-				NDS_Reschedule();
 				MMU.reg_IF[ARMCPU_ARM9] &= (~(((u32)val)<<16));
 				validateIF_arm9();
+				NDS_UpdateIRQ(ARMCPU_ARM9);
 				return;
 
             case REG_IPCSYNC :
@@ -3150,43 +3071,22 @@ void FASTCALL _MMU_ARM9_write32(u32 adr, u32 val)
 
 			case REG_IME : 
 				{
-					NDS_Reschedule();
-			        u32 old_val = MMU.reg_IME[ARMCPU_ARM9];
 					u32 new_val = val & 0x01;
 					MMU.reg_IME[ARMCPU_ARM9] = new_val;
 					T1WriteLong(MMU.MMU_MEM[ARMCPU_ARM9][0x40], 0x208, val);
-#ifndef NEW_IRQ
-					if ( new_val && old_val != new_val) 
-					{
-						// raise an interrupt request to the CPU if needed
-						if ( MMU.reg_IE[ARMCPU_ARM9] & MMU.reg_IF[ARMCPU_ARM9]) 
-						{
-							NDS_ARM9.waitIRQ = FALSE;
-						}
-					}
-#endif
 				}
+				NDS_UpdateIRQ(ARMCPU_ARM9);
 				return;
 				
 			case REG_IE :
-				NDS_Reschedule();
 				MMU.reg_IE[ARMCPU_ARM9] = val;
-#ifndef NEW_IRQ
-				if ( MMU.reg_IME[ARMCPU_ARM9]) 
-				{
-					// raise an interrupt request to the CPU if needed
-					if ( MMU.reg_IE[ARMCPU_ARM9] & MMU.reg_IF[ARMCPU_ARM9]) 
-					{
-						NDS_ARM9.waitIRQ = FALSE;
-					}
-				}
-#endif
+				NDS_UpdateIRQ(ARMCPU_ARM9);
 				return;
 			
 			case REG_IF :
-				NDS_Reschedule();
 				MMU.reg_IF[ARMCPU_ARM9] &= (~val); 
 				validateIF_arm9();
+				NDS_UpdateIRQ(ARMCPU_ARM9);
 				return;
 
             case REG_TM0CNTL:
@@ -3329,7 +3229,11 @@ u16 FASTCALL _MMU_ARM9_read16(u32 adr)
 		return T1ReadWord_guaranteedAligned(MMU.ARM9_ITCM, adr & 0x7FFE);	
 
 	if ( (adr >= 0x08000000) && (adr < 0x0A010000) )
+	{
+		if (adr < GBAslotROMEnd)
+			return T1ReadWord_guaranteedAligned(GBAslotROM, (adr & ~1) - 0x08000000);
 		return addon.read16(adr);
+	}
 
 	adr &= 0x0FFFFFFE;
 
@@ -3410,7 +3314,11 @@ u32 FASTCALL _MMU_ARM9_read32(u32 adr)
 		return T1ReadLong_guaranteedAligned(MMU.ARM9_ITCM, adr&0x7FFC);
 
 	if ( (adr >= 0x08000000) && (adr < 0x0A010000) )
+	{
+		if (adr < GBAslotROMEnd)
+			return T1ReadLong_guaranteedAligned(GBAslotROM, (adr & ~3) - 0x08000000);
 		return addon.read32(adr);
+	}
 
 	adr &= 0x0FFFFFFC;
 
@@ -3785,62 +3693,31 @@ void FASTCALL _MMU_ARM7_write16(u32 adr, u16 val)
 				
 			case REG_IME : 
 				{
-					NDS_Reschedule();
-					u32 old_val = MMU.reg_IME[ARMCPU_ARM7];
 					u32 new_val = val & 1;
 					MMU.reg_IME[ARMCPU_ARM7] = new_val;
 					T1WriteLong(MMU.MMU_MEM[ARMCPU_ARM7][0x40], 0x208, val);
-#ifndef NEW_IRQ
-					if ( new_val && old_val != new_val) 
-					{
-						/* raise an interrupt request to the CPU if needed */
-						if ( MMU.reg_IE[ARMCPU_ARM7] & MMU.reg_IF[ARMCPU_ARM7])
-						{
-							NDS_ARM7.waitIRQ = FALSE;
-						}
-					}
-#endif
+				NDS_UpdateIRQ(ARMCPU_ARM7);
 				return;
 				}
 			case REG_IE :
-				NDS_Reschedule();
 				MMU.reg_IE[ARMCPU_ARM7] = (MMU.reg_IE[ARMCPU_ARM7]&0xFFFF0000) | val;
-#ifndef NEW_IRQ
-				if ( MMU.reg_IME[ARMCPU_ARM7]) 
-				{
-					/* raise an interrupt request to the CPU if needed */
-					if ( MMU.reg_IE[ARMCPU_ARM7] & MMU.reg_IF[ARMCPU_ARM7]) 
-					{
-						NDS_ARM7.waitIRQ = FALSE;
-					}
-				}
-#endif
+				NDS_UpdateIRQ(ARMCPU_ARM7);
 				return;
 			case REG_IE + 2 :
-				NDS_Reschedule();
 				//emu_halt();
 				MMU.reg_IE[ARMCPU_ARM7] = (MMU.reg_IE[ARMCPU_ARM7]&0xFFFF) | (((u32)val)<<16);
-#ifndef NEW_IRQ
-				if ( MMU.reg_IME[ARMCPU_ARM7]) 
-				{
-					/* raise an interrupt request to the CPU if needed */
-					if ( MMU.reg_IE[ARMCPU_ARM7] & MMU.reg_IF[ARMCPU_ARM7]) 
-					{
-						NDS_ARM7.waitIRQ = FALSE;
-					}
-				}
-#endif
+				NDS_UpdateIRQ(ARMCPU_ARM7);
 				return;
 				
 			case REG_IF :
-				NDS_Reschedule();
 				//emu_halt();
 				MMU.reg_IF[ARMCPU_ARM7] &= (~((u32)val)); 
+				NDS_UpdateIRQ(ARMCPU_ARM7);
 				return;
 			case REG_IF + 2 :
-				NDS_Reschedule();
 				//emu_halt();
 				MMU.reg_IF[ARMCPU_ARM7] &= (~(((u32)val)<<16));
+				NDS_UpdateIRQ(ARMCPU_ARM7);
 				return;
 				
             case REG_IPCSYNC :
@@ -3921,42 +3798,21 @@ void FASTCALL _MMU_ARM7_write32(u32 adr, u32 val)
 
 			case REG_IME : 
 			{
-				NDS_Reschedule();
-				u32 old_val = MMU.reg_IME[ARMCPU_ARM7];
 				u32 new_val = val & 1;
 				MMU.reg_IME[ARMCPU_ARM7] = new_val;
 				T1WriteLong(MMU.MMU_MEM[ARMCPU_ARM7][0x40], 0x208, val);
-#ifndef NEW_IRQ
-				if ( new_val && old_val != new_val) 
-				{
-					// raise an interrupt request to the CPU if needed
-					if ( MMU.reg_IE[ARMCPU_ARM7] & MMU.reg_IF[ARMCPU_ARM7]) 
-					{
-						NDS_ARM7.waitIRQ = FALSE;
-					}
-				}
-#endif
+				NDS_UpdateIRQ(ARMCPU_ARM7);
 				return;
 			}
 				
 			case REG_IE :
-				NDS_Reschedule();
 				MMU.reg_IE[ARMCPU_ARM7] = val;
-#ifndef NEW_IRQ
-				if ( MMU.reg_IME[ARMCPU_ARM7])
-				{
-					/* raise an interrupt request to the CPU if needed */
-					if ( MMU.reg_IE[ARMCPU_ARM7] & MMU.reg_IF[ARMCPU_ARM7]) 
-					{
-						NDS_ARM7.waitIRQ = FALSE;
-					}
-				}
-#endif
+				NDS_UpdateIRQ(ARMCPU_ARM7);
 				return;
 			
 			case REG_IF :
-				NDS_Reschedule();
 				MMU.reg_IF[ARMCPU_ARM7] &= (~val); 
+				NDS_UpdateIRQ(ARMCPU_ARM7);
 				return;
 
             case REG_TM0CNTL:
@@ -4039,7 +3895,11 @@ u16 FASTCALL _MMU_ARM7_read16(u32 adr)
 		return WIFI_read16(adr) ;
 
 	if ( (adr >= 0x08000000) && (adr < 0x0A010000) )
+	{
+		if (adr < GBAslotROMEnd)
+			return T1ReadWord_guaranteedAligned(GBAslotROM, (adr & ~1) - 0x08000000);
 		return addon.read16(adr);
+	}
 
 	adr &= 0x0FFFFFFE;
 
@@ -4106,7 +3966,11 @@ u32 FASTCALL _MMU_ARM7_read32(u32 adr)
 		return (WIFI_read16(adr) | (WIFI_read16(adr+2) << 16));
 
 	if ( (adr >= 0x08000000) && (adr < 0x0A010000) )
+	{
+		if (adr < GBAslotROMEnd)
+			return T1ReadLong_guaranteedAligned(GBAslotROM, (adr & ~3) - 0x08000000);
 		return addon.read32(adr);
+	}
 
 	adr &= 0x0FFFFFFC;
 
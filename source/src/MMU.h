@@ -330,6 +330,8 @@ typedef struct
 	u32 reg_IME[2];
 	u32 reg_IE[2];
 	u32 reg_IF[2];
+	//IE & IF while IME is set, else 0. kept current by NDS_UpdateIRQ
+	u32 irqPending[2];
 
 	BOOL divRunning;
 	s64 divResult;
@@ -433,6 +435,8 @@ struct MMU_struct
 	u32 reg_IME[2];
 	u32 reg_IE[2];
 	u32 reg_IF[2];
+	//IE & IF while IME is set, else 0. kept current by NDS_UpdateIRQ
+	u32 irqPending[2];
 
 	BOOL divRunning;
 	s64 divResult;
@@ -737,11 +741,26 @@ extern u32 partie;
 extern u32 _MMU_MAIN_MEM_MASK;
 extern u32 _MMU_MAIN_MEM_MASK16;
 extern u32 _MMU_MAIN_MEM_MASK32;
+
+//the tags the inline accessors below compare against before taking their shortcuts. each holds the real
+//tag, or one no address can match while a watchpoint lies in that region, so those accesses fall through
+//to the cold path where the watched page table is consulted (see watch.h)
+extern u32 _MMU_MAIN_MEM_REGION;
+extern u32 _MMU_DTCM_REGION;
+extern u32 _MMU_ITCM_END;
+extern u32 _MMU_ARM7_ERAM_REGION;
+extern u32 _MMU_ARM7_SWIRAM_REGION;
+extern bool _MMU_watchActive;
+void MMU_updateFastRegions();
+u32 FASTCALL MMU_watchedRead(int PROCNUM, MMU_ACCESS_TYPE AT, u32 addr, int size);
+void FASTCALL MMU_watchedWrite(int PROCNUM, MMU_ACCESS_TYPE AT, u32 addr, u32 val, int size);
+
 inline void SetupMMU(BOOL debugConsole) {
 	if(debugConsole) _MMU_MAIN_MEM_MASK = 0x7FFFFF;
 	else _MMU_MAIN_MEM_MASK = 0x3FFFFF;
 	_MMU_MAIN_MEM_MASK16 = _MMU_MAIN_MEM_MASK & ~1;
 	_MMU_MAIN_MEM_MASK32 = _MMU_MAIN_MEM_MASK & ~3;
+	MMU_updateFastRegions();
 }
 
 //TODO: at one point some of the early access code included this. consider re-adding it
@@ -764,15 +783,16 @@ FORCEINLINE u8 _MMU_read08(const int PROCNUM, const MMU_ACCESS_TYPE AT, const u3
 #endif
 
 	if(PROCNUM==ARMCPU_ARM9)
-		if((addr&(~0x3FFF)) == MMU.DTCMRegion)
+		if((addr&(~0x3FFF)) == _MMU_DTCM_REGION)
 		{
 			//Returns data from DTCM (ARM9 only)
 			return T1ReadByte(MMU.ARM9_DTCM, addr & 0x3FFF);
 		}
 
-	if ( (addr & 0x0F000000) == 0x02000000)
+	if ( (addr & 0x0F000000) == _MMU_MAIN_MEM_REGION)
 		return T1ReadByte( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK);
 
+	if(_MMU_watchActive) return (u8)MMU_watchedRead(PROCNUM, AT, addr, 1);
 	if(PROCNUM==ARMCPU_ARM9) return _MMU_ARM9_read08(addr);
 	else return _MMU_ARM7_read08(addr);
 }
@@ -793,26 +813,27 @@ FORCEINLINE u16 _MMU_read16(const int PROCNUM, const MMU_ACCESS_TYPE AT, const u
 	//special handling for execution from arm9, since we spend so much time in there
 	if(PROCNUM==ARMCPU_ARM9 && AT == MMU_AT_CODE)
 	{
-		if ((addr & 0x0F000000) == 0x02000000)
+		if ((addr & 0x0F000000) == _MMU_MAIN_MEM_REGION)
 			return T1ReadWord_guaranteedAligned( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK16);
 
-		if(addr<0x02000000) 
+		if(addr<_MMU_ITCM_END)
 			return T1ReadWord_guaranteedAligned(MMU.ARM9_ITCM, addr&0x7FFE);
 
 		goto dunno;
 	}
 
 	if(PROCNUM==ARMCPU_ARM9)
-		if((addr&(~0x3FFF)) == MMU.DTCMRegion)
+		if((addr&(~0x3FFF)) == _MMU_DTCM_REGION)
 		{
 			//Returns data from DTCM (ARM9 only)
 			return T1ReadWord_guaranteedAligned(MMU.ARM9_DTCM, addr & 0x3FFE);
 		}
 
-	if ( (addr & 0x0F000000) == 0x02000000)
+	if ( (addr & 0x0F000000) == _MMU_MAIN_MEM_REGION)
 		return T1ReadWord_guaranteedAligned( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK16);
 
 dunno:
+	if(_MMU_watchActive) return (u16)MMU_watchedRead(PROCNUM, AT, addr, 2);
 	if(PROCNUM==ARMCPU_ARM9) return _MMU_ARM9_read16(addr);
 	else return _MMU_ARM7_read16(addr);
 }
@@ -833,10 +854,10 @@ FORCEINLINE u32 _MMU_read32(const int PROCNUM, const MMU_ACCESS_TYPE AT, const u
 	//special handling for execution from arm9, since we spend so much time in there
 	if(PROCNUM==ARMCPU_ARM9 && AT == MMU_AT_CODE)
 	{
-		if ( (addr & 0x0F000000) == 0x02000000)
+		if ( (addr & 0x0F000000) == _MMU_MAIN_MEM_REGION)
 			return T1ReadLong_guaranteedAligned( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK32);
 
-		if(addr<0x02000000) 
+		if(addr<_MMU_ITCM_END)
 			return T1ReadLong_guaranteedAligned(MMU.ARM9_ITCM, addr&0x7FFC);
 
 		goto dunno;
@@ -845,11 +866,11 @@ FORCEINLINE u32 _MMU_read32(const int PROCNUM, const MMU_ACCESS_TYPE AT, const u
 	//special handling for execution from arm7. try reading from main memory first
 	if(PROCNUM==ARMCPU_ARM7)
 	{
-		if ( (addr & 0x0F000000) == 0x02000000)
+		if ( (addr & 0x0F000000) == _MMU_MAIN_MEM_REGION)
 			return T1ReadLong_guaranteedAligned( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK32);
-		else if((addr & 0xFF800000) == 0x03800000)
+		else if((addr & 0xFF800000) == _MMU_ARM7_ERAM_REGION)
 			return T1ReadLong_guaranteedAligned(MMU.ARM7_ERAM, addr&0xFFFC);
-		else if((addr & 0xFF800000) == 0x03000000)
+		else if((addr & 0xFF800000) == _MMU_ARM7_SWIRAM_REGION)
 			return T1ReadLong_guaranteedAligned(MMU.SWIRAM, addr&0x7FFC);
 	}
 
@@ -857,17 +878,18 @@ FORCEINLINE u32 _MMU_read32(const int PROCNUM, const MMU_ACCESS_TYPE AT, const u
 	//for other arm9 cases, we have to check from dtcm first because it is patched on top of the main memory range
 	if(PROCNUM==ARMCPU_ARM9)
 	{
-		if((addr&(~0x3FFF)) == MMU.DTCMRegion)
+		if((addr&(~0x3FFF)) == _MMU_DTCM_REGION)
 		{
 			//Returns data from DTCM (ARM9 only)
 			return T1ReadLong_guaranteedAligned(MMU.ARM9_DTCM, addr & 0x3FFC);
 		}
 	
-		if ( (addr & 0x0F000000) == 0x02000000)
+		if ( (addr & 0x0F000000) == _MMU_MAIN_MEM_REGION)
 			return T1ReadLong_guaranteedAligned( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK32);
 	}
 
 dunno:
+	if(_MMU_watchActive) return (u32)MMU_watchedRead(PROCNUM, AT, addr, 4);
 	if(PROCNUM==ARMCPU_ARM9) return _MMU_ARM9_read32(addr);
 	else return _MMU_ARM7_read32(addr);
 }
@@ -882,7 +904,7 @@ FORCEINLINE void _MMU_write08(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 	}
 
 	if(PROCNUM==ARMCPU_ARM9)
-		if((addr&(~0x3FFF)) == MMU.DTCMRegion)
+		if((addr&(~0x3FFF)) == _MMU_DTCM_REGION)
 		{
 			T1WriteByte(MMU.ARM9_DTCM, addr & 0x3FFF, val);
 #ifdef HAVE_LUA
@@ -891,7 +913,7 @@ FORCEINLINE void _MMU_write08(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 			return;
 		}
 
-	if ( (addr & 0x0F000000) == 0x02000000) {
+	if ( (addr & 0x0F000000) == _MMU_MAIN_MEM_REGION) {
 		T1WriteByte( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK, val);
 #ifdef HAVE_LUA
 		CallRegisteredLuaMemHook(addr, 1, val, LUAMEMHOOK_WRITE);
@@ -899,7 +921,8 @@ FORCEINLINE void _MMU_write08(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 		return;
 	}
 
-	if(PROCNUM==ARMCPU_ARM9) _MMU_ARM9_write08(addr,val);
+	if(_MMU_watchActive) MMU_watchedWrite(PROCNUM, AT, addr, val, 1);
+	else if(PROCNUM==ARMCPU_ARM9) _MMU_ARM9_write08(addr,val);
 	else _MMU_ARM7_write08(addr,val);
 #ifdef HAVE_LUA
 	CallRegisteredLuaMemHook(addr, 1, val, LUAMEMHOOK_WRITE);
@@ -916,7 +939,7 @@ FORCEINLINE void _MMU_write16(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 	}
 
 	if(PROCNUM==ARMCPU_ARM9)
-		if((addr&(~0x3FFF)) == MMU.DTCMRegion)
+		if((addr&(~0x3FFF)) == _MMU_DTCM_REGION)
 		{
 			T1WriteWord(MMU.ARM9_DTCM, addr & 0x3FFE, val);
 #ifdef HAVE_LUA
@@ -925,7 +948,7 @@ FORCEINLINE void _MMU_write16(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 			return;
 		}
 
-	if ( (addr & 0x0F000000) == 0x02000000) {
+	if ( (addr & 0x0F000000) == _MMU_MAIN_MEM_REGION) {
 		T1WriteWord( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK16, val);
 #ifdef HAVE_LUA
 		CallRegisteredLuaMemHook(addr, 2, val, LUAMEMHOOK_WRITE);
@@ -933,7 +956,8 @@ FORCEINLINE void _MMU_write16(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 		return;
 	}
 
-	if(PROCNUM==ARMCPU_ARM9) _MMU_ARM9_write16(addr,val);
+	if(_MMU_watchActive) MMU_watchedWrite(PROCNUM, AT, addr, val, 2);
+	else if(PROCNUM==ARMCPU_ARM9) _MMU_ARM9_write16(addr,val);
 	else _MMU_ARM7_write16(addr,val);
 #ifdef HAVE_LUA
 	CallRegisteredLuaMemHook(addr, 2, val, LUAMEMHOOK_WRITE);
@@ -950,7 +974,7 @@ FORCEINLINE void _MMU_write32(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 	}
 
 	if(PROCNUM==ARMCPU_ARM9)
-		if((addr&(~0x3FFF)) == MMU.DTCMRegion)
+		if((addr&(~0x3FFF)) == _MMU_DTCM_REGION)
 		{
 			T1WriteLong(MMU.ARM9_DTCM, addr & 0x3FFC, val);
 #ifdef HAVE_LUA
@@ -959,7 +983,7 @@ FORCEINLINE void _MMU_write32(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 			return;
 		}
 
-	if ( (addr & 0x0F000000) == 0x02000000) {
+	if ( (addr & 0x0F000000) == _MMU_MAIN_MEM_REGION) {
 		T1WriteLong( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK32, val);
 #ifdef HAVE_LUA
 		CallRegisteredLuaMemHook(addr, 4, val, LUAMEMHOOK_WRITE);
@@ -967,7 +991,8 @@ FORCEINLINE void _MMU_write32(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 		return;
 	}
 
-	if(PROCNUM==ARMCPU_ARM9) _MMU_ARM9_write32(addr,val);
+	if(_MMU_watchActive) MMU_watchedWrite(PROCNUM, AT, addr, val, 4);
+	else if(PROCNUM==ARMCPU_ARM9) _MMU_ARM9_write32(addr,val);
 	else _MMU_ARM7_write32(addr,val);
 #ifdef HAVE_LUA
 	CallRegisteredLuaMemHook(addr, 4, val, LUAMEMHOOK_WRITE);
@@ -975,22 +1000,6 @@ FORCEINLINE void _MMU_write32(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 }
 
 
-#ifdef MMU_ENABLE_ACL
-	void FASTCALL MMU_write8_acl(u32 proc, u32 adr, u8 val);
-	void FASTCALL MMU_write16_acl(u32 proc, u32 adr, u16 val);
-	void FASTCALL MMU_write32_acl(u32 proc, u32 adr, u32 val);
-	u8 FASTCALL MMU_read8_acl(u32 proc, u32 adr, u32 access);
-	u16 FASTCALL MMU_read16_acl(u32 proc, u32 adr, u32 access);
-	u32 FASTCALL MMU_read32_acl(u32 proc, u32 adr, u32 access);
-#else
-	#define MMU_write8_acl(proc, adr, val)  _MMU_write08<proc>(adr, val)
-	#define MMU_write16_acl(proc, adr, val) _MMU_write16<proc>(adr, val)
-	#define MMU_write32_acl(proc, adr, val) _MMU_write32<proc>(adr, val)
-	#define MMU_read8_acl(proc,adr,access)  _MMU_read08<proc>(adr)
-	#define MMU_read16_acl(proc,adr,access) ((access==CP15_ACCESS_EXECUTE)?_MMU_read16<proc,MMU_AT_CODE>(adr):_MMU_read16<proc,MMU_AT_DATA>(adr))
-	#define MMU_read32_acl(proc,adr,access) ((access==CP15_ACCESS_EXECUTE)?_MMU_read32<proc,MMU_AT_CODE>(adr):_MMU_read32<proc,MMU_AT_DATA>(adr))
-#endif
-
 // Use this macros for reading/writing, so the GDB stub isn't broken
 #ifdef GDB_STUB
 	#define READ32(a,b)		cpu->mem_if->read32(a,(b) & 0xFFFFFFFC)
@@ -1000,12 +1009,13 @@ FORCEINLINE void _MMU_write32(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 	#define READ8(a,b)		cpu->mem_if->read8(a,b)
 	#define WRITE8(a,b,c)	cpu->mem_if->write8(a,b,c)
 #else
-	#define READ32(a,b)		_MMU_read32<PROCNUM>((b) & 0xFFFFFFFC)
-	#define WRITE32(a,b,c)	_MMU_write32<PROCNUM>((b) & 0xFFFFFFFC,c)
-	#define READ16(a,b)		_MMU_read16<PROCNUM>((b) & 0xFFFFFFFE)
-	#define WRITE16(a,b,c)	_MMU_write16<PROCNUM>((b) & 0xFFFFFFFE,c)
-	#define READ8(a,b)		_MMU_read08<PROCNUM>(b)
-	#define WRITE8(a,b,c)	_MMU_write08<PROCNUM>(b, c)
+	//the MPU checked accessors are in cp15.h
+	#define READ32(a,b)		MMU_read32_acl<PROCNUM>((b) & 0xFFFFFFFC)
+	#define WRITE32(a,b,c)	MMU_write32_acl<PROCNUM>((b) & 0xFFFFFFFC,c)
+	#define READ16(a,b)		MMU_read16_acl<PROCNUM>((b) & 0xFFFFFFFE)
+	#define WRITE16(a,b,c)	MMU_write16_acl<PROCNUM>((b) & 0xFFFFFFFE,c)
+	#define READ8(a,b)		MMU_read8_acl<PROCNUM>(b)
+	#define WRITE8(a,b,c)	MMU_write8_acl<PROCNUM>(b, c)
 #endif
 
 template<int PROCNUM, MMU_ACCESS_TYPE AT>
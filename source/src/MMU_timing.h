@@ -45,13 +45,17 @@
 	//(SOMETIMES THIS IS A BIG SPEED HIT!)
 
 	// enables emulation of code fetch waits.
+	// without it code fetches take a cycle each and never reach the instruction cache model below,
+	// so the instruction cache and its c7,c5 and c7,c13 operations only keep their state up to date.
 //#define ACCOUNT_FOR_CODE_FETCH_CYCLES
 
 	// makes access to DTCM (arm9 only) fast.
 #define ACCOUNT_FOR_DATA_TCM_SPEED
 
-	// enables simulation of cache hits and cache misses.
-//#define ENABLE_CACHE_CONTROLLER_EMULATION
+	// enables simulation of cache hits and cache misses, and of the write buffer.
+	// on its own this times the data cache and the write buffer; the instruction cache
+	// also needs ACCOUNT_FOR_CODE_FETCH_CYCLES.
+#define ENABLE_CACHE_CONTROLLER_EMULATION
 
 //
 ////////////////////////////////////////////////////////////////
@@ -63,109 +67,303 @@ enum MMU_ACCESS_DIRECTION
 };
 
 
-// note that we don't actually emulate the cache contents here,
-// only enough to guess what would be a cache hit or a cache miss.
-// this doesn't really get used unless ENABLE_CACHE_CONTROLLER_EMULATION is defined.
+// the arm946e-s caches, as far as timing goes: the tag, valid and dirty state of every line,
+// round-robin or pseudo-random replacement, lockdown and the cp15 maintenance operations.
+// the cached data itself isn't kept; memory is always read and written directly.
 template<int SIZESHIFT, int ASSOCIATIVESHIFT, int BLOCKSIZESHIFT>
 class CacheController
 {
 public:
-	template<MMU_ACCESS_DIRECTION DIR>
-	FORCEINLINE bool Cached(u32 addr)
+	// true when addr is in the line hit last, which is known to be resident
+	FORCEINLINE bool Memo(u32 addr) const
 	{
-		u32 blockMasked = addr & BLOCKMASK;
-		if(blockMasked == m_cacheCache)
-			return true;
-		else
-			return this->CachedInternal<DIR>(addr, blockMasked);
+		return (addr & LINEMASK) == m_lastLine;
+	}
+
+	// the way holding addr, or -1
+	FORCEINLINE int Lookup(u32 addr)
+	{
+		if(Memo(addr))
+			return m_lastWay;
+		return this->LookupInternal(addr);
+	}
+
+	// allocates a line for addr after a read miss.
+	// returns true when the line it replaced was dirty and has to be written back
+	bool Fill(u32 addr)
+	{
+		CacheSet& set = m_sets[SetIndex(addr)];
+		const int way = this->Victim();
+		const bool dirty = (set.tag[way] & VALID) && ((set.dirty >> way) & 1);
+		set.tag[way] = (addr & TAGMASK) | VALID;
+		set.dirty &= ~(1 << way);
+		m_lastLine = addr & LINEMASK;
+		m_lastWay = way;
+		return dirty;
+	}
+
+	FORCEINLINE void SetDirty(u32 addr, int way)
+	{
+		m_sets[SetIndex(addr)].dirty |= 1 << way;
+	}
+
+	// the cp15 c7 operations on a single line, given by address or, with byIndex, by set and way
+	// (the way in the top bits, the set above the line offset). returns true when a dirty line was
+	// written back
+	bool Maintain(u32 operand, bool byIndex, bool clean, bool invalidate)
+	{
+		int way;
+		if(byIndex)
+			way = operand >> (32 - ASSOCIATIVESHIFT);
+		else if((way = this->Lookup(operand)) < 0)
+			return false;
+
+		CacheSet& set = m_sets[SetIndex(operand)];
+		const u8 bit = 1 << way;
+		const bool dirty = clean && (set.tag[way] & VALID) && (set.dirty & bit);
+		if(clean || invalidate)
+			set.dirty &= ~bit;
+		if(invalidate)
+		{
+			set.tag[way] = 0;
+			this->ForgetLast();
+		}
+		return dirty;
 	}
-	
+
+	void InvalidateAll()
+	{
+		for(int i = 0; i < NUMSETS; i++)
+			m_sets[i].Reset();
+		this->ForgetLast();
+	}
+
+	// the memo has to go whenever the memory attributes change
+	FORCEINLINE void ForgetLast()
+	{
+		m_lastLine = ~0;
+		m_lastWay = -1;
+	}
+
+	// cp15 c9,c0: the ways below the lockdown base are never replaced,
+	// and with the load bit set every fill goes to the base way itself
+	void SetLockdown(u32 reg) { m_lockdown = reg; }
+	void SetRoundRobin(bool roundRobin) { m_roundRobin = roundRobin; }
+
 	void Reset()
 	{
-		for(int blockIndex = 0; blockIndex < NUMBLOCKS; blockIndex++)
-			m_blocks[blockIndex].Reset();
-		m_cacheCache = ~0;
+		this->InvalidateAll();
+		m_victim = 0;
+		m_random = 1;
+		m_lockdown = 0;
+		m_roundRobin = false;
 	}
 	CacheController()
 	{
 		Reset();
 	}
-	
+
 	void savestate(EMUFILE* os, int version)
 	{
-		write32le(m_cacheCache, os);
-		for(int i = 0; i < NUMBLOCKS; i++)
+		for(int i = 0; i < NUMSETS; i++)
 		{
-			for(int j = 0; j < ASSOCIATIVITY; j++)
-				write32le(m_blocks[i].tag[j],os);
-			write32le(m_blocks[i].nextWay,os);
+			writeArrayLE(m_sets[i].tag, ASSOCIATIVITY, os);
+			write8le(m_sets[i].dirty, os);
 		}
+		write32le(m_victim, os);
+		write32le(m_random, os);
+		write32le(m_lockdown, os);
+		write8le(m_roundRobin ? 1 : 0, os);
 	}
 	bool loadstate(EMUFILE* is, int version)
 	{
-		read32le(&m_cacheCache, is);
-		for(int i = 0; i < NUMBLOCKS; i++)
+		if(version < 4)
+		{
+			// only the tags were kept, without valid bits. skip them and start cold
+			u32 skip;
+			for(int i = 0; i < 1 + NUMSETS * (ASSOCIATIVITY + 1); i++)
+				read32le(&skip, is);
+			Reset();
+			return true;
+		}
+
+		for(int i = 0; i < NUMSETS; i++)
 		{
-			for(int j = 0; j < ASSOCIATIVITY; j++)
-				read32le(&m_blocks[i].tag[j],is);
-			read32le(&m_blocks[i].nextWay,is);
+			readArrayLE(m_sets[i].tag, ASSOCIATIVITY, is);
+			read8le(&m_sets[i].dirty, is);
 		}
+		read32le(&m_victim, is);
+		read32le(&m_random, is);
+		read32le(&m_lockdown, is);
+		u8 roundRobin;
+		read8le(&roundRobin, is);
+		m_roundRobin = roundRobin != 0;
+		this->ForgetLast();
 		return true;
 	}
 
 private:
-	template<MMU_ACCESS_DIRECTION DIR>
-	bool CachedInternal(u32 addr, u32 blockMasked)
+	int LookupInternal(u32 addr)
 	{
-		u32 blockIndex = blockMasked >> BLOCKSIZESHIFT;
-		CacheBlock& block = m_blocks[blockIndex];
-		addr &= TAGMASK;
+		const CacheSet& set = m_sets[SetIndex(addr)];
+		const u32 key = (addr & TAGMASK) | VALID;
 
+		// all ways are compared at once into a hit mask, without branching; at most one bit can be set
+		u32 hits = 0;
 		for(int way = 0; way < ASSOCIATIVITY; way++)
-			if(addr == block.tag[way])
-			{
-				// found it, already allocated
-				m_cacheCache = blockMasked;
-				return true;
-			}
-		if(DIR == MMU_AD_READ)
+			hits |= (u32)(set.tag[way] == key) << way;
+
+		static const s8 wayOfHit[16] = { -1, 0, 1, -1, 2, -1, -1, -1, 3, -1, -1, -1, -1, -1, -1, -1 };
+		const int way = wayOfHit[hits];
+		if(way >= 0)
 		{
-			// TODO: support other allocation orders?
-			block.tag[block.nextWay++] = addr;
-			block.nextWay %= ASSOCIATIVITY;
-			m_cacheCache = blockMasked;
+			m_lastLine = addr & LINEMASK;
+			m_lastWay = way;
 		}
-		return false;
+		return way;
 	}
 
+	int Victim()
+	{
+		const u32 base = m_lockdown & (ASSOCIATIVITY - 1);
+		if(m_lockdown & 0x80000000)
+			return base;
+
+		if(m_roundRobin)
+		{
+			if(m_victim < base || m_victim >= ASSOCIATIVITY)
+				m_victim = base;
+			return m_victim++;
+		}
+
+		m_random = m_random * 1103515245 + 12345;
+		return base + (m_random >> 16) % (ASSOCIATIVITY - base);
+	}
+
+	static FORCEINLINE u32 SetIndex(u32 addr) { return (addr >> BLOCKSIZESHIFT) & (NUMSETS - 1); }
+
 	enum { SIZE = 1 << SIZESHIFT };
 	enum { ASSOCIATIVITY = 1 << ASSOCIATIVESHIFT };
 	enum { BLOCKSIZE = 1 << BLOCKSIZESHIFT };
+	enum { NUMSETS = SIZE / (ASSOCIATIVITY * BLOCKSIZE) };
 	enum { TAGSHIFT = SIZESHIFT - ASSOCIATIVESHIFT };
 	enum { TAGMASK = (u32)(~0U << TAGSHIFT) };
-	enum { BLOCKMASK = ((u32)~0U >> (32 - TAGSHIFT)) & (u32)(~0U << BLOCKSIZESHIFT) };
-	enum { WORDSIZE = sizeof(u32) };
-	enum { WORDSPERBLOCK = (1 << BLOCKSIZESHIFT) / WORDSIZE };
-	enum { DATAPERWORD = WORDSIZE * ASSOCIATIVITY };
-	enum { DATAPERBLOCK = DATAPERWORD * WORDSPERBLOCK };
-	enum { NUMBLOCKS = SIZE / DATAPERBLOCK };
+	enum { LINEMASK = (u32)(~0U << BLOCKSIZESHIFT) };
+	enum { VALID = 1 }; // below the tag, so a valid tag never matches an empty way
+	CTASSERT(ASSOCIATIVITY <= 4);
 
-	struct CacheBlock
+	struct CacheSet
 	{
 		u32 tag [ASSOCIATIVITY];
-		u32 nextWay;
+		u8 dirty; // one bit per way
 
 		void Reset()
 		{
-			nextWay = 0;
+			dirty = 0;
 			for(int way = 0; way < ASSOCIATIVITY; way++)
 				tag[way] = 0;
 		}
 	};
 
-	u32 m_cacheCache; // optimization
+	// the line of the last hit and its way
+	u32 m_lastLine;
+	int m_lastWay;
+
+	u32 m_victim;
+	u32 m_random;
+	u32 m_lockdown;
+	bool m_roundRobin;
+
+	CacheSet m_sets [NUMSETS];
+};
+
+
+// the arm9 write buffer. writes to bufferable memory are queued and go out on the bus
+// in the background, so the cpu only waits when every entry is taken. reads which go out
+// on the bus wait until it is empty, since they share that bus.
+// its clock only moves by the cycles handed out for accesses outside the tcms, which is
+// less than the time really passing, so it errs on the side of stalling.
+class WriteBuffer
+{
+public:
+	// queues a write which keeps the bus busy for cost cycles.
+	// returns the cycles the cpu waits for a free entry
+	FORCEINLINE u32 Push(u32 cost)
+	{
+		this->Retire();
+		u32 stall = 0;
+		if(m_count == ENTRIES)
+		{
+			stall = m_done[m_head] - m_clock;
+			m_clock += stall;
+			this->Retire();
+		}
+		const u32 start = m_count ? m_done[(m_head + m_count - 1) % ENTRIES] : m_clock;
+		m_done[(m_head + m_count) % ENTRIES] = start + cost;
+		m_count++;
+		return stall;
+	}
+
+	// returns the cycles until every queued write is done, which empties the buffer
+	FORCEINLINE u32 Drain()
+	{
+		this->Retire();
+		if(!m_count)
+			return 0;
+		const u32 stall = m_done[(m_head + m_count - 1) % ENTRIES] - m_clock;
+		m_clock += stall;
+		m_count = 0;
+		return stall;
+	}
+
+	FORCEINLINE void Tick(u32 cycles)
+	{
+		m_clock += cycles;
+	}
+
+	void Reset()
+	{
+		m_clock = 0;
+		m_head = 0;
+		m_count = 0;
+		for(int i = 0; i < ENTRIES; i++)
+			m_done[i] = 0;
+	}
+	WriteBuffer() { this->Reset(); }
+
+	void savestate(EMUFILE* os, int version)
+	{
+		write32le(m_clock, os);
+		write32le(m_head, os);
+		write32le(m_count, os);
+		writeArrayLE(m_done, ENTRIES, os);
+	}
+	bool loadstate(EMUFILE* is, int version)
+	{
+		read32le(&m_clock, is);
+		read32le(&m_head, is);
+		read32le(&m_count, is);
+		readArrayLE(m_done, ENTRIES, is);
+		return m_head < ENTRIES && m_count <= ENTRIES;
+	}
 
-	CacheBlock m_blocks [NUMBLOCKS];
+private:
+	// drops the writes which are done by now
+	FORCEINLINE void Retire()
+	{
+		while(m_count && (s32)(m_done[m_head] - m_clock) <= 0)
+		{
+			m_head = (m_head + 1) % ENTRIES;
+			m_count--;
+		}
+	}
+
+	enum { ENTRIES = 8 };
+
+	u32 m_clock;
+	u32 m_head;
+	u32 m_count;
+	u32 m_done [ENTRIES]; // when each queued write is finished, oldest first from m_head
 };
 
 
@@ -228,8 +426,9 @@ struct MMU_struct_timing
 {
 	// technically part of the cp15, but I didn't want the dereferencing penalty.
 	// these template values correspond with the value of armcp15->cacheType.
-	CacheController<13,2,5> arm9codeCache; // 8192 bytes, 4-way associative, 32-byte blocks
+	CacheController<13,2,5> arm9codeCache; // 8192 bytes, 4-way associative, 32-byte blocks. only timed with ACCOUNT_FOR_CODE_FETCH_CYCLES
 	CacheController<12,2,5> arm9dataCache; // 4096 bytes, 4-way associative, 32-byte blocks
+	WriteBuffer arm9writeBuffer;
 
 	// technically part of armcpu_t, but that struct isn't templated on PROCNUM
 	FetchAccessUnit<0,MMU_AT_CODE> arm9codeFetch;
@@ -250,59 +449,15 @@ extern MMU_struct_timing MMU_timing;
 
 
 
-// calculates the time a single memory access takes,
-// in units of cycles of the current processor.
-// this function replaces what used to be MMU_WAIT16 and MMU_WAIT32.
-// this may have side effects, so don't call it more than necessary.
-template<int PROCNUM, MMU_ACCESS_TYPE AT, int READSIZE, MMU_ACCESS_DIRECTION DIRECTION>
-FORCEINLINE u32 _MMU_accesstime(u32 addr, bool sequential)
+// the time an access takes on the bus, going by the memory region alone.
+template<int PROCNUM, int READSIZE>
+FORCEINLINE u32 _MMU_buswait(u32 addr, bool sequential)
 {
 	static const int MC = 1; // cached or tcm memory speed
 	static const int M32 = (PROCNUM==ARMCPU_ARM9) ? 2 : 1; // access through 32-bit bus
 	static const int M16 = M32 * ((READSIZE>16) ? 2 : 1); // access through 16-bit bus
 	static const int MSLW = M16 * 8; // this needs tuning
 
-	if(PROCNUM==ARMCPU_ARM9 && AT == MMU_AT_CODE && addr < 0x02000000)
-		return MC; // ITCM
-
-#ifdef ACCOUNT_FOR_DATA_TCM_SPEED
-	if(PROCNUM==ARMCPU_ARM9 && AT==MMU_AT_DATA && (addr&(~0x3FFF)) == MMU.DTCMRegion)
-		return MC; // DTCM
-#endif
-
-	// for now, assume the cache is always enabled for all of main memory
-	if(PROCNUM==ARMCPU_ARM9 && (addr & 0x0F000000) == 0x02000000)
-	{
-#ifdef ENABLE_CACHE_CONTROLLER_EMULATION
-		bool cached = false;
-		if(AT==MMU_AT_CODE)
-			cached = MMU_timing.arm9codeCache.Cached<DIRECTION>(addr);
-		if(AT==MMU_AT_DATA)
-			cached = MMU_timing.arm9dataCache.Cached<DIRECTION>(addr);
-		if(cached)
-			return MC;
-		u32 c;
-		if(sequential && AT==MMU_AT_DATA)
-			c = M16; // bonus for sequential data access
-		else if(DIRECTION == MMU_AD_READ)
-			c = M16 * 5;
-		else
-			c = M16 * 2; // should be 4, but write buffer isn't emulated yet.
-		if(DIRECTION == MMU_AD_READ)
-		{
-			// cache miss while reading means it has to fill a whole cache line
-			// by reading 32 bytes...
-			c += 8 * M32*2;
-		}
-		return c;
-#elif defined(ACCOUNT_FOR_NON_SEQUENTIAL_ACCESS)
-		// this is the closest approximation I could find
-		// to the with-cache-controller timing
-		// that doesn't do any actual caching logic.
-		return sequential ? MC : M16;
-#endif
-	}
-
 	static const TWaitState MMU_WAIT[16*16] = {
         // ITCM, ITCM, MAIN, SWI, REG, VMEM, LCD, OAM,  ROM,  ROM,  RAM,   U,  U,  U,  U, BIOS
 #define X    MC,   MC,  M16, M32, M32,  M16, M16, M32, MSLW, MSLW, MSLW, M32,M32,M32,M32,  M32,
@@ -326,6 +481,121 @@ FORCEINLINE u32 _MMU_accesstime(u32 addr, bool sequential)
 	return c;
 }
 
+// arm9 access time through the caches and the write buffer, for everything outside the tcms.
+// whether an address is cached and whether its writes are buffered comes from the protection unit
+// regions: cached+buffered is write-back, cached alone write-through, buffered alone goes
+// through the write buffer only. read misses fill a whole line; writes never allocate one.
+template<MMU_ACCESS_TYPE AT, int READSIZE, MMU_ACCESS_DIRECTION DIRECTION>
+FORCEINLINE u32 _MMU_arm9cachedtime(u32 addr, bool sequential)
+{
+	static const int MC = 1; // cached memory speed
+	static const int M32 = 2; // access through 32-bit bus
+	static const int M16 = M32 * ((READSIZE>16) ? 2 : 1); // access through 16-bit bus
+
+	// a read in the line hit last needs neither the region attributes nor a tag lookup
+	if(DIRECTION == MMU_AD_READ)
+	{
+		if(AT==MMU_AT_CODE && MMU_timing.arm9codeCache.Memo(addr))
+			return MC;
+		if(AT!=MMU_AT_CODE && MMU_timing.arm9dataCache.Memo(addr))
+			return MC;
+	}
+
+	const u8 attr = armcp15_memAttr((armcp15_t*)NDS_ARM9.coproc[15], addr);
+	WriteBuffer& writeBuffer = MMU_timing.arm9writeBuffer;
+
+	u32 read, write, lineWord;
+	if((addr & 0x0F000000) == 0x02000000)
+	{
+		read = (sequential && AT==MMU_AT_DATA) ? M16 : M16 * 5; // bonus for sequential data access
+		write = M16 * 4;
+		lineWord = M32 * 2;
+	}
+	else
+	{
+		read = write = _MMU_buswait<ARMCPU_ARM9,READSIZE>(addr, sequential);
+		lineWord = _MMU_buswait<ARMCPU_ARM9,32>(addr, true);
+	}
+
+	if(AT==MMU_AT_CODE)
+	{
+		if(!(attr & CP15_ATTR_ICACHE))
+			return writeBuffer.Drain() + read;
+		if(MMU_timing.arm9codeCache.Lookup(addr) >= 0)
+			return MC;
+		// instruction lines are never dirty
+		MMU_timing.arm9codeCache.Fill(addr);
+		return writeBuffer.Drain() + read + 8 * lineWord;
+	}
+
+	if(DIRECTION == MMU_AD_READ)
+	{
+		if(!(attr & CP15_ATTR_DCACHE))
+			return writeBuffer.Drain() + read;
+		if(MMU_timing.arm9dataCache.Lookup(addr) >= 0)
+			return MC;
+		u32 c = writeBuffer.Drain() + read + 8 * lineWord;
+		// the victim goes out behind the fill
+		if(MMU_timing.arm9dataCache.Fill(addr))
+			c += writeBuffer.Push(8 * lineWord);
+		return c;
+	}
+
+	if(attr & CP15_ATTR_DCACHE)
+	{
+		const int way = MMU_timing.arm9dataCache.Lookup(addr);
+		if(way >= 0 && (attr & CP15_ATTR_BUFFER))
+		{
+			MMU_timing.arm9dataCache.SetDirty(addr, way);
+			return MC;
+		}
+	}
+	if(attr & (CP15_ATTR_DCACHE | CP15_ATTR_BUFFER))
+		return MC + writeBuffer.Push(write);
+	return writeBuffer.Drain() + write;
+}
+
+// calculates the time a single memory access takes,
+// in units of cycles of the current processor.
+// this function replaces what used to be MMU_WAIT16 and MMU_WAIT32.
+// this may have side effects, so don't call it more than necessary.
+template<int PROCNUM, MMU_ACCESS_TYPE AT, int READSIZE, MMU_ACCESS_DIRECTION DIRECTION>
+FORCEINLINE u32 _MMU_accesstime(u32 addr, bool sequential)
+{
+	static const int MC = 1; // cached or tcm memory speed
+
+	if(PROCNUM==ARMCPU_ARM9 && AT == MMU_AT_CODE && addr < 0x02000000)
+		return MC; // ITCM
+
+#ifdef ACCOUNT_FOR_DATA_TCM_SPEED
+	if(PROCNUM==ARMCPU_ARM9 && AT==MMU_AT_DATA && (addr&(~0x3FFF)) == MMU.DTCMRegion)
+		return MC; // DTCM
+#endif
+
+#ifdef ENABLE_CACHE_CONTROLLER_EMULATION
+	if(PROCNUM==ARMCPU_ARM9)
+	{
+		const u32 c = _MMU_arm9cachedtime<AT,READSIZE,DIRECTION>(addr, sequential);
+		MMU_timing.arm9writeBuffer.Tick(c);
+		return c;
+	}
+#elif defined(ACCOUNT_FOR_NON_SEQUENTIAL_ACCESS)
+	static const int M32 = (PROCNUM==ARMCPU_ARM9) ? 2 : 1; // access through 32-bit bus
+	static const int M16 = M32 * ((READSIZE>16) ? 2 : 1); // access through 16-bit bus
+
+	// for now, assume the cache is always enabled for all of main memory
+	if(PROCNUM==ARMCPU_ARM9 && (addr & 0x0F000000) == 0x02000000)
+	{
+		// this is the closest approximation I could find
+		// to the with-cache-controller timing
+		// that doesn't do any actual caching logic.
+		return sequential ? MC : M16;
+	}
+#endif
+
+	return _MMU_buswait<PROCNUM,READSIZE>(addr, sequential);
+}
+
 
 
 
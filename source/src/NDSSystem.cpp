@@ -42,6 +42,12 @@
 #include "debug.h"
 #include "GPU.h"
 #include "firmware.h"
+#include "screenshot.h"
+#include "record.h"
+#include "guestprofiler.h"
+#include "cputrace.h"
+#include "bootcache.h"
+#include "addons.h"
 
 #include "path.h"
 #include "log.h"
@@ -66,6 +72,7 @@ using std::max;
 
 int lagframecounter;
 int LagFrameFlag;
+static bool speculative = false;
 int lastLag;
 int TotalLagFrames;
 
@@ -200,6 +207,10 @@ int NDS_Init( void) {
 }
 
 void NDS_DeInit(void) {
+	CpuTrace_Stop();
+	GuestProfiler_Stop();
+	Record_End();
+	Screenshot_Shutdown();
 	Log_DeInit();
 	if(MMU.CART_ROM != MMU.UNUSED_RAM)
 		NDS_FreeROM();
@@ -658,140 +669,6 @@ bool NDS_ExportSave(const char *filename)
 
 	return false;
 }
-/*
-static int WritePNGChunk(FILE *fp, uint32 size, const char *type, const uint8 *data)
-{
-	uint32 crc;
-
-	uint8 tempo[4];
-
-	tempo[0]=size>>24;
-	tempo[1]=size>>16;
-	tempo[2]=size>>8;
-	tempo[3]=size;
-
-	if(fwrite(tempo,4,1,fp)!=1)
-		return 0;
-	if(fwrite(type,4,1,fp)!=1)
-		return 0;
-
-	if(size)
-		if(fwrite(data,1,size,fp)!=size)
-			return 0;
-
-	crc = crc32(0,(uint8 *)type,4);
-	if(size)
-		crc = crc32(crc,data,size);
-
-	tempo[0]=crc>>24;
-	tempo[1]=crc>>16;
-	tempo[2]=crc>>8;
-	tempo[3]=crc;
-
-	if(fwrite(tempo,4,1,fp)!=1)
-		return 0;
-	return 1;
-}
-
-int NDS_WritePNG(const char *fname)
-{
-	int x, y;
-	int width=256;
-	int height=192*2;
-	u16 * bmp = (u16 *)GPU_screen;
-	FILE *pp=NULL;
-	uint8 *compmem = NULL;
-	uLongf compmemsize = (uLongf)( (height * (width + 1) * 3 * 1.001 + 1) + 12 );
-
-	if(!(compmem=(uint8 *)malloc(compmemsize)))
-		return 0;
-
-	if(!(pp=fopen(fname, "wb")))
-	{
-		return 0;
-	}
-	{
-		static uint8 header[8]={137,80,78,71,13,10,26,10};
-		if(fwrite(header,8,1,pp)!=1)
-			goto PNGerr;
-	}
-
-	{
-		uint8 chunko[13];
-
-		chunko[0] = width >> 24;		// Width
-		chunko[1] = width >> 16;
-		chunko[2] = width >> 8;
-		chunko[3] = width;
-
-		chunko[4] = height >> 24;		// Height
-		chunko[5] = height >> 16;
-		chunko[6] = height >> 8;
-		chunko[7] = height;
-
-		chunko[8]=8;				// 8 bits per sample(24 bits per pixel)
-		chunko[9]=2;				// Color type; RGB triplet
-		chunko[10]=0;				// compression: deflate
-		chunko[11]=0;				// Basic adapative filter set(though none are used).
-		chunko[12]=0;				// No interlace.
-
-		if(!WritePNGChunk(pp,13,"IHDR",chunko))
-			goto PNGerr;
-	}
-
-	{
-		uint8 *tmp_buffer;
-		uint8 *tmp_inc;
-		tmp_inc = tmp_buffer = (uint8 *)malloc((width * 3 + 1) * height);
-
-		for(y=0;y<height;y++)
-		{
-			*tmp_inc = 0;
-			tmp_inc++;
-			for(x=0;x<width;x++)
-			{
-				int r,g,b;
-				u16 pixel = bmp[y*256+x];
-				r = pixel>>10;
-				pixel-=r<<10;
-				g = pixel>>5;
-				pixel-=g<<5;
-				b = pixel;
-				r*=255/31;
-				g*=255/31;
-				b*=255/31;
-				tmp_inc[0] = b;
-				tmp_inc[1] = g;
-				tmp_inc[2] = r;
-				tmp_inc += 3;
-			}
-		}
-
-		if(compress(compmem, &compmemsize, tmp_buffer, height * (width * 3 + 1))!=Z_OK)
-		{
-			if(tmp_buffer) free(tmp_buffer);
-			goto PNGerr;
-		}
-		if(tmp_buffer) free(tmp_buffer);
-		if(!WritePNGChunk(pp,compmemsize,"IDAT",compmem))
-			goto PNGerr;
-	}
-	if(!WritePNGChunk(pp,0,"IEND",0))
-		goto PNGerr;
-
-	free(compmem);
-	fclose(pp);
-
-	return 1;
-
-PNGerr:
-	if(compmem)
-		free(compmem);
-	if(pp)
-		fclose(pp);
-	return(0);
-}
-//*/
 
 typedef struct
 {
@@ -886,6 +763,15 @@ public:
 		SkipCur3DFrame = skipped;
 		SkipNext2DFrame = skipped;
 	}
+	void Force(bool skip2D, bool skip3D)
+	{
+		//a skipped frame drops its display capture, and with it whatever the game renders to a texture
+		//or blends into the next frame, so a capturing frame always draws its 2D
+		bool capturing = (MainScreen.gpu->dispCapCnt.enabled || (MainScreen.gpu->dispCapCnt.val & 0x80000000));
+		nextSkip = false;
+		SkipCur2DFrame = skip2D && !capturing;
+		SkipCur3DFrame = skip3D;
+	}
 	FORCEINLINE bool ShouldSkip2D()
 	{
 		return SkipCur2DFrame;
@@ -927,6 +813,18 @@ void NDS_SkipNextFrame() {
 void NDS_OmitFrameSkip(int force) {
 	frameSkipper.OmitSkip(force > 0, force > 1);
 }
+void NDS_ForceFrameSkip(bool skip2D, bool skip3D) {
+	frameSkipper.Force(skip2D, skip3D);
+}
+
+void NDS_SetSpeculative(bool enable) {
+	speculative = enable;
+	SPU_SetSpeculative(enable);
+}
+
+bool NDS_IsSpeculative() {
+	return speculative;
+}
 
 #define INDEX(i) ((((i)>>16)&0xFF0)|(((i)>>4)&0xF))
 
@@ -1197,9 +1095,8 @@ struct Sequencer
 
 	void save(EMUFILE* os)
 	{
-		write64le(nds_timer,os);
-		write64le(nds_arm9_timer,os);
-		write64le(nds_arm7_timer,os);
+		const u64 timers[3] = { nds_timer, nds_arm9_timer, nds_arm7_timer };
+		writeArrayLE(timers,3,os);
 		dispcnt.save(os);
 		divider.save(os);
 		sqrtunit.save(os);
@@ -1215,9 +1112,11 @@ struct Sequencer
 
 	bool load(EMUFILE* is, int version)
 	{
-		if(read64le(&nds_timer,is) != 1) return false;
-		if(read64le(&nds_arm9_timer,is) != 1) return false;
-		if(read64le(&nds_arm7_timer,is) != 1) return false;
+		u64 timers[3];
+		if(readArrayLE(timers,3,is) != 1) return false;
+		nds_timer = timers[0];
+		nds_arm9_timer = timers[1];
+		nds_arm7_timer = timers[2];
 		if(!dispcnt.load(is)) return false;
 		if(!divider.load(is)) return false;
 		if(!sqrtunit.load(is)) return false;
@@ -1338,8 +1237,8 @@ static void execHardware_hblank()
 	//emulation housekeeping. for some reason we always do this at hblank,
 	//even though it sounds more reasonable to do it at hstart
 	SPU_Emulate_core();
-//	driver->AVI_SoundUpdate(SPU_core->outbuf,spu_core_samples);
-//	WAV_WavSoundUpdate(SPU_core->outbuf,spu_core_samples);
+	if(!speculative)
+		Record_SoundUpdate(SPU_core->outbuf,spu_core_samples);
 
 	//this logic was formerly at hblank time. it was moved to the beginning of the scanline on a whim
 	if(nds.VCount<192)
@@ -1613,49 +1512,8 @@ bool nds_loadstate(EMUFILE* is, int size)
 	return temp;
 }
 
-FORCEINLINE void arm9log()
-{
-#ifdef LOG_ARM9
-	if(dolog)
-	{
-		char dasmbuf[4096];
-		if(NDS_ARM9.CPSR.bits.T)
-			des_thumb_instructions_set[((NDS_ARM9.instruction)>>6)&1023](NDS_ARM9.instruct_adr, NDS_ARM9.instruction, dasmbuf);
-		else
-			des_arm_instructions_set[INDEX(NDS_ARM9.instruction)](NDS_ARM9.instruct_adr, NDS_ARM9.instruction, dasmbuf);
-
-		printf("%05d %12lld 9:%08X %08X %-30s R00:%08X R01:%08X R02:%08X R03:%08X R04:%08X R05:%08X R06:%08X R07:%08X R08:%08X R09:%08X R10:%08X R11:%08X R12:%08X R13:%08X R14:%08X R15:%08X\n",
-			currFrameCounter, nds_timer, 
-			NDS_ARM9.instruct_adr,NDS_ARM9.instruction, dasmbuf, 
-			NDS_ARM9.R[0],  NDS_ARM9.R[1],  NDS_ARM9.R[2],  NDS_ARM9.R[3],  NDS_ARM9.R[4],  NDS_ARM9.R[5],  NDS_ARM9.R[6],  NDS_ARM9.R[7], 
-			NDS_ARM9.R[8],  NDS_ARM9.R[9],  NDS_ARM9.R[10],  NDS_ARM9.R[11],  NDS_ARM9.R[12],  NDS_ARM9.R[13],  NDS_ARM9.R[14],  NDS_ARM9.R[15]);  
-	}
-#endif
-}
-
-FORCEINLINE void arm7log()
-{
-#ifdef LOG_ARM7
-	if(dolog)
-	{
-		char dasmbuf[4096];
-		if(NDS_ARM7.CPSR.bits.T)
-			des_thumb_instructions_set[((NDS_ARM7.instruction)>>6)&1023](NDS_ARM7.instruct_adr, NDS_ARM7.instruction, dasmbuf);
-		else
-			des_arm_instructions_set[INDEX(NDS_ARM7.instruction)](NDS_ARM7.instruct_adr, NDS_ARM7.instruction, dasmbuf);
-		
-		printf("%05d %12lld 7:%08X %08X %-30s R00:%08X R01:%08X R02:%08X R03:%08X R04:%08X R05:%08X R06:%08X R07:%08X R08:%08X R09:%08X R10:%08X R11:%08X R12:%08X R13:%08X R14:%08X R15:%08X\n",
-			currFrameCounter, nds_timer, 
-			NDS_ARM7.instruct_adr,NDS_ARM7.instruction, dasmbuf, 
-			NDS_ARM7.R[0],  NDS_ARM7.R[1],  NDS_ARM7.R[2],  NDS_ARM7.R[3],  NDS_ARM7.R[4],  NDS_ARM7.R[5],  NDS_ARM7.R[6],  NDS_ARM7.R[7], 
-			NDS_ARM7.R[8],  NDS_ARM7.R[9],  NDS_ARM7.R[10],  NDS_ARM7.R[11],  NDS_ARM7.R[12],  NDS_ARM7.R[13],  NDS_ARM7.R[14],  NDS_ARM7.R[15]);
-	}
-#endif
-}
-
 //these have not been tuned very well yet.
 static const int kMaxWork = 4000;
-static const int kIrqWait = 4000;
 
 
 template<bool doarm9, bool doarm7>
@@ -1670,6 +1528,36 @@ static FORCEINLINE s32 minarmtime(s32 arm9, s32 arm7)
 		return arm7;
 }
 
+//armcpu_exec with the executed instruction reported to the guest profiler
+template<int PROCNUM>
+static FORCEINLINE u32 armcpu_exec_profiled()
+{
+	armcpu_t &cpu = PROCNUM ? NDS_ARM7 : NDS_ARM9;
+	const u32 adr = cpu.instruct_adr;
+	const u32 instruction = cpu.instruction;
+	const bool thumb = cpu.CPSR.bits.T;
+	const u32 cycles = armcpu_exec<PROCNUM>();
+	GuestProfiler_Step<PROCNUM>(adr, instruction, thumb, cycles);
+	return cycles;
+}
+
+//takes a pending irq as soon as the cpu has it unmasked. raising an irq or changing IE/IME
+//is seen through MMU.irqPending; a CPSR write which clears the I bit is caught here, at the
+//next instruction boundary, instead of waiting for the next hardware event
+template<int PROCNUM>
+static FORCEINLINE void armcpu_checkIRQ()
+{
+	armcpu_t &cpu = PROCNUM ? NDS_ARM7 : NDS_ARM9;
+	if(MMU.irqPending[PROCNUM] && !cpu.CPSR.bits.I)
+	{
+#ifdef GDB_STUB
+		armcpu_flagIrq(&cpu);
+#else
+		armcpu_irqException(&cpu);
+#endif
+	}
+}
+
 template<bool doarm9, bool doarm7>
 static /*donotinline*/ std::pair<s32,s32> armInnerLoop(
 	const u64 nds_timer_base, const s32 s32next, s32 arm9, s32 arm7)
@@ -1681,31 +1569,51 @@ static /*donotinline*/ std::pair<s32,s32> armInnerLoop(
 		{
 			if(!NDS_ARM9.waitIRQ)
 			{
-				arm9log();
-				arm9 += armcpu_exec<ARMCPU_ARM9>();
+				if(cpuTraceActive) CpuTrace_Step<ARMCPU_ARM9>(nds_timer_base + arm9);
+				if(guestProfilerActive)
+					arm9 += armcpu_exec_profiled<ARMCPU_ARM9>();
+				else
+					arm9 += armcpu_exec<ARMCPU_ARM9>();
+				armcpu_checkIRQ<ARMCPU_ARM9>();
 			}
 			else
 			{
+				//halted. only the next hardware event or an irq raised by the arm7 can wake it,
+				//and the latter reschedules, so run the arm7 alone until then and catch up to it
 				s32 temp = arm9;
-				arm9 = min(s32next, arm9 + kIrqWait);
+				if(doarm7)
+				{
+					arm7 = armInnerLoop<false,doarm7>(nds_timer_base, s32next, arm9, arm7).second;
+					arm9 = max(arm9, min(s32next, arm7));
+				}
+				else arm9 = s32next;
 				nds.idleCycles += arm9-temp;
+				nds_timer = nds_timer_base + minarmtime<true,doarm7>(arm9,arm7);
+				return std::make_pair(arm9, arm7);
 			}
 		}
 		if(doarm7 && (!doarm9 || arm7 <= timer))
 		{
 			if(!NDS_ARM7.waitIRQ)
 			{
-				arm7log();
-				arm7 += (armcpu_exec<ARMCPU_ARM7>()<<1);
+				if(cpuTraceActive) CpuTrace_Step<ARMCPU_ARM7>(nds_timer_base + arm7);
+				if(guestProfilerActive)
+					arm7 += (armcpu_exec_profiled<ARMCPU_ARM7>()<<1);
+				else
+					arm7 += (armcpu_exec<ARMCPU_ARM7>()<<1);
+				armcpu_checkIRQ<ARMCPU_ARM7>();
 			}
 			else
 			{
-				arm7 = min(s32next, arm7 + kIrqWait);
-				if(arm7 == s32next)
+				//as above, with the roles swapped
+				if(doarm9)
 				{
-					nds_timer = nds_timer_base + minarmtime<doarm9,false>(arm9,arm7);
-					return armInnerLoop<doarm9,false>(nds_timer_base, s32next, arm9, arm7);
+					arm9 = armInnerLoop<doarm9,false>(nds_timer_base, s32next, arm9, arm7).first;
+					arm7 = max(arm7, min(s32next, arm9));
 				}
+				else arm7 = s32next;
+				nds_timer = nds_timer_base + minarmtime<doarm9,true>(arm9,arm7);
+				return std::make_pair(arm9, arm7);
 			}
 		}
 
@@ -1802,12 +1710,21 @@ void NDS_exec(s32 nb)
 #ifdef _MOVIETIME_
 	currFrameCounter++;
 #endif	
+	if(!speculative)
+	{
+		FrameDump_FrameEnded();
+		Record_FrameEnded();
+		CpuTrace_FrameEnded();
+		BootCache_FrameEnded();
+		//the idle count which flushes the GBA save to disk only runs on real frames
+		addonsFrameEnded();
+	}
 //	cheatsProcess();
 }
 
 void execHardware_interrupts()
 {
-	if((MMU.reg_IF[0]&MMU.reg_IE[0]) && (MMU.reg_IME[0]))
+	if(MMU.irqPending[0])
 	{
 #ifdef GDB_STUB
 		if ( armcpu_flagIrq( &NDS_ARM9)) 
@@ -1820,7 +1737,7 @@ void execHardware_interrupts()
 		}
 	}
 
-	if((MMU.reg_IF[1]&MMU.reg_IE[1]) && (MMU.reg_IME[1]))
+	if(MMU.irqPending[1])
 	{
 #ifdef GDB_STUB
 		if ( armcpu_flagIrq( &NDS_ARM7)) 
@@ -1846,6 +1763,9 @@ void NDS_Reset()
 
 	DEBUG_reset();
 
+	//whatever runs after a reset or a savestate load isn't the boot being cached
+	BootCache_Cancel();
+
 	if (!header) return ;
 
 
@@ -2260,8 +2180,7 @@ static void saveUserInput(EMUFILE* os)
 	saveUserInput(os, finalUserInput);
 	saveUserInput(os, intermediateUserInput); // saved in case a savestate is made during input processing (which Lua could do if nothing else)
 	writebool(validToProcessInput, os);
-	for(int i = 0; i < 14; i++)
-		write32le(TurboTime.array[i], os); // saved to make autofire more tolerable to use with re-recording
+	writeArrayLE((u32*)TurboTime.array, 14, os); // saved to make autofire more tolerable to use with re-recording
 }
 static bool loadUserInput(EMUFILE* is, int version)
 {
@@ -2269,8 +2188,7 @@ static bool loadUserInput(EMUFILE* is, int version)
 	rv &= loadUserInput(is, finalUserInput, version);
 	rv &= loadUserInput(is, intermediateUserInput, version);
 	readbool(&validToProcessInput, is);
-	for(int i = 0; i < 14; i++)
-		read32le((u32*)&TurboTime.array[i], is);
+	readArrayLE((u32*)TurboTime.array, 14, is);
 	return rv;
 }
 static void resetUserInput()
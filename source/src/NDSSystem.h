@@ -67,7 +67,7 @@ extern buttonstruct<bool> Turbo;
 extern buttonstruct<int> TurboTime;
 extern buttonstruct<bool> AutoHold;
 
-//int NDS_WritePNG(const char *fname);
+//screenshots and frame dumps: NDS_WritePNG and FrameDump_Start in screenshot.h
 
 extern volatile bool execute;
 extern BOOL click;
@@ -84,10 +84,6 @@ extern BOOL click;
 #define NDS_FW_LANG_CHI 6
 #define NDS_FW_LANG_RES 7
 
-
-//#define LOG_ARM9
-//#define LOG_ARM7
-
 struct NDS_header
 {
        char     gameTile[12];
@@ -392,6 +388,15 @@ void NDS_Sleep();
 void NDS_SkipNextFrame();
 #define NDS_SkipFrame(s) if(s) NDS_SkipNext2DFrame();
 void NDS_OmitFrameSkip(int force=0);
+//overrides the frameskipper for the next NDS_exec only: whether its 2D lines are drawn, and whether
+//the 3D scene it ends with (shown during the frame after it) is rendered. 2D is drawn anyway while
+//a display capture is on
+void NDS_ForceFrameSkip(bool skip2D, bool skip3D);
+
+//marks the frames which follow as speculative: they will be rolled back by a savestate load, so their
+//audio is silenced and the per-frame output hooks (recording, frame dumps, traces, boot cache) skip them
+void NDS_SetSpeculative(bool enable);
+bool NDS_IsSpeculative();
 
 void execHardware_doAllDma(EDMAMode modeNum);
 
@@ -447,11 +452,15 @@ extern struct TCommonSettings {
 		: GFX3D_HighResolutionInterpolateColor(true)
 		, GFX3D_EdgeMark(true)
 		, GFX3D_Fog(true)
+		, GFX3D_FixedPointGeometry(false)
+		, GFX3D_TiledTextures(true)
 		, UseExtBIOS(false)
 		, SWIFromBIOS(false)
 		, PatchSWI3(false)
 		, UseExtFirmware(false)
 		, BootFromFirmware(false)
+		, BootCache(false)
+		, BootCacheFrame(0)
 		, DebugConsole(false)
 		, EnsataEmulation(false)
 		, cheatsDisable(false)
@@ -482,6 +491,10 @@ extern struct TCommonSettings {
 	bool GFX3D_HighResolutionInterpolateColor;
 	bool GFX3D_EdgeMark;
 	bool GFX3D_Fog;
+	//run the geometry engine in the hardware's 20.12 fixed point. latched by gfx3d_reset
+	bool GFX3D_FixedPointGeometry;
+	//store big decoded textures in tiles for the software rasterizer. applies to textures decoded from then on
+	bool GFX3D_TiledTextures;
 
 	bool UseExtBIOS;
 	char ARM9BIOS[256];
@@ -494,6 +507,11 @@ extern struct TCommonSettings {
 	bool BootFromFirmware;
 	struct NDS_fw_config_data InternalFirmConf;
 
+	//restore the boot from a snapshot after the first run of a rom, see bootcache.h.
+	//the snapshot is taken at frame BootCacheFrame, or at the first keypad read when that is 0
+	bool BootCache;
+	u32 BootCacheFrame;
+
 	bool DebugConsole;
 	bool EnsataEmulation;
 	
@@ -32,6 +32,7 @@
 #include <string.h>
 #include <queue>
 #include <vector>
+#include <algorithm>
 
 #include "debug.h"
 #include "MMU.h"
@@ -41,6 +42,7 @@
 #include "armcpu.h"
 #include "NDSSystem.h"
 #include "matrix.h"
+#include "record.h"
 
 #include "metaspu/metaspu.h"
 
@@ -58,6 +60,7 @@ SPU_struct *SPU_core = 0;
 SPU_struct *SPU_user = 0;
 int SPU_currentCoreNum = SNDCORE_DUMMY;
 static int volume = 100;
+static bool speculative = false;
 
 
 static ESynchMode synchmode = ESynchMode_DualSynchAsynch;
@@ -102,6 +105,14 @@ static const s16 wavedutytbl[8][8] = {
 static s32 precalcdifftbl[89][16];
 static u8 precalcindextbl[89][8];
 
+//the longest ADPCM sample (in nibbles) which gets a decoded cache
+#define ADPCM_CACHE_MAX_SAMPLES 0x10000
+
+//cosine interpolation weights, (1-cos(x*pi))/2 with 14 fractional bits
+#define COSINE_LUT_SIZE 1024
+#define COSINE_LUT_SHIFT 14
+static s32 cos_lut[COSINE_LUT_SIZE];
+
 static const double ARM7_CLOCK = 33513982;
 
 static const double samples_per_hline = (DESMUME_SAMPLE_RATE / 59.8261f) / 263.0f;
@@ -176,14 +187,12 @@ SoundInterface_struct *SPU_SoundCore()
 	return SNDCore;
 }
 
-//static double cos_lut[256];
 int SPU_Init(int coreid, int buffersize)
 {
 	int i, j;
 
-	//for some reason we dont use the cos lut anymore... did someone decide it was slow?
-	//for(int i=0;i<256;i++)
-	//	cos_lut[i] = cos(i/256.0*M_PI);
+	for(i = 0; i < COSINE_LUT_SIZE; i++)
+		cos_lut[i] = (s32)floor((1.0 - cos(i * M_PI / COSINE_LUT_SIZE)) * 0.5 * (1 << COSINE_LUT_SHIFT) + 0.5);
 
 	SPU_core = new SPU_struct((int)ceil(samples_per_hline));
 	SPU_Reset();
@@ -264,7 +273,7 @@ void SPU_Reset(void)
 	}
 
 	// Reset Registers
-	for (i = 0x400; i < 0x51D; i++)
+	for (i = 0x400; i < 0x520; i++)
 		T1WriteByte(MMU.ARM7_REG, i, 0);
 
 	samples = 0;
@@ -276,9 +285,15 @@ void SPU_struct::reset()
 {
 	memset(sndbuf,0,bufsize*2*4);
 	memset(outbuf,0,bufsize*2*2);
+	memset(capchanbuf,0,bufsize*2*4);
+	memset(capsrcbuf[0],0,bufsize*4);
+	memset(capsrcbuf[1],0,bufsize*4);
 
 	memset((void *)channels, 0, sizeof(channel_struct) * 16);
 
+	for(int i = 0; i < 16; i++)
+		adpcmcache[i].invalidate();
+
 	reconstruct(&regs);
 
 	for(int i = 0; i < 16; i++)
@@ -296,6 +311,9 @@ SPU_struct::SPU_struct(int buffersize)
 {
 	sndbuf = new s32[buffersize*2];
 	outbuf = new s16[buffersize*2];
+	capchanbuf = new s32[buffersize*2];
+	capsrcbuf[0] = new s32[buffersize];
+	capsrcbuf[1] = new s32[buffersize];
 	reset();
 }
 
@@ -303,6 +321,14 @@ SPU_struct::~SPU_struct()
 {
 	if(sndbuf) delete[] sndbuf;
 	if(outbuf) delete[] outbuf;
+	delete[] capchanbuf;
+	delete[] capsrcbuf[0];
+	delete[] capsrcbuf[1];
+	for(int i = 0; i < 16; i++)
+	{
+		free(adpcmcache[i].pcm);
+		free(adpcmcache[i].index);
+	}
 }
 
 void SPU_DeInit(void)
@@ -328,6 +354,81 @@ static FORCEINLINE void adjust_channel_timer(channel_struct *chan)
 	chan->sampinc = (((double)ARM7_CLOCK) / (DESMUME_SAMPLE_RATE * 2)) / (double)(0x10000 - chan->timer);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+
+static u32 adpcm_hash(const s8 *buf, u32 from, u32 to)
+{
+	u32 h = 2166136261U;
+	for(u32 i = from; i < to; i++)
+		h = (h ^ (u8)buf[i]) * 16777619U;
+	return h;
+}
+
+//called at key on, once the channel's decoder state is set up
+static void adpcm_cache_prepare(SPU_struct *SPU, const channel_struct &chan)
+{
+	ADPCMCache &cache = SPU->adpcmcache[chan.num];
+	const u32 count = chan.totlength << 3;
+
+	if(count <= 8 || count > ADPCM_CACHE_MAX_SAMPLES)
+	{
+		cache.invalidate();
+		return;
+	}
+
+	//the same sample again, with its data unchanged
+	if(cache.complete && cache.addr == chan.addr && cache.totlength == chan.totlength && cache.loopstart == chan.loopstart
+		&& cache.hash == adpcm_hash(chan.buf8, 0, chan.totlength << 2))
+		return;
+
+	//one more than the length, since the sample counter may land exactly on the end
+	if(cache.capacity < count + 1)
+	{
+		s16 *pcm = (s16*)realloc(cache.pcm, (count + 1) * sizeof(s16));
+		u8 *index = (u8*)realloc(cache.index, count + 1);
+		if(pcm) cache.pcm = pcm;
+		if(index) cache.index = index;
+		if(!pcm || !index)
+		{
+			cache.invalidate();
+			return;
+		}
+		cache.capacity = count + 1;
+	}
+
+	cache.addr = chan.addr;
+	cache.totlength = chan.totlength;
+	cache.loopstart = chan.loopstart;
+	cache.complete = false;
+	cache.pcm[7] = chan.pcm16b;
+	cache.index[7] = chan.index;
+	cache.decoded = 8;
+}
+
+static void adpcm_cache_fill(ADPCMCache &cache, const channel_struct *chan, u32 end)
+{
+	s32 pcm = cache.pcm[cache.decoded - 1];
+	u32 index = cache.index[cache.decoded - 1];
+
+	for(u32 i = cache.decoded; i < end; i++)
+	{
+		const u32 data4bit = ((u32)(u8)chan->buf8[i >> 1]) >> ((i & 1) << 2);
+		const s32 diff = precalcdifftbl[index][data4bit & 0xF];
+		index = precalcindextbl[index][data4bit & 0x7];
+		pcm = MinMax(pcm + diff, -0x8000, 0x7FFF);
+		cache.pcm[i] = (s16)pcm;
+		cache.index[i] = (u8)index;
+	}
+	cache.decoded = end;
+
+	if(end >= (cache.totlength << 3))
+	{
+		cache.complete = true;
+		cache.hash = adpcm_hash(chan->buf8, 0, cache.totlength << 2);
+		cache.loophash = adpcm_hash(chan->buf8, cache.loopstart << 2, cache.totlength << 2);
+	}
+}
+
 void SPU_struct::KeyProbe(int chan_num)
 {
 	channel_struct &thischan = channels[chan_num];
@@ -385,6 +486,7 @@ void SPU_struct::KeyOn(int channel)
 			thischan.lastsampcnt = 7;
 			thischan.sampcnt = -3;
 			thischan.loop_index = K_ADPCM_LOOPING_RECOVERY_INDEX;
+			adpcm_cache_prepare(this, thischan);
 		//	thischan.loopstart = thischan.loopstart << 3;
 		//	thischan.length = (thischan.length << 3) + thischan.loopstart;
 			break;
@@ -478,8 +580,7 @@ void SPUFifo::save(EMUFILE* fp)
 	write32le(head,fp);
 	write32le(tail,fp);
 	write32le(size,fp);
-	for(int i=0;i<16;i++)
-		write16le(buffer[i],fp);
+	writeArrayLE(buffer,16,fp);
 }
 
 bool SPUFifo::load(EMUFILE* fp)
@@ -489,10 +590,68 @@ bool SPUFifo::load(EMUFILE* fp)
 	read32le(&head,fp);
 	read32le(&tail,fp);
 	read32le(&size,fp);
-	for(int i=0;i<16;i++)
-		read16le(&buffer[i],fp);
+	readArrayLE(buffer,16,fp);
 	return true;
 }
+//////////////////////////////////////////////////////////////////////////////
+
+static FORCEINLINE void capture_map_dest(SPU_struct::REGS::CAP &cap)
+{
+	const u32 page = (cap.runtime.curdad >> 20) & 0xFF;
+	cap.runtime.dst = MMU.MMU_MEM[1][page];
+	cap.runtime.dstmask = MMU.MMU_MASK[1][page];
+}
+
+void SPU_struct::ProbeCapture(int which)
+{
+	REGS::CAP &cap = regs.cap[which];
+
+	if(!cap.active)
+	{
+		cap.runtime.running = 0;
+		return;
+	}
+
+	if(cap.runtime.running)
+		return;
+
+	//the length is in words, and a length of 0 acts as 1
+	const u32 len = cap.len ? cap.len : 1;
+	cap.runtime.running = 1;
+	cap.runtime.curdad = cap.dad;
+	cap.runtime.maxdad = cap.dad + len*4;
+	cap.runtime.sampcnt = 0;
+	cap.runtime.fifo.reset();
+	capture_map_dest(cap);
+}
+
+//SNDCAPxCNT at 0x508+x, SNDCAPxDAD at 0x510+x*8, SNDCAPxLEN at 0x514+x*8
+void SPU_struct::WriteCaptureRegs(int which)
+{
+	REGS::CAP &cap = regs.cap[which];
+	const u8 cnt = T1ReadByte(MMU.ARM7_REG, 0x508 + which);
+
+	cap.add = BIT0(cnt);
+	cap.source = BIT1(cnt);
+	cap.oneshot = BIT2(cnt);
+	cap.bits8 = BIT3(cnt);
+	cap.active = BIT7(cnt);
+	cap.dad = T1ReadLong(MMU.ARM7_REG, 0x510 + which*8) & 0x07FFFFFC;
+	cap.len = T1ReadWord(MMU.ARM7_REG, 0x514 + which*8);
+
+	ProbeCapture(which);
+}
+
+//only the core spu writes capture data back to memory, so the user spu never sees these
+static void SPU_WriteCapture(u32 addr, u32 size)
+{
+	const u32 end = addr + size;
+	if(addr <= 0x508 && end > 0x508) SPU_core->WriteCaptureRegs(0);
+	if(addr <= 0x509 && end > 0x509) SPU_core->WriteCaptureRegs(1);
+	if(addr < 0x518 && end > 0x510) SPU_core->WriteCaptureRegs(0);
+	if(addr < 0x520 && end > 0x518) SPU_core->WriteCaptureRegs(1);
+}
+
 void SPU_WriteByte(u32 addr, u8 val)
 {
 	addr &= 0xFFF;
@@ -500,10 +659,13 @@ void SPU_WriteByte(u32 addr, u8 val)
 	if (addr < 0x500)
 	{
 		SPU_core->WriteByte(addr,val);
-		if(SPU_user) SPU_user->WriteByte(addr,val);
+		if(SPU_user && !speculative) SPU_user->WriteByte(addr,val);
 	}
 
 	T1WriteByte(MMU.ARM7_REG, addr, val);
+
+	if (addr >= 0x508)
+		SPU_WriteCapture(addr,1);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -554,10 +716,13 @@ void SPU_WriteWord(u32 addr, u16 val)
 	if (addr < 0x500)
 	{
 		SPU_core->WriteWord(addr,val);
-		if(SPU_user) SPU_user->WriteWord(addr,val);
+		if(SPU_user && !speculative) SPU_user->WriteWord(addr,val);
 	}
 
 	T1WriteWord(MMU.ARM7_REG, addr, val);
+
+	if (addr >= 0x508)
+		SPU_WriteCapture(addr,2);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -604,10 +769,13 @@ void SPU_WriteLong(u32 addr, u32 val)
 	if (addr < 0x500)
 	{
 		SPU_core->WriteLong(addr,val);
-		if(SPU_user) SPU_user->WriteLong(addr,val);
+		if(SPU_user && !speculative) SPU_user->WriteLong(addr,val);
 	}
 
 	T1WriteLong(MMU.ARM7_REG, addr, val);
+
+	if (addr >= 0x508)
+		SPU_WriteCapture(addr,4);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -617,11 +785,10 @@ template<SPUInterpolationMode INTERPOLATE_MODE> static FORCEINLINE s32 Interpola
 	float ratio = (float)_ratio;
 	if(INTERPOLATE_MODE == SPUInterpolation_Cosine)
 	{
-		//why did we change it away from the lookup table? somebody should research that
+		//samples are at most 16 bits, so the difference times a 14 bit weight fits in 32 bits
 		ratio = ratio - (int)ratio;
-		double ratio2 = ((1.0 - cos(ratio * M_PI)) * 0.5);
-		//double ratio2 = (1.0f - cos_lut[((int)(ratio*256.0))&0xFF]) / 2.0f;
-		return (s32)(((1-ratio2)*a) + (ratio2*b));
+		const s32 weight = cos_lut[((u32)(ratio * COSINE_LUT_SIZE)) & (COSINE_LUT_SIZE - 1)];
+		return a + (((b - a) * weight) >> COSINE_LUT_SHIFT);
 	}
 	else
 	{
@@ -678,7 +845,7 @@ template<SPUInterpolationMode INTERPOLATE_MODE> static FORCEINLINE void Fetch16B
 		*data = (s32)chan->buf16[sputrunc(chan->sampcnt)];
 }
 
-template<SPUInterpolationMode INTERPOLATE_MODE> static FORCEINLINE void FetchADPCMData(channel_struct * const chan, s32 * const data)
+template<SPUInterpolationMode INTERPOLATE_MODE> static FORCEINLINE void FetchADPCMData(SPU_struct * const SPU, channel_struct * const chan, s32 * const data)
 {
 	if (chan->sampcnt < 8)
 	{
@@ -686,8 +853,30 @@ template<SPUInterpolationMode INTERPOLATE_MODE> static FORCEINLINE void FetchADP
 		return;
 	}
 
-	// No sense decoding, just return the last sample
-	if (chan->lastsampcnt != sputrunc(chan->sampcnt)){
+	ADPCMCache &cache = SPU->adpcmcache[chan->num];
+	const u32 pos = sputrunc(chan->sampcnt);
+
+	if (chan->lastsampcnt == pos) {
+		// No sense decoding, just return the last sample
+	}
+	else if (cache.decoded && cache.totlength == chan->totlength && cache.loopstart == chan->loopstart)
+	{
+		if(pos >= cache.decoded)
+			adpcm_cache_fill(cache, chan, pos+1);
+
+		//the decoder state has to stay current for savestates and for leaving the cache
+		const u32 loopsamp = (u32)chan->loopstart << 3;
+		if(chan->lastsampcnt < loopsamp && pos >= loopsamp)
+		{
+			chan->loop_pcm16b = cache.pcm[loopsamp];
+			chan->loop_index = cache.index[loopsamp];
+		}
+		chan->pcm16b_last = cache.pcm[pos-1];
+		chan->pcm16b = cache.pcm[pos];
+		chan->index = cache.index[pos];
+		chan->lastsampcnt = pos;
+	}
+	else {
 
 	    const u32 endExclusive = sputrunc(chan->sampcnt+1);
 	    for (u32 i = chan->lastsampcnt+1; i < endExclusive; i++)
@@ -811,6 +1000,24 @@ template<int FORMAT> static FORCEINLINE void TestForLoop(SPU_struct *SPU, channe
 	}
 }
 
+//at the end of a pass the cached loop part is checked against memory, since games may
+//stream new data into a looping sample
+static void adpcm_cache_loop(SPU_struct *SPU, const channel_struct *chan)
+{
+	ADPCMCache &cache = SPU->adpcmcache[chan->num];
+	if(!cache.decoded || cache.totlength != chan->totlength || cache.loopstart != chan->loopstart)
+		return;
+
+	//the counter may have stepped over the last few samples; finish so the hashes get taken
+	if(!cache.complete)
+		adpcm_cache_fill(cache, chan, chan->totlength << 3);
+	else if(adpcm_hash(chan->buf8, chan->loopstart << 2, chan->totlength << 2) != cache.loophash)
+	{
+		cache.decoded = std::max<u32>(8, ((u32)chan->loopstart << 3) + 1);
+		cache.complete = false;
+	}
+}
+
 static FORCEINLINE void TestForLoop2(SPU_struct *SPU, channel_struct *chan)
 {
 	chan->sampcnt += chan->sampinc;
@@ -820,6 +1027,8 @@ static FORCEINLINE void TestForLoop2(SPU_struct *SPU, channel_struct *chan)
 		// Do we loop? Or are we done?
 		if (chan->repeat == 1)
 		{
+			adpcm_cache_loop(SPU, chan);
+
 			while (chan->sampcnt > chan->double_totlength_shifted)
 				chan->sampcnt -= chan->double_totlength_shifted - (double)(chan->loopstart << 3);
 
@@ -857,10 +1066,53 @@ template<int CHANNELS> FORCEINLINE static void SPU_Mix(SPU_struct* SPU, channel_
 	SPU->lastdata = data;
 }
 
+//psg output only changes when the counter crosses an integer, so it is fetched once per run
+//of output samples instead of once per sample
+template<int CHANNELS> FORCEINLINE static void ____SPU_ChanUpdatePSG(SPU_struct* const SPU, channel_struct* const chan)
+{
+	if(CHANNELS == -1)
+	{
+		for (; SPU->bufpos < SPU->buflength; SPU->bufpos++)
+			chan->sampcnt += chan->sampinc;
+		return;
+	}
+
+	while (SPU->bufpos < SPU->buflength)
+	{
+		s32 data;
+		FetchPSGData(chan, &data);
+
+		if (chan->sampcnt < 0)
+		{
+			do
+			{
+				SPU_Mix<CHANNELS>(SPU, chan, data);
+				chan->sampcnt += chan->sampinc;
+				SPU->bufpos++;
+			} while (SPU->bufpos < SPU->buflength && chan->sampcnt < 0);
+			continue;
+		}
+
+		const u32 step = sputrunc(chan->sampcnt);
+		do
+		{
+			SPU_Mix<CHANNELS>(SPU, chan, data);
+			chan->sampcnt += chan->sampinc;
+			SPU->bufpos++;
+		} while (SPU->bufpos < SPU->buflength && sputrunc(chan->sampcnt) == step);
+	}
+}
+
 //WORK
 template<int FORMAT, SPUInterpolationMode INTERPOLATE_MODE, int CHANNELS> 
 	FORCEINLINE static void ____SPU_ChanUpdate(SPU_struct* const SPU, channel_struct* const chan)
 {
+	if(FORMAT == 3)
+	{
+		____SPU_ChanUpdatePSG<CHANNELS>(SPU, chan);
+		return;
+	}
+
 	for (; SPU->bufpos < SPU->buflength; SPU->bufpos++)
 	{
 		if(CHANNELS != -1)
@@ -870,7 +1122,7 @@ template<int FORMAT, SPUInterpolationMode INTERPOLATE_MODE, int CHANNELS>
 			{
 				case 0: Fetch8BitData<INTERPOLATE_MODE>(chan, &data); break;
 				case 1: Fetch16BitData<INTERPOLATE_MODE>(chan, &data); break;
-				case 2: FetchADPCMData<INTERPOLATE_MODE>(chan, &data); break;
+				case 2: FetchADPCMData<INTERPOLATE_MODE>(SPU, chan, &data); break;
 				case 3: FetchPSGData(chan, &data); break;
 			}
 			SPU_Mix<CHANNELS>(SPU, chan, data);
@@ -921,23 +1173,101 @@ FORCEINLINE static void _SPU_ChanUpdate(const bool actuallyMix, SPU_struct* cons
 	}
 }
 
+//the capture units sample their source at the rate of channel 1 (unit 0) or channel 3 (unit 1).
+//a whole block of source samples is ready when this runs, so the destination is written
+//straight through the host pointer instead of going through the ARM7 memory handlers
+static void SPU_CaptureBlock(SPU_struct *SPU, int which, int length)
+{
+	SPU_struct::REGS::CAP &cap = SPU->regs.cap[which];
+	const double sampinc = SPU->channels[1 + which*2].sampinc;
+	const s32 *src = SPU->capsrcbuf[which];
+
+	for(int i=0;i<length;i++)
+	{
+		const u32 last = sputrunc(cap.runtime.sampcnt);
+		cap.runtime.sampcnt += sampinc;
+		const u32 curr = sputrunc(cap.runtime.sampcnt);
+		if(last == curr)
+			continue;
+
+		const s32 sample = MinMax(src[i], -0x8000, 0x7FFF);
+		for(u32 j=last;j<curr;j++)
+		{
+			const u32 adr = cap.runtime.curdad & cap.runtime.dstmask;
+			if(cap.bits8)
+			{
+				T1WriteByte(cap.runtime.dst, adr, (u8)(sample >> 8));
+				cap.runtime.curdad++;
+			}
+			else
+			{
+				T1WriteWord(cap.runtime.dst, adr, (u16)sample);
+				cap.runtime.curdad += 2;
+			}
+
+			if(cap.runtime.curdad >= cap.runtime.maxdad)
+			{
+				cap.runtime.curdad = cap.dad;
+				if(cap.oneshot)
+				{
+					cap.active = 0;
+					cap.runtime.running = 0;
+					MMU.ARM7_REG[0x508 + which] &= 0x7F;
+					return;
+				}
+			}
+
+			//crossed into another 1MB page, or wrapped back to the start
+			if(!(cap.runtime.curdad & 0xFFFFF) || cap.runtime.curdad == cap.dad)
+				capture_map_dest(cap);
+		}
+	}
+}
+
+//whether a channel feeds a capture unit directly: channel 0 (unit 0) and channel 2 (unit 1),
+//plus channel 1/3 when the unit adds it in
+static FORCEINLINE int SPU_CaptureTap(const SPU_struct *SPU, int chan)
+{
+	if(chan >= 4) return -1;
+	const int which = chan >> 1;
+	const SPU_struct::REGS::CAP &cap = SPU->regs.cap[which];
+	if(!cap.runtime.running || !cap.source) return -1;
+	if((chan & 1) && !cap.add) return -1;
+	return which;
+}
+
 static void SPU_MixAudio(bool actuallyMix, SPU_struct *SPU, int length)
 {
 	u8 vol;
 
+	//capture writes back into emulated memory, so it has to run whatever the output wants
+	const bool capturing = SPU == SPU_core && (SPU->regs.cap[0].runtime.running || SPU->regs.cap[1].runtime.running);
+	if(capturing)
+	{
+		actuallyMix = true;
+		memset(SPU->capsrcbuf[0], 0, length*4);
+		memset(SPU->capsrcbuf[1], 0, length*4);
+	}
+
 	if(actuallyMix)
 	{
 		memset(SPU->sndbuf, 0, length*4*2);
 		memset(SPU->outbuf, 0, length*2*2);
 	}
-	
-	// If the sound speakers are disabled, don't output audio
-	if(!(T1ReadWord(MMU.ARM7_REG, 0x304) & 0x01))
-		return;
 
+	// If the sound speakers are disabled, don't output audio
 	// If Master Enable isn't set, don't output audio
-	if (!(T1ReadByte(MMU.ARM7_REG, 0x501) & 0x80))
+	const bool enabled = (T1ReadWord(MMU.ARM7_REG, 0x304) & 0x01) && (T1ReadByte(MMU.ARM7_REG, 0x501) & 0x80);
+	if(!enabled)
+	{
+		//the capture units keep running on silence
+		if(capturing)
+		{
+			if(SPU->regs.cap[0].runtime.running) SPU_CaptureBlock(SPU, 0, length);
+			if(SPU->regs.cap[1].runtime.running) SPU_CaptureBlock(SPU, 1, length);
+		}
 		return;
+	}
 
 	vol = T1ReadByte(MMU.ARM7_REG, 0x500) & 0x7F;
 
@@ -951,8 +1281,46 @@ static void SPU_MixAudio(bool actuallyMix, SPU_struct *SPU, int length)
 		SPU->bufpos = 0;
 		SPU->buflength = length;
 
-		// Mix audio
-		_SPU_ChanUpdate(!CommonSettings.spu_muteChannels[i] && actuallyMix, SPU, chan);
+		const int tap = capturing ? SPU_CaptureTap(SPU, i) : -1;
+		if(tap < 0)
+		{
+			// Mix audio
+			_SPU_ChanUpdate(!CommonSettings.spu_muteChannels[i] && actuallyMix, SPU, chan);
+			continue;
+		}
+
+		//render the channel on its own so the capture unit gets it, even when it is muted
+		s32 *mixbuf = SPU->sndbuf;
+		memset(SPU->capchanbuf, 0, length*4*2);
+		SPU->sndbuf = SPU->capchanbuf;
+		_SPU_ChanUpdate(true, SPU, chan);
+		SPU->sndbuf = mixbuf;
+
+		s32 *capsrc = SPU->capsrcbuf[tap];
+		const bool audible = !CommonSettings.spu_muteChannels[i];
+		for(int j=0;j<length;j++)
+		{
+			const s32 l = SPU->capchanbuf[j*2], r = SPU->capchanbuf[j*2+1];
+			capsrc[j] += l + r;
+			if(audible)
+			{
+				mixbuf[j*2] += l;
+				mixbuf[j*2+1] += r;
+			}
+		}
+	}
+
+	if(capturing)
+	{
+		//mixer sourced units take the left/right mix before the master volume
+		for(int which=0;which<2;which++)
+		{
+			if(!SPU->regs.cap[which].runtime.running) continue;
+			if(!SPU->regs.cap[which].source)
+				for(int j=0;j<length;j++)
+					SPU->capsrcbuf[which][j] = SPU->sndbuf[j*2+which];
+			SPU_CaptureBlock(SPU, which, length);
+		}
 	}
 
 	// convert from 32-bit->16-bit
@@ -978,14 +1346,19 @@ static void SPU_MixAudio(bool actuallyMix, SPU_struct *SPU, int length)
 //this will produce a variable number of samples, calculated to keep a 44100hz output
 //in sync with the emulator framerate
 int spu_core_samples = 0;
+void SPU_SetSpeculative(bool enable)
+{
+	speculative = enable;
+}
+
 void SPU_Emulate_core()
 {
 	samples += samples_per_hline;
 	spu_core_samples = (int)(samples);
 	samples -= spu_core_samples;
 
-	bool synchronize = (synchmode == ESynchMode_Synchronous);
-	bool mix = /*driver->AVI_IsRecording() || driver->WAV_IsRecording() ||*/ synchronize;
+	bool synchronize = (synchmode == ESynchMode_Synchronous) && !speculative;
+	bool mix = (Record_IsActive() && !speculative) || synchronize;
 
 	SPU_MixAudio(mix,SPU_core,spu_core_samples);
 	if(synchronize)
@@ -1188,7 +1561,7 @@ void WAV_WavSoundUpdate(void* soundData, int numSamples, WAVMode mode)
 void spu_savestate(EMUFILE* os)
 {
 	//version
-	write32le(3,os);
+	write32le(4,os);
 
 	SPU_struct *spu = SPU_core;
 
@@ -1218,6 +1591,22 @@ void spu_savestate(EMUFILE* os)
 	}
 
 	write64le(double_to_u64(samples),os);
+
+	for(int i=0;i<2;i++) {
+		SPU_struct::REGS::CAP &cap = spu->regs.cap[i];
+		write8le(cap.add,os);
+		write8le(cap.source,os);
+		write8le(cap.oneshot,os);
+		write8le(cap.bits8,os);
+		write8le(cap.active,os);
+		write32le(cap.dad,os);
+		write16le(cap.len,os);
+		write8le(cap.runtime.running,os);
+		write32le(cap.runtime.curdad,os);
+		write32le(cap.runtime.maxdad,os);
+		write64le(double_to_u64(cap.runtime.sampcnt),os);
+		cap.runtime.fifo.save(os);
+	}
 }
 
 bool spu_loadstate(EMUFILE* is, int size)
@@ -1266,6 +1655,7 @@ bool spu_loadstate(EMUFILE* is, int size)
 
 		//hopefully trigger a recovery of the adpcm looping system
 		chan.loop_index = K_ADPCM_LOOPING_RECOVERY_INDEX;
+		spu->adpcmcache[j].invalidate();
 
 		//fixup the pointers which we had are supposed to keep cached
 		chan.buf8 = (s8*)&MMU.MMU_MEM[1][(chan.addr>>20)&0xFF][(chan.addr & MMU.MMU_MASK[1][(chan.addr >> 20) & 0xFF])];
@@ -1275,9 +1665,39 @@ bool spu_loadstate(EMUFILE* is, int size)
 		read64le(&temp64,is); samples = u64_to_double(temp64);
 	}
 
-	//copy the core spu (the more accurate) to the user spu
-	if(SPU_user) {
+	for(int i=0;i<2;i++) {
+		SPU_struct::REGS::CAP &cap = spu->regs.cap[i];
+		if(version >= 4)
+		{
+			read8le(&cap.add,is);
+			read8le(&cap.source,is);
+			read8le(&cap.oneshot,is);
+			read8le(&cap.bits8,is);
+			read8le(&cap.active,is);
+			read32le(&cap.dad,is);
+			read16le(&cap.len,is);
+			read8le(&cap.runtime.running,is);
+			read32le(&cap.runtime.curdad,is);
+			read32le(&cap.runtime.maxdad,is);
+			read64le(&temp64,is); cap.runtime.sampcnt = u64_to_double(temp64);
+			if(!cap.runtime.fifo.load(is)) return false;
+			if(cap.runtime.running)
+				capture_map_dest(cap);
+		}
+		else
+		{
+			//older states predate capture support
+			cap.active = 0;
+			cap.runtime.running = 0;
+		}
+	}
+
+	//copy the core spu (the more accurate) to the user spu.
+	//not when a speculative run is being rolled back: the user spu never saw it and is still in step
+	if(SPU_user && !speculative) {
 		memcpy(SPU_user->channels,SPU_core->channels,sizeof(SPU_core->channels));
+		for(int j=0;j<16;j++)
+			SPU_user->adpcmcache[j].invalidate();
 	}
 
 	return true;
@@ -118,6 +118,25 @@ public:
 	void reset();
 };
 
+//decoded ADPCM of one channel. every loop pass resumes from the same saved state, so the
+//decoded samples are the same each time round and only have to be decoded once
+struct ADPCMCache
+{
+	ADPCMCache() : pcm(0), index(0), capacity(0) { invalidate(); }
+	s16 *pcm;
+	u8 *index;
+	u32 capacity;
+	//what was decoded
+	u32 addr, totlength, loopstart;
+	//samples [7,decoded) hold the decoder output and state. 0 means the cache is not in use
+	u32 decoded;
+	//hashes of the whole source and of its loop part, taken once everything was decoded
+	u32 hash, loophash;
+	bool complete;
+
+	void invalidate() { decoded = 0; complete = false; }
+};
+
 class SPU_struct
 {
 public:
@@ -128,6 +147,10 @@ public:
    s32 lastdata; //the last sample that a channel generated
    s16 *outbuf;
    u32 bufsize;
+   //capture scratch: one channel's panned output, and the source of each capture unit for the block
+   s32 *capchanbuf;
+   s32 *capsrcbuf[2];
+   ADPCMCache adpcmcache[16];
    channel_struct channels[16];
 
    //registers
@@ -167,13 +190,16 @@ public:
 		   u16 len;
 		   struct Runtime {
 			   Runtime()
-				   : running(0), curdad(0), maxdad(0)
+				   : running(0), curdad(0), maxdad(0), sampcnt(0)
 			   {}
 			   u8 running;
 			   u32 curdad;
 			   u32 maxdad;
 			   double sampcnt;
 			   SPUFifo fifo;
+			   //host view of the destination, valid for the 1MB page holding curdad
+			   u8 *dst;
+			   u32 dstmask;
 		   } runtime;
 	   } cap[2];
    } regs;
@@ -184,6 +210,7 @@ public:
    void KeyOn(int channel);
    void KeyProbe(int channel);
    void ProbeCapture(int which);
+   void WriteCaptureRegs(int which);
    void WriteByte(u32 addr, u8 val);
    u8 ReadByte(u32 addr);
    u16 ReadWord(u32 addr);
@@ -213,6 +240,10 @@ u8 SPU_ReadByte(u32 addr);
 u16 SPU_ReadWord(u32 addr);
 u32 SPU_ReadLong(u32 addr);
 void SPU_Emulate_core(void);
+//while set, the core spu keeps emulating but nothing it does is heard: no mixing for output,
+//nothing queued for the synchronizer or the recorder, and register writes don't reach the user spu.
+//for frames which are thrown away afterwards (run-ahead)
+void SPU_SetSpeculative(bool enable);
 void SPU_Emulate_user(bool mix = true);
 
 extern SPU_struct *SPU_core, *SPU_user;
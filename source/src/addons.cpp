@@ -21,6 +21,7 @@
 
 #include "addons.h"
 #include <string>
+#include "readwrite.h"
 
 //this is the currently-configured cflash mode
 ADDON_CFLASH_MODE CFlash_Mode;
@@ -31,6 +32,11 @@ std::string CFlash_Path;
 
 char GBAgameName[MAX_PATH];
 
+//the MMU reads aligned halfwords and words below GBAslotROMEnd straight from GBAslotROM,
+//without going through the addon. only the GBA game pak sets these
+u8 *GBAslotROM = NULL;
+u32 GBAslotROMEnd = 0;
+
 extern ADDONINTERFACE addonNone;
 extern ADDONINTERFACE addonCFlash;
 extern ADDONINTERFACE addonRumblePak;
@@ -38,6 +44,9 @@ extern ADDONINTERFACE addonGBAgame;
 extern ADDONINTERFACE addonGuitarGrip;
 extern ADDONINTERFACE addonExpMemory;
 //extern ADDONINTERFACE addonExternalMic;
+extern void GBAgame_FrameEnded();
+extern void GBAgame_savestate(EMUFILE* os);
+extern bool GBAgame_loadstate(EMUFILE* is, int size);
 
 ADDONINTERFACE addonList[NDS_ADDON_COUNT] = {
 		addonNone,
@@ -76,3 +85,31 @@ bool addonsChangePak(u8 type)
 	return addon.init();
 }
 
+void addonsFrameEnded()
+{
+	if (addon_type == NDS_ADDON_GBAGAME)
+		GBAgame_FrameEnded();
+}
+
+//only the GBA game pak has state the emulated code can change, its save chip
+void addons_savestate(EMUFILE* os)
+{
+	write32le(addon_type, os);
+	if (addon_type == NDS_ADDON_GBAGAME)
+		GBAgame_savestate(os);
+}
+
+bool addons_loadstate(EMUFILE* is, int size)
+{
+	u32 type;
+	if (read32le(&type, is) != 1) return false;
+	//a state taken with another pak in the slot has nothing for this one
+	if (type != addon_type)
+	{
+		is->fseek(size - 4, SEEK_CUR);
+		return true;
+	}
+	if (addon_type == NDS_ADDON_GBAGAME)
+		return GBAgame_loadstate(is, size - 4);
+	return true;
+}
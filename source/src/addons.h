@@ -25,6 +25,7 @@
 #include "common.h"
 #include "types.h"
 #include "debug.h"
+#include "emufile.h"
 
 struct ADDONINTERFACE
 {
@@ -83,12 +84,17 @@ extern ADDONINTERFACE addonList[NDS_ADDON_COUNT];	// lists pointer on paks
 extern u8 addon_type;								// current type pak
 
 extern char GBAgameName[MAX_PATH];					// file name for GBA game (rom)
+extern u8 *GBAslotROM;								// host copy of the rom in the GBA slot
+extern u32 GBAslotROMEnd;							// end of the rom in the GBA slot address space, 0 when empty
 extern void (*FeedbackON)(BOOL enable);				// feedback on/off
 
 extern bool addonsInit();							// Init addons
 extern void addonsClose();							// Shutdown addons
 extern void addonsReset();							// Reset addon
 extern bool addonsChangePak(u8 type);				// change current adddon
+extern void addonsFrameEnded();						// called at the end of every real emulated frame
+extern void addons_savestate(EMUFILE* os);			// pak state for in-memory snapshots
+extern bool addons_loadstate(EMUFILE* is, int size);
 
 extern void guitarGrip_setKey(bool green, bool red, bool yellow, bool blue); // Guitar grip keys
 
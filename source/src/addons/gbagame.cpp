@@ -21,16 +21,28 @@
 #include "../addons.h"
 #include "../mem.h"
 #include <string.h>
+#include <algorithm>
 #include "../MMU.h"
+#include "../readwrite.h"
 
-//SRAM is going to be stored just above the rom.
-//that is convenient for us, since it mirrors the nds memory map
-#define GBA_ROMSIZE (32 * 1024 * 1024) + 1
-#define GBA_SAVESIZE (512 * 1024) + 1
+#define GBA_ROMMAXSIZE (32 * 1024 * 1024)
+//the biggest save chip, FLASH1M
+#define GBA_SAVESIZE (128 * 1024)
+//saves are written back in pages of this size, only the ones which changed
+#define GBA_SAVEPAGE 4096
+//frames without a save write before the dirty pages go to disk
+#define GBA_FLUSHDELAY 30
 
 static u8		*GBArom = NULL;
+static u32		romSize = 0;
+static std::string romName;
 static u8		*saveData = NULL;
 static u8		saveType = 0xFF;
+static u32		saveSize = 0;
+static std::string saveName;
+//one bit per GBA_SAVEPAGE of saveData
+static u32		saveDirty = 0;
+static u32		saveIdleFrames = 0;
 
 //================================================================================== Flash GBA
 typedef struct 
@@ -45,6 +57,20 @@ typedef struct
 
 FLASH_GBA	gbaFlash = {0};
 
+static FORCEINLINE void gbaMarkDirty(u32 ofs)
+{
+	if (ofs >= GBA_SAVESIZE) return;
+	saveDirty |= 1u << (ofs / GBA_SAVEPAGE);
+	saveIdleFrames = 0;
+}
+
+//offset into saveData of a flash address in the current bank, or saveSize when it lies past the chip
+static FORCEINLINE u32 gbaFlashOffset(u32 adr)
+{
+	u32 ofs = (adr & 0xFFFF) + (0x10000 * gbaFlash.bank);
+	return (ofs < saveSize) ? ofs : saveSize;
+}
+
 static void gbaWriteFlash(u32 adr, u8 val)
 {
 	switch (gbaFlash.state)
@@ -70,7 +96,8 @@ static void gbaWriteFlash(u32 adr, u8 val)
 			{
 				if (gbaFlash.cmd == 0xB0)
 				{
-					gbaFlash.bank = val;
+					//only the 1Mbit chips have a second bank
+					gbaFlash.bank = (gbaFlash.size > (64 * 1024)) ? (val & 1) : 0;
 					gbaFlash.cmd = 0;
 					//INFO("GBAgame: Flash: change bank %i\n", val);
 					return;
@@ -135,10 +162,13 @@ static void gbaWriteFlash(u32 adr, u8 val)
 		case 0x82:
 			if (val == 0x30)
 			{
-				u32 ofs = (adr & 0x0000F000);
+				u32 ofs = gbaFlashOffset(adr & 0x0000F000);
 				//INFO("GBAgame: Flash: erase from 0x%08X to 0x%08X\n", ofs + 0x0A000000, ofs + 0x0A001000);
-				for (u32 i = ofs; i < (ofs + 0x1000); i++)
-					saveData[i] = 0xFF;
+				if (ofs + 0x1000 <= saveSize)
+				{
+					memset(saveData + ofs, 0xFF, 0x1000);
+					gbaMarkDirty(ofs);
+				}
 			}
 			gbaFlash.state = 0;
 			gbaFlash.cmd = 0;
@@ -171,7 +201,12 @@ static void gbaWriteFlash(u32 adr, u8 val)
 
 	if (gbaFlash.cmd == 0xA0)	// write
 	{
-		saveData[(adr & 0x1FFFF)+(0x10000*gbaFlash.bank)] = val;
+		u32 ofs = gbaFlashOffset(adr);
+		if (ofs < saveSize)
+		{
+			saveData[ofs] = val;
+			gbaMarkDirty(ofs);
+		}
 		gbaFlash.state = 0;
 		gbaFlash.cmd = 0;
 		return;
@@ -183,8 +218,9 @@ static u8 gbaReadFlash(u32 adr)
 {
 	if (gbaFlash.cmd == 0)
 	{
-		//INFO("GBAgame: flash read at 0x%08X = 0x%02X\n", adr, saveData[(adr & 0x1FFFF)+(0x10000*gbaFlash.bank)]);
-		return saveData[(adr & 0x1FFFF)+(0x10000*gbaFlash.bank)];
+		u32 ofs = gbaFlashOffset(adr);
+		//INFO("GBAgame: flash read at 0x%08X = 0x%02X\n", adr, saveData[ofs]);
+		return (ofs < saveSize) ? saveData[ofs] : 0xFF;
 	}
 
 	//INFO("GBAgame: flash read at 0x%08X\n", adr);
@@ -214,122 +250,188 @@ static u8 gbaReadFlash(u32 adr)
 }
 //==================================================================================
 
+//the library id strings are word aligned, so only every fourth offset is looked at,
+//and only where the first word already matches
 static u8 getSaveTypeGBA(const u8 *data, const u32 size)
 {
-// 	u8	type = 0;
-	u8	*dat = (u8 *)data;
-	
-	for (u32 i = 0; i < (size / 4); i++)
-	{
-		u32	tmp = T1ReadLong(dat, i);
+	bool rtc = false;
 
-		if (tmp == 0x52504545)
-		{
-			if(memcmp(dat, "EEPROM_", 7) == 0)
-			{
-				return 1;
-			}
-		}
+	for (u32 i = 0; i + 8 <= size; i += 4)
+	{
+		const u8 *dat = data + i;
 
-		if (tmp == 0x4D415253)
+		switch (T1ReadLong((u8*)data, i))
 		{
-			if(memcmp(dat, "SRAM_", 5) == 0)
-			{
-				return 2;
-			}
-		}
+			case 0x52504545:
+				if(memcmp(dat, "EEPROM_", 7) == 0)
+					return 1;
+				break;
 
-		if (tmp == 0x53414C46)
-		{
-			if(memcmp(dat, "FLASH1M_", 8) == 0)
-			{
-				return 3;
-			}
-		}
+			case 0x4D415253:
+				if(memcmp(dat, "SRAM_", 5) == 0)
+					return 2;
+				break;
 
-		if (tmp == 0x52494953)
-		{
-			if(memcmp(dat, "SIIRTC_V", 8) == 0)
-			{
-				return 4;
-			}
-		}
+			case 0x53414C46:
+				if(memcmp(dat, "FLASH1M_", 8) == 0)
+					return 3;
+				//FLASH_V, FLASH512_V
+				if(dat[5] == '_' || memcmp(dat, "FLASH512", 8) == 0)
+					return 5;
+				break;
 
-		if(memcmp(dat, "FLASH", 5) == 0)
-		{
-			return 5;
+			//the rtc comes alongside a save chip, which is what matters here
+			case 0x52494953:
+				if(memcmp(dat, "SIIRTC_V", 8) == 0)
+					rtc = true;
+				break;
 		}
-		dat += 4;
 	}
 
-	return 0xFF;		// NONE
+	return rtc ? 4 : 0xFF;		// NONE
 }
 
-static BOOL GBAgame_init(void)
+static u32 getSaveSizeGBA(u8 type)
 {
-	return (TRUE); 
+	switch (type)
+	{
+		case 1: return 8 * 1024;		// EEPROM, not reachable from the DS slot
+		case 2: return 32 * 1024;		// SRAM
+		case 3: return 128 * 1024;		// FLASH1M
+		case 5: return 64 * 1024;		// FLASH
+		default: return 0;
+	}
 }
 
-static void GBAgame_reset(void)
+//writes the changed pages back into the .sav
+static void GBAgame_flushSave()
 {
-	memset(&gbaFlash, 0, sizeof(gbaFlash));
+	if (!saveDirty || saveName.empty()) return;
 
-	if (GBArom)
+	FILE *fsave = fopen(saveName.c_str(), "r+b");
+	if (!fsave)
 	{
-		delete [] GBArom;
-		GBArom = NULL;
+		//no save file yet, it is created at full size
+		fsave = fopen(saveName.c_str(), "wb");
+		if (!fsave) return;
+		saveDirty = 0xFFFFFFFF;
 	}
-	GBArom = new u8 [GBA_ROMSIZE];
-	memset(GBArom, 0xFF, GBA_ROMSIZE);
 
-	if (saveData)
+	const u32 pages = (saveSize + GBA_SAVEPAGE - 1) / GBA_SAVEPAGE;
+	for (u32 i = 0; i < pages; i++)
 	{
-		delete [] saveData;
-		saveData = NULL;
+		if (!(saveDirty & (1u << i))) continue;
+		fseek(fsave, i * GBA_SAVEPAGE, SEEK_SET);
+		fwrite(saveData + i * GBA_SAVEPAGE, 1, std::min<u32>(GBA_SAVEPAGE, saveSize - i * GBA_SAVEPAGE), fsave);
 	}
-	saveData = new u8 [GBA_SAVESIZE];
-	memset(saveData, 0xFF, GBA_SAVESIZE);
+	fclose(fsave);
+
+	saveDirty = 0;
+}
+
+void GBAgame_FrameEnded()
+{
+	//games write a sector a byte at a time, so wait until they are done
+	if (saveDirty && ++saveIdleFrames >= GBA_FLUSHDELAY)
+		GBAgame_flushSave();
+}
 
-	if (!strlen(GBAgameName)) return;
-	FILE *fgame = 0;
+//the save chip as the emulated code left it, including the writes not flushed to the .sav yet.
+//taken by run-ahead, so the writes of speculative frames are rolled back with everything else
+void GBAgame_savestate(EMUFILE* os)
+{
+	write8le(gbaFlash.state, os);
+	write8le(gbaFlash.cmd, os);
+	write8le(gbaFlash.bank, os);
+	write32le(saveDirty, os);
+	write32le(saveIdleFrames, os);
+	write32le(saveSize, os);
+	if (saveSize) os->fwrite(saveData, saveSize);
+}
 
-	fgame = fopen(GBAgameName,"rb");
-	if (!fgame) return;
+bool GBAgame_loadstate(EMUFILE* is, int size)
+{
+	u32 size2;
+	if (read8le(&gbaFlash.state, is) != 1) return false;
+	if (read8le(&gbaFlash.cmd, is) != 1) return false;
+	if (read8le(&gbaFlash.bank, is) != 1) return false;
+	if (read32le(&saveDirty, is) != 1) return false;
+	if (read32le(&saveIdleFrames, is) != 1) return false;
+	if (read32le(&size2, is) != 1 || size2 != saveSize) return false;
+	if (saveSize && is->fread(saveData, saveSize) != saveSize) return false;
+	return true;
+}
+
+static void GBAgame_freeRom()
+{
+	GBAslotROM = NULL;
+	GBAslotROMEnd = 0;
+	free(GBArom);
+	GBArom = NULL;
+	romSize = 0;
+	romName.clear();
+}
+
+//the rom is kept across resets as long as the same file stays in the slot
+static bool GBAgame_loadRom()
+{
+	if (GBArom && romName == GBAgameName) return true;
+	GBAgame_freeRom();
+
+	FILE *fgame = fopen(GBAgameName,"rb");
+	if (!fgame) return false;
 	fseek(fgame, 0, SEEK_END);
 	u32 size = ftell(fgame);
 	rewind(fgame);
+	size = std::min<u32>(size, GBA_ROMMAXSIZE);
 
-	if (!fread(GBArom, 1, size, fgame))
+	//padded to a whole word for the MMU's aligned reads
+	GBArom = (u8*)malloc((size + 3) & ~3);
+	if (!GBArom || fread(GBArom, 1, size, fgame) != size)
 	{
 		fclose(fgame);
-		return;
+		free(GBArom);
+		GBArom = NULL;
+		return false;
 	}
 	fclose(fgame);
+	memset(GBArom + size, 0xFF, ((size + 3) & ~3) - size);
 
-	saveType = getSaveTypeGBA(GBArom, size);
-	INFO("Loaded \"%s\" in GBA slot (save type %i)\n", GBAgameName, saveType);
+	romSize = size;
+	romName = GBAgameName;
+	saveType = getSaveTypeGBA(GBArom, romSize);
+	return true;
+}
 
-	//try loading the sram
-	char * dot = strrchr(GBAgameName,'.');
-	if(!dot) return;
-	std::string sram_fname = GBAgameName;
-	sram_fname.resize(dot-GBAgameName);
-	sram_fname += ".sav";
-	fgame = fopen(sram_fname.c_str(),"rb");
-	if(!fgame) return;
+static BOOL GBAgame_init(void)
+{
+	return (TRUE); 
+}
 
-	fseek(fgame, 0, SEEK_END);
-	size = ftell(fgame);
-	rewind(fgame);
+static void GBAgame_reset(void)
+{
+	GBAgame_flushSave();
+	memset(&gbaFlash, 0, sizeof(gbaFlash));
 
-	if (!fread(saveData, 1, size, fgame))
+	if (!saveData)
+		saveData = new u8 [GBA_SAVESIZE];
+	memset(saveData, 0xFF, GBA_SAVESIZE);
+	saveDirty = 0;
+	saveName.clear();
+
+	if (!strlen(GBAgameName) || !GBAgame_loadRom())
 	{
-		fclose(fgame);
+		GBAgame_freeRom();
 		return;
 	}
-	fclose(fgame);
-	
-	gbaFlash.size = size;
+
+	GBAslotROM = GBArom;
+	GBAslotROMEnd = 0x08000000 + romSize;
+
+	saveSize = getSaveSizeGBA(saveType);
+	INFO("Loaded \"%s\" in GBA slot (save type %i)\n", GBAgameName, saveType);
+
+	gbaFlash.size = saveSize;
 	if (gbaFlash.size <= (64 * 1024))
 	{
 		gbaFlash.idDevice = 0x1B;
@@ -340,23 +442,41 @@ static void GBAgame_reset(void)
 		gbaFlash.idDevice = 0x09;
 		gbaFlash.idManufacturer = 0xC2;
 	}
-	
-	INFO("Loaded save \"%s\" in GBA slot\n", sram_fname.c_str());
+
+	//try loading the sram
+	char * dot = strrchr(GBAgameName,'.');
+	if(!dot || !saveSize) return;
+	saveName = GBAgameName;
+	saveName.resize(dot-GBAgameName);
+	saveName += ".sav";
+	FILE *fsave = fopen(saveName.c_str(),"rb");
+	if(!fsave) return;
+
+	fseek(fsave, 0, SEEK_END);
+	u32 size = ftell(fsave);
+	rewind(fsave);
+
+	if (!fread(saveData, 1, std::min(size, saveSize), fsave))
+	{
+		fclose(fsave);
+		return;
+	}
+	fclose(fsave);
+
+	INFO("Loaded save \"%s\" in GBA slot\n", saveName.c_str());
 }
 
 static void GBAgame_close(void)
 {
-	if (GBArom)
-	{
-		delete [] GBArom;
-		GBArom = NULL;
-	}
+	GBAgame_flushSave();
+	GBAgame_freeRom();
 
 	if (saveData)
 	{
 		delete [] saveData;
 		saveData = NULL;
 	}
+	saveName.clear();
 }
 
 static void GBAgame_config(void) {}
@@ -368,6 +488,14 @@ static void GBAgame_write08(u32 adr, u8 val)
 	{
 		switch (saveType)
 		{
+			case 2:			// SRAM
+			{
+				u32 ofs = (adr - 0x0A000000) & 0x7FFF;
+				saveData[ofs] = val;
+				gbaMarkDirty(ofs);
+			}
+			break;
+
 			case 3:			// Flash
 			case 5:
 				gbaWriteFlash(adr, val);
@@ -394,7 +522,7 @@ static u8   GBAgame_read08(u32 adr)
 	//INFO("GBAgame: read08 at 0x%08X value 0x%02X\n", adr, (u8)T1ReadByte(GBArom, (adr - 0x08000000)));
 	
 	if (adr < 0x0A000000)
-		return (u8)T1ReadByte(GBArom, (adr - 0x08000000));
+		return (adr < GBAslotROMEnd) ? (u8)T1ReadByte(GBArom, (adr - 0x08000000)) : 0xFF;
 
 	if (adr < 0x0A010000)
 	{
@@ -421,8 +549,9 @@ static u16  GBAgame_read16(u32 adr)
 { 
 	//INFO("GBAgame: read16 at 0x%08X value 0x%04X\n", adr, (u16)T1ReadWord(GBArom, (adr - 0x08000000)));
 	
+	//the MMU reads the rom itself, what is left here is past its end
 	if (adr < 0x0A000000)
-		return (u16)T1ReadWord(GBArom, (adr - 0x08000000));
+		return 0xFFFF;
 
 	if (adr < 0x0A010000)
 	{
@@ -436,8 +565,9 @@ static u32  GBAgame_read32(u32 adr)
 { 
 	//INFO("GBAgame: read32 at 0x%08X value 0x%08X\n", adr, (u32)T1ReadLong(GBArom, (adr - 0x08000000)));
 
+	//the MMU reads the rom itself, what is left here is past its end
 	if (adr < 0x0A000000)
-		return (u32)T1ReadLong(GBArom, (adr - 0x08000000));
+		return 0xFFFFFFFF;
 
 	if (adr < 0x0A010000)
 	{
@@ -312,9 +312,7 @@ TEMPLATE static u32 FASTCALL  OP_UND(const u32 i)
 		return b; \
 	} \
 	cpu->R[REG_POS(i,12)] = cpu->R[REG_POS(i,16)] & shift_op; \
-	cpu->CPSR.bits.C = c; \
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,12)]==0); \
+	armcpu_setNZC(cpu, BIT31(cpu->R[REG_POS(i,12)]), (cpu->R[REG_POS(i,12)]==0), c); \
 	return a;
  
 TEMPLATE static u32 FASTCALL  OP_AND_LSL_IMM(const u32 i)
@@ -455,9 +453,7 @@ TEMPLATE static u32 FASTCALL  OP_AND_S_IMM_VAL(const u32 i)
 		cpu->next_instruction = cpu->R[15]; \
 		return b; \
 	} \
-	cpu->CPSR.bits.C = c; \
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,12)]==0); \
+	armcpu_setNZC(cpu, BIT31(cpu->R[REG_POS(i,12)]), (cpu->R[REG_POS(i,12)]==0), c); \
 	return a;
 
 TEMPLATE static u32 FASTCALL  OP_EOR_LSL_IMM(const u32 i)
@@ -598,10 +594,9 @@ TEMPLATE static u32 FASTCALL  OP_EOR_S_IMM_VAL(const u32 i)
 		cpu->next_instruction = cpu->R[15]; \
 		return b; \
 	} \
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,12)]==0); \
-	cpu->CPSR.bits.C = !UNSIGNED_UNDERFLOW(v, shift_op, cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.V = SIGNED_UNDERFLOW(v, shift_op, cpu->R[REG_POS(i,12)]); \
+	armcpu_setNZCV(cpu, BIT31(cpu->R[REG_POS(i,12)]), (cpu->R[REG_POS(i,12)]==0), \
+		!UNSIGNED_UNDERFLOW(v, shift_op, cpu->R[REG_POS(i,12)]), \
+		SIGNED_UNDERFLOW(v, shift_op, cpu->R[REG_POS(i,12)])); \
 	return a;
 
 TEMPLATE static u32 FASTCALL  OP_SUB_LSL_IMM(const u32 i)
@@ -755,10 +750,9 @@ TEMPLATE static u32 FASTCALL  OP_SUB_S_IMM_VAL(const u32 i)
 		cpu->next_instruction = cpu->R[15]; \
 		return b; \
 	} \
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,12)]==0); \
-	cpu->CPSR.bits.C = !UNSIGNED_UNDERFLOW(shift_op, v, cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.V = SIGNED_UNDERFLOW(shift_op, v, cpu->R[REG_POS(i,12)]); \
+	armcpu_setNZCV(cpu, BIT31(cpu->R[REG_POS(i,12)]), (cpu->R[REG_POS(i,12)]==0), \
+		!UNSIGNED_UNDERFLOW(shift_op, v, cpu->R[REG_POS(i,12)]), \
+		SIGNED_UNDERFLOW(shift_op, v, cpu->R[REG_POS(i,12)])); \
 	return a;
 	
 TEMPLATE static u32 FASTCALL  OP_RSB_LSL_IMM(const u32 i)
@@ -912,10 +906,9 @@ TEMPLATE static u32 FASTCALL  OP_RSB_S_IMM_VAL(const u32 i)
 		cpu->next_instruction = cpu->R[15]; \
 		return b; \
 	} \
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,12)]==0); \
-	cpu->CPSR.bits.C = UNSIGNED_OVERFLOW(v, shift_op, cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.V = SIGNED_OVERFLOW(v, shift_op, cpu->R[REG_POS(i,12)]); \
+	armcpu_setNZCV(cpu, BIT31(cpu->R[REG_POS(i,12)]), (cpu->R[REG_POS(i,12)]==0), \
+		UNSIGNED_OVERFLOW(v, shift_op, cpu->R[REG_POS(i,12)]), \
+		SIGNED_OVERFLOW(v, shift_op, cpu->R[REG_POS(i,12)])); \
 	return a;
 
 TEMPLATE static u32 FASTCALL  OP_ADD_LSL_IMM(const u32 i)
@@ -1071,10 +1064,9 @@ TEMPLATE static u32 FASTCALL  OP_ADD_S_IMM_VAL(const u32 i)
 		cpu->next_instruction = cpu->R[15]; \
 		return b; \
 	} \
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,12)]==0); \
-	cpu->CPSR.bits.C = UNSIGNED_OVERFLOW(shift_op, (u32) cpu->CPSR.bits.C, tmp) | UNSIGNED_OVERFLOW(v, tmp, cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.V = SIGNED_OVERFLOW(shift_op, (u32) cpu->CPSR.bits.C, tmp) | SIGNED_OVERFLOW(v, tmp, cpu->R[REG_POS(i,12)]); \
+	armcpu_setNZCV(cpu, BIT31(cpu->R[REG_POS(i,12)]), (cpu->R[REG_POS(i,12)]==0), \
+		UNSIGNED_OVERFLOW(shift_op, (u32) cpu->CPSR.bits.C, tmp) | UNSIGNED_OVERFLOW(v, tmp, cpu->R[REG_POS(i,12)]), \
+		SIGNED_OVERFLOW(shift_op, (u32) cpu->CPSR.bits.C, tmp) | SIGNED_OVERFLOW(v, tmp, cpu->R[REG_POS(i,12)])); \
 	return a; \
 	}
 
@@ -1232,10 +1224,9 @@ TEMPLATE static u32 FASTCALL  OP_ADC_S_IMM_VAL(const u32 i)
 		cpu->next_instruction = cpu->R[15]; \
 		return b; \
 	} \
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,12)]==0); \
-	cpu->CPSR.bits.C = (!UNSIGNED_UNDERFLOW(v, (u32)(!cpu->CPSR.bits.C), tmp)) & (!UNSIGNED_UNDERFLOW(tmp, shift_op, cpu->R[REG_POS(i,12)])); \
-	cpu->CPSR.bits.V = SIGNED_UNDERFLOW(v, (u32)(!cpu->CPSR.bits.C), tmp) | SIGNED_UNDERFLOW(tmp, shift_op, cpu->R[REG_POS(i,12)]); \
+	armcpu_setNZCV(cpu, BIT31(cpu->R[REG_POS(i,12)]), (cpu->R[REG_POS(i,12)]==0), \
+		(!UNSIGNED_UNDERFLOW(v, (u32)(!cpu->CPSR.bits.C), tmp)) & (!UNSIGNED_UNDERFLOW(tmp, shift_op, cpu->R[REG_POS(i,12)])), \
+		SIGNED_UNDERFLOW(v, (u32)(!cpu->CPSR.bits.C), tmp) | SIGNED_UNDERFLOW(tmp, shift_op, cpu->R[REG_POS(i,12)])); \
 	return a; \
 	}
 
@@ -1393,10 +1384,9 @@ TEMPLATE static u32 FASTCALL  OP_SBC_S_IMM_VAL(const u32 i)
 		cpu->next_instruction = cpu->R[15]; \
 		return b; \
 		} \
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,12)]==0); \
-	cpu->CPSR.bits.C = (!UNSIGNED_UNDERFLOW(shift_op, (u32)(!cpu->CPSR.bits.C), (u32)tmp)) & (!UNSIGNED_UNDERFLOW(tmp, v, cpu->R[REG_POS(i,12)])); \
-	cpu->CPSR.bits.V = SIGNED_UNDERFLOW(shift_op, (u32)(!cpu->CPSR.bits.C), (u32)tmp) | SIGNED_UNDERFLOW(tmp, v, cpu->R[REG_POS(i,12)]); \
+	armcpu_setNZCV(cpu, BIT31(cpu->R[REG_POS(i,12)]), (cpu->R[REG_POS(i,12)]==0), \
+		(!UNSIGNED_UNDERFLOW(shift_op, (u32)(!cpu->CPSR.bits.C), (u32)tmp)) & (!UNSIGNED_UNDERFLOW(tmp, v, cpu->R[REG_POS(i,12)])), \
+		SIGNED_UNDERFLOW(shift_op, (u32)(!cpu->CPSR.bits.C), (u32)tmp) | SIGNED_UNDERFLOW(tmp, v, cpu->R[REG_POS(i,12)])); \
 	return a; \
 	}
 
@@ -1533,9 +1523,7 @@ TEMPLATE static u32 FASTCALL  OP_RSC_S_IMM_VAL(const u32 i)
 #define OP_TST(a) \
 	{ \
 	unsigned tmp = cpu->R[REG_POS(i,16)] & shift_op; \
-	cpu->CPSR.bits.C = c; \
-	cpu->CPSR.bits.N = BIT31(tmp); \
-	cpu->CPSR.bits.Z = (tmp==0); \
+	armcpu_setNZC(cpu, BIT31(tmp), (tmp==0), c); \
 	return a; \
 	}
 
@@ -1600,9 +1588,7 @@ TEMPLATE static u32 FASTCALL  OP_TST_IMM_VAL(const u32 i)
 #define OP_TEQ(a) \
 	{ \
 	unsigned tmp = cpu->R[REG_POS(i,16)] ^ shift_op; \
-	cpu->CPSR.bits.C = c; \
-	cpu->CPSR.bits.N = BIT31(tmp); \
-	cpu->CPSR.bits.Z = (tmp==0); \
+	armcpu_setNZC(cpu, BIT31(tmp), (tmp==0), c); \
 	return a; \
 	}
 	
@@ -1667,10 +1653,9 @@ TEMPLATE static u32 FASTCALL  OP_TEQ_IMM_VAL(const u32 i)
 #define OP_CMP(a) \
 	{ \
 	u32 tmp = cpu->R[REG_POS(i,16)] - shift_op; \
-	cpu->CPSR.bits.N = BIT31(tmp); \
-	cpu->CPSR.bits.Z = (tmp==0); \
-	cpu->CPSR.bits.C = !UNSIGNED_UNDERFLOW(cpu->R[REG_POS(i,16)], shift_op, tmp); \
-	cpu->CPSR.bits.V = SIGNED_UNDERFLOW(cpu->R[REG_POS(i,16)], shift_op, tmp); \
+	armcpu_setNZCV(cpu, BIT31(tmp), (tmp==0), \
+		!UNSIGNED_UNDERFLOW(cpu->R[REG_POS(i,16)], shift_op, tmp), \
+		SIGNED_UNDERFLOW(cpu->R[REG_POS(i,16)], shift_op, tmp)); \
 	return a; \
 	}
 	
@@ -1739,10 +1724,9 @@ TEMPLATE static u32 FASTCALL  OP_CMP_IMM_VAL(const u32 i)
 #define OP_CMN(a) \
 	{ \
 	u32 tmp = cpu->R[REG_POS(i,16)] + shift_op; \
-	cpu->CPSR.bits.N = BIT31(tmp); \
-	cpu->CPSR.bits.Z = (tmp==0); \
-	cpu->CPSR.bits.C = UNSIGNED_OVERFLOW(cpu->R[REG_POS(i,16)], shift_op, tmp); \
-	cpu->CPSR.bits.V = SIGNED_OVERFLOW(cpu->R[REG_POS(i,16)], shift_op, tmp); \
+	armcpu_setNZCV(cpu, BIT31(tmp), (tmp==0), \
+		UNSIGNED_OVERFLOW(cpu->R[REG_POS(i,16)], shift_op, tmp), \
+		SIGNED_OVERFLOW(cpu->R[REG_POS(i,16)], shift_op, tmp)); \
 	return a; \
 	}
 
@@ -1830,9 +1814,7 @@ TEMPLATE static u32 FASTCALL  OP_CMN_IMM_VAL(const u32 i)
 		cpu->next_instruction = cpu->R[15]; \
 		return b; \
 	} \
-	cpu->CPSR.bits.C = c; \
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,12)]==0); \
+	armcpu_setNZC(cpu, BIT31(cpu->R[REG_POS(i,12)]), (cpu->R[REG_POS(i,12)]==0), c); \
 	return a; \
 	}
 
@@ -1974,9 +1956,7 @@ TEMPLATE static u32 FASTCALL  OP_ORR_S_IMM_VAL(const u32 i)
 		cpu->next_instruction = cpu->R[15]; \
 		return b; \
 	} \
-	cpu->CPSR.bits.C = c; \
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,12)]==0); \
+	armcpu_setNZC(cpu, BIT31(cpu->R[REG_POS(i,12)]), (cpu->R[REG_POS(i,12)]==0), c); \
 	return a; \
 
 TEMPLATE static u32 FASTCALL  OP_MOV_LSL_IMM(const u32 i)
@@ -2121,9 +2101,7 @@ TEMPLATE static u32 FASTCALL  OP_MOV_S_IMM_VAL(const u32 i)
 		cpu->next_instruction = cpu->R[15]; \
 		return b; \
 	} \
-	cpu->CPSR.bits.C = c; \
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,12)]==0); \
+	armcpu_setNZC(cpu, BIT31(cpu->R[REG_POS(i,12)]), (cpu->R[REG_POS(i,12)]==0), c); \
 	return a;
 	
 TEMPLATE static u32 FASTCALL  OP_BIC_LSL_IMM(const u32 i)
@@ -2264,9 +2242,7 @@ TEMPLATE static u32 FASTCALL  OP_BIC_S_IMM_VAL(const u32 i)
 		cpu->next_instruction = cpu->R[15]; \
 		return b; \
 	} \
-	cpu->CPSR.bits.C = c; \
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,12)]); \
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,12)]==0); \
+	armcpu_setNZC(cpu, BIT31(cpu->R[REG_POS(i,12)]), (cpu->R[REG_POS(i,12)]==0), c); \
 	return a;
 	
 TEMPLATE static u32 FASTCALL  OP_MVN_LSL_IMM(const u32 i)
@@ -2421,8 +2397,7 @@ TEMPLATE static u32 FASTCALL  OP_MUL_S(const u32 i)
 	u32 v = cpu->R[REG_POS(i,8)];
 	cpu->R[REG_POS(i,16)] = cpu->R[REG_POS(i,0)] * v;
 	
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,16)]);
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,16)]==0);
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_POS(i,16)]), (cpu->R[REG_POS(i,16)]==0));
 	
 	MUL_Mxx_END(1);
 }
@@ -2431,8 +2406,7 @@ TEMPLATE static u32 FASTCALL  OP_MLA_S(const u32 i)
 {
 	u32 v = cpu->R[REG_POS(i,8)];
 	cpu->R[REG_POS(i,16)] = cpu->R[REG_POS(i,0)] * v + cpu->R[REG_POS(i,12)];
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,16)]);
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,16)]==0);
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_POS(i,16)]), (cpu->R[REG_POS(i,16)]==0));
 
 	MUL_Mxx_END(2);
 }
@@ -2484,8 +2458,7 @@ TEMPLATE static u32 FASTCALL  OP_UMULL_S(const u32 i)
 	cpu->R[REG_POS(i,12)] = (u32)res;
 	cpu->R[REG_POS(i,16)] = (u32)(res>>32);
 	
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,16)]);
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,16)]==0) & (cpu->R[REG_POS(i,12)]==0);
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_POS(i,16)]), (cpu->R[REG_POS(i,16)]==0) & (cpu->R[REG_POS(i,12)]==0));
 
 	MUL_UMxxL_END(2);
 }
@@ -2498,8 +2471,7 @@ TEMPLATE static u32 FASTCALL  OP_UMLAL_S(const u32 i)
 	cpu->R[REG_POS(i,12)] = (u32)res;
 	cpu->R[REG_POS(i,16)] += (u32)(res>>32);
 	 
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,16)]);
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,16)]==0) & (cpu->R[REG_POS(i,12)]==0);
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_POS(i,16)]), (cpu->R[REG_POS(i,16)]==0) & (cpu->R[REG_POS(i,12)]==0));
 	
 	MUL_UMxxL_END(3);
 }
@@ -2563,8 +2535,7 @@ TEMPLATE static u32 FASTCALL  OP_SMULL_S(const u32 i)
 	cpu->R[REG_POS(i,12)] = (u32)res;
 	cpu->R[REG_POS(i,16)] = (u32)(res>>32);	
 	
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,16)]);
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,16)]==0) & (cpu->R[REG_POS(i,12)]==0);
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_POS(i,16)]), (cpu->R[REG_POS(i,16)]==0) & (cpu->R[REG_POS(i,12)]==0));
 
 	v &= 0xFFFFFFFF;
 		
@@ -2580,8 +2551,7 @@ TEMPLATE static u32 FASTCALL  OP_SMLAL_S(const u32 i)
 	cpu->R[REG_POS(i,12)] = (u32)res;
 	cpu->R[REG_POS(i,16)] += (u32)(res>>32);
 	 
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_POS(i,16)]);
-	cpu->CPSR.bits.Z = (cpu->R[REG_POS(i,16)]==0) & (cpu->R[REG_POS(i,12)]==0);
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_POS(i,16)]), (cpu->R[REG_POS(i,16)]==0) & (cpu->R[REG_POS(i,12)]==0));
 
 	v &= 0xFFFFFFFF;
 
@@ -6684,8 +6654,11 @@ TEMPLATE static u32 FASTCALL  OP_LDRD_STRD_POST_INDEX(const u32 i)
 		}
 		else
 		{
-			cpu->R[Rd_num] = READ32(cpu->mem_if->data, addr);
-			cpu->R[Rd_num + 1] = READ32(cpu->mem_if->data, addr + 4);
+			//both words are read before either register is written, for the data abort rollback
+			const u32 lo = READ32(cpu->mem_if->data, addr);
+			const u32 hi = READ32(cpu->mem_if->data, addr + 4);
+			cpu->R[Rd_num] = lo;
+			cpu->R[Rd_num + 1] = hi;
 			c += MMU_memAccessCycles<PROCNUM,32,MMU_AD_READ>(addr);
 			c += MMU_memAccessCycles<PROCNUM,32,MMU_AD_READ>(addr + 4);
 		}
@@ -6737,8 +6710,11 @@ TEMPLATE static u32 FASTCALL  OP_LDRD_STRD_OFFSET_PRE_INDEX(const u32 i)
 		}
 		else 
 		{
-			cpu->R[Rd_num] = READ32(cpu->mem_if->data, addr);
-			cpu->R[Rd_num + 1] = READ32(cpu->mem_if->data, addr + 4);
+			//both words are read before either register is written, for the data abort rollback
+			const u32 lo = READ32(cpu->mem_if->data, addr);
+			const u32 hi = READ32(cpu->mem_if->data, addr + 4);
+			cpu->R[Rd_num] = lo;
+			cpu->R[Rd_num + 1] = hi;
 			c += MMU_memAccessCycles<PROCNUM,32,MMU_AD_READ>(addr);
 			c += MMU_memAccessCycles<PROCNUM,32,MMU_AD_READ>(addr + 4);
 		}
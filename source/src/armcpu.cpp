@@ -21,6 +21,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <algorithm>
 #include "types.h"
@@ -37,6 +38,7 @@
 #endif
 
 template<u32> static u32 armcpu_prefetch();
+static u32 armcpu_prefetchAbortException(armcpu_t *armcpu);
 
 FORCEINLINE u32 armcpu_prefetch(armcpu_t *armcpu) { 
 	if(armcpu->proc_ID==0) return armcpu_prefetch<0>();
@@ -227,6 +229,7 @@ void armcpu_init(armcpu_t *armcpu, u32 adr)
 	armcpu->intVector = 0xFFFF0000 * (armcpu->proc_ID==0);
 	armcpu->waitIRQ = FALSE;
 	armcpu->wirq = FALSE;
+	armcpu->dataAbort = FALSE;
 
 #ifdef GDB_STUB
     armcpu->irq_flag = 0;
@@ -398,6 +401,11 @@ FORCEINLINE static u32 armcpu_prefetch()
 			armcpu->R[15] = armcpu->next_instruction + 4;
 		}
 #else
+		if(PROCNUM==0 && !armcp15_isAccessAllowed((armcp15_t*)armcpu->coproc[15],curInstruction,armcp15_accessMode(armcpu,CP15_ACCESS_EXECUTE)))
+		{
+			armcpu->instruct_adr = curInstruction;
+			return armcpu_prefetchAbortException(armcpu);
+		}
 		armcpu->instruction = _MMU_read32<PROCNUM,MMU_AT_CODE>(curInstruction&0xFFFFFFFC);
 		armcpu->instruct_adr = curInstruction;
 		armcpu->next_instruction = curInstruction + 4;
@@ -420,6 +428,11 @@ FORCEINLINE static u32 armcpu_prefetch()
 		armcpu->R[15] = armcpu->next_instruction + 2;
 	}
 #else
+	if(PROCNUM==0 && !armcp15_isAccessAllowed((armcp15_t*)armcpu->coproc[15],curInstruction,armcp15_accessMode(armcpu,CP15_ACCESS_EXECUTE)))
+	{
+		armcpu->instruct_adr = curInstruction;
+		return armcpu_prefetchAbortException(armcpu);
+	}
 	armcpu->instruction = _MMU_read16<PROCNUM, MMU_AT_CODE>(curInstruction&0xFFFFFFFE);
 	armcpu->instruct_adr = curInstruction;
 	armcpu->next_instruction = curInstruction + 2;
@@ -502,6 +515,80 @@ BOOL armcpu_irqException(armcpu_t *armcpu)
 	return TRUE;
 }
 
+//enters abort mode and jumps to the given vector. lr is relative to instruct_adr
+static void armcpu_abortException(armcpu_t *armcpu, u32 vector, u32 lrOffset)
+{
+	Status_Reg tmp = armcpu->CPSR;
+	armcpu_switchMode(armcpu, ABT);
+	armcpu->R[14] = armcpu->instruct_adr + lrOffset;
+	armcpu->SPSR = tmp;
+	armcpu->CPSR.bits.T = 0;
+	armcpu->CPSR.bits.I = 1;
+	armcpu->next_instruction = armcpu->intVector + vector;
+}
+
+//the instruction at instruct_adr was not executable. this is taken right away instead of
+//when the instruction reaches execute, which is the same thing since the previous one has completed.
+//the handler itself is fetched unchecked so a denied vector can't recurse
+static u32 armcpu_prefetchAbortException(armcpu_t *armcpu)
+{
+	armcpu_abortException(armcpu, 0x0C, 4);
+
+	const u32 curInstruction = armcpu->next_instruction;
+	armcpu->instruction = _MMU_read32<ARMCPU_ARM9,MMU_AT_CODE>(curInstruction);
+	armcpu->instruct_adr = curInstruction;
+	armcpu->next_instruction = curInstruction + 4;
+	armcpu->R[15] = curInstruction + 8;
+	return MMU_codeFetchCycles<ARMCPU_ARM9,32>(curInstruction);
+}
+
+//called on each denied data access. the first one of an instruction takes the snapshot it is rolled back to
+void armcpu_dataAbortDenied(armcpu_t *armcpu)
+{
+	if(armcpu->dataAbort) return;
+	armcpu->dataAbort = TRUE;
+	memcpy(armcpu->abortRegs, armcpu->R, sizeof(armcpu->abortRegs));
+	armcpu->abortCPSR = armcpu->CPSR;
+}
+
+//the instruction at instruct_adr made a denied data access. the access itself was dropped, and the
+//ARM946E-S is a "base restored" core: the handler sees the registers as they were before the instruction,
+//so it can retry it. every handler loads into its registers only after the access and nothing but the
+//base changes before it, so the snapshot from the first denied access plus the saved base is enough.
+//LDM may still leave the registers it loaded before the faulting word, as the architecture allows
+void armcpu_dataAbortException(armcpu_t *armcpu)
+{
+	const u32 i = armcpu->instruction;
+	armcpu->dataAbort = FALSE;
+
+	if(armcpu->CPSR.bits.mode == armcpu->abortCPSR.bits.mode)
+	{
+		memcpy(armcpu->R, armcpu->abortRegs, sizeof(armcpu->abortRegs));
+		armcpu->CPSR = armcpu->abortCPSR;
+	}
+	else if(!armcpu->abortCPSR.bits.T && BIT15(i))
+	{
+		//LDM^ with the pc switched to the SPSR mode after its loads
+		armcpu_switchMode(armcpu, armcpu->abortCPSR.bits.mode);
+		memcpy(armcpu->R, armcpu->abortRegs, sizeof(armcpu->abortRegs));
+		armcpu->CPSR = armcpu->abortCPSR;
+	}
+	//otherwise an LDM^ loading the user bank faulted; the instruction has switched back by now
+
+	if(armcpu->abortCPSR.bits.T)
+	{
+		if((i & 0xF800) == 0xC800) //LDMIA, which may have loaded its base
+			armcpu->R[(i>>8)&7] = armcpu->abortBase;
+	}
+	else
+		armcpu->R[REG_POS(i,16)] = armcpu->abortBase;
+
+	armcpu_abortException(armcpu, 0x10, 8);
+#ifndef GDB_STUB
+	armcpu->R[15] = armcpu->next_instruction + 8;
+#endif
+}
+
 BOOL
 armcpu_flagIrq( armcpu_t *armcpu) {
   if(armcpu->CPSR.bits.I) return FALSE;
@@ -558,6 +645,8 @@ u32 armcpu_exec()
 				#ifdef DEVELOPER
 				DEBUG_statistics.instructionHits[0].arm[INSTRUCTION_INDEX(ARMPROC.instruction)]++;
 				#endif
+				//every arm load and store keeps its base in Rn, and some write it back before their access
+				ARMPROC.abortBase = ARMPROC.R[REG_POS(ARMPROC.instruction,16)];
 				cExecute = arm_instructions_set_0[INSTRUCTION_INDEX(ARMPROC.instruction)](ARMPROC.instruction);
 			}
 			else {
@@ -569,6 +658,8 @@ u32 armcpu_exec()
 		}
 		else
 			cExecute = 1; // If condition=false: 1S cycle
+		if(PROCNUM==0 && ARMPROC.dataAbort)
+			armcpu_dataAbortException(&ARMPROC);
 #ifdef GDB_STUB
 		if ( ARMPROC.post_ex_fn != NULL) {
 			/* call the external post execute function */
@@ -596,6 +687,8 @@ u32 armcpu_exec()
 		#endif
 		cExecute = thumb_instructions_set_1[ARMPROC.instruction>>6](ARMPROC.instruction);
 	}
+	if(PROCNUM==0 && ARMPROC.dataAbort)
+		armcpu_dataAbortException(&ARMPROC);
 
 #ifdef GDB_STUB
 	if ( ARMPROC.post_ex_fn != NULL) {
@@ -176,6 +176,12 @@ struct armcpu_t
 	BOOL waitIRQ;
 	BOOL wirq;
 	BOOL BIOS_loaded;
+	BOOL dataAbort; //set by the MPU checked accessors when the current instruction faulted
+	//for rolling a faulted instruction back: the registers and CPSR as they were at its first denied access,
+	//and its base register (Rn, or Rb of a thumb LDMIA) from before it ran
+	u32 abortRegs[15];
+	Status_Reg abortCPSR;
+	u32 abortBase;
 
 	u32 (* *swi_tab)();
 
@@ -215,29 +221,59 @@ u32 armcpu_switchMode(armcpu_t *armcpu, u8 mode);
 template<int PROCNUM> u32 armcpu_exec();
 
 BOOL armcpu_irqException(armcpu_t *armcpu);
+void armcpu_dataAbortException(armcpu_t *armcpu);
+void armcpu_dataAbortDenied(armcpu_t *armcpu);
 BOOL armcpu_flagIrq( armcpu_t *armcpu);
 
 extern armcpu_t NDS_ARM7;
 extern armcpu_t NDS_ARM9;
 
+//flag updates for the interpreters. N, Z, C and V share the top nibble of CPSR, and a store through
+//the bitfield is a read-modify-write of the whole word per flag (with the layout swapped on big endian
+//hosts), so flag-setting instructions store them all at once. every argument is evaluated before
+//anything is written, so an expression may still read the old C
+#define CPSR_FLAGS_MASK 0xF0000000
 
-static INLINE void setIF(int PROCNUM, u32 flag)
+FORCEINLINE void armcpu_setNZ(armcpu_t *cpu, u32 n, u32 z)
 {
-	MMU.reg_IF[PROCNUM] |= flag;
+	cpu->CPSR.val = (cpu->CPSR.val & 0x3FFFFFFF) | ((n & 1) << 31) | ((z & 1) << 30);
+}
+
+FORCEINLINE void armcpu_setNZC(armcpu_t *cpu, u32 n, u32 z, u32 c)
+{
+	cpu->CPSR.val = (cpu->CPSR.val & 0x1FFFFFFF) | ((n & 1) << 31) | ((z & 1) << 30) | ((c & 1) << 29);
+}
+
+FORCEINLINE void armcpu_setNZCV(armcpu_t *cpu, u32 n, u32 z, u32 c, u32 v)
+{
+	cpu->CPSR.val = (cpu->CPSR.val & ~CPSR_FLAGS_MASK) | ((n & 1) << 31) | ((z & 1) << 30) | ((c & 1) << 29) | ((v & 1) << 28);
+}
+
 
-	extern void NDS_Reschedule();
-	NDS_Reschedule();
+//recomputes MMU.irqPending after IE, IF or IME changed.
+//an irq which becomes pending wakes a halted cpu and ends the current timeslice, so it is
+//taken at the next instruction boundary rather than at the next hardware event
+static INLINE void NDS_UpdateIRQ(int PROCNUM)
+{
+	const u32 pending = MMU.reg_IME[PROCNUM] ? (MMU.reg_IE[PROCNUM] & MMU.reg_IF[PROCNUM]) : 0;
+	MMU.irqPending[PROCNUM] = pending;
+	if(!pending) return;
 
-    //generate the interrupt if enabled
-	if ((MMU.reg_IE[PROCNUM] & (flag)) && MMU.reg_IME[PROCNUM])
+	armcpu_t &cpu = PROCNUM ? NDS_ARM7 : NDS_ARM9;
+	if(cpu.waitIRQ)
 	{
-		if(PROCNUM==0)
-			NDS_ARM9.waitIRQ = FALSE;
-		else 
-			NDS_ARM7.waitIRQ = FALSE;
+		cpu.waitIRQ = FALSE;
+		extern void NDS_Reschedule();
+		NDS_Reschedule();
 	}
 }
 
+static INLINE void setIF(int PROCNUM, u32 flag)
+{
+	MMU.reg_IF[PROCNUM] |= flag;
+	NDS_UpdateIRQ(PROCNUM);
+}
+
 static INLINE void NDS_makeARM9Int(u32 num)
 {
 	setIF(0, (1<<num));
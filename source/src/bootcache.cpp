@@ -0,0 +1,233 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "types.h"
+#include "NDSSystem.h"
+#include "MMU.h"
+#include "emufile.h"
+#include "readwrite.h"
+#include "saves.h"
+#include "movie.h"
+#include "path.h"
+#include "version.h"
+#include "bootcache.h"
+
+//each part is checked separately so the log can say why a snapshot was thrown away
+struct BootFingerprint
+{
+	u32 rom;
+	u32 system;
+	u32 settings;
+	u32 backup;
+
+	bool operator==(const BootFingerprint &other) const
+	{
+		return rom == other.rom && system == other.system
+			&& settings == other.settings && backup == other.backup;
+	}
+};
+
+static bool capturing = false;
+static u32 frame = 0;
+static BootFingerprint fingerprint;
+
+//--------------------------------------------------------------------------------
+
+static u32 crcValue(u32 crc, u32 value)
+{
+	u8 buf[4];
+	buf[0]=(u8)value;
+	buf[1]=(u8)(value>>8);
+	buf[2]=(u8)(value>>16);
+	buf[3]=(u8)(value>>24);
+	return crc32(crc, buf, 4);
+}
+
+static void computeFingerprint(BootFingerprint &fp)
+{
+	//header, secure area and size. the crc of the whole image isn't available when the rom is streamed
+	fp.rom = crc32(0, (const u8*)gameInfo.romdata, SMALL_READ);
+	fp.rom = crcValue(fp.rom, gameInfo.romsize);
+	fp.rom = crcValue(fp.rom, gameInfo.crc);
+
+	fp.system = crc32(0, MMU.fw.data, MMU.fw.size);
+	fp.system = crc32(fp.system, MMU.ARM9_BIOS, 0x8000);
+	fp.system = crc32(fp.system, MMU.ARM7_BIOS, 0x4000);
+
+	//everything that changes what the boot does or what ends up in the savestate.
+	//the build is part of it as well, since the savestate format isn't always versioned when it changes
+	const TCommonSettings &s = CommonSettings;
+	u32 flags = (s.UseExtBIOS ? 1 : 0) | (s.SWIFromBIOS ? 2 : 0) | (s.PatchSWI3 ? 4 : 0)
+		| (s.UseExtFirmware ? 8 : 0) | (s.BootFromFirmware ? 16 : 0) | (s.DebugConsole ? 32 : 0)
+		| (s.EnsataEmulation ? 64 : 0) | (s.rigorous_timing ? 128 : 0) | (s.advanced_timing ? 256 : 0)
+		| (s.GFX3D_FixedPointGeometry ? 512 : 0) | (s.spu_advanced ? 1024 : 0);
+	fp.settings = crcValue(0, flags);
+	fp.settings = crcValue(fp.settings, s.BootCacheFrame);
+	fp.settings = crc32(fp.settings, (const u8*)&s.InternalFirmConf, sizeof(s.InternalFirmConf));
+	fp.settings = crcValue(fp.settings, EMU_DESMUME_VERSION_NUMERIC());
+	static const char build[] = __DATE__ " " __TIME__;
+	fp.settings = crc32(fp.settings, (const u8*)build, sizeof(build));
+
+	//the game reads its save while booting, so a snapshot is only good for the save it was taken with
+	EMUFILE_MEMORY ms;
+	MMU_new.backupDevice.save_state(&ms);
+	fp.backup = ms.size() ? crc32(0, ms.buf(), ms.size()) : 0;
+}
+
+static void cachePath(char *buf)
+{
+	path.getpathnoext(path.STATES, buf);
+	strcat(buf, ".dsb");
+}
+
+//--------------------------------------------------------------------------------
+
+static bool readHeader(EMUFILE *is, BootFingerprint &fp, u32 &atFrame)
+{
+	char magic[8];
+	u32 version;
+	if(is->_fread(magic,8) != 8 || memcmp(magic, BOOTCACHE_MAGIC, 8)) return false;
+	if(read32le(&version,is) != 1 || version != BOOTCACHE_VERSION) return false;
+	u32 words[5];
+	if(readArrayLE(words,5,is) != 1) return false;
+	fp.rom = words[0];
+	fp.system = words[1];
+	fp.settings = words[2];
+	fp.backup = words[3];
+	atFrame = words[4];
+	return true;
+}
+
+static bool load(const char *fname)
+{
+	EMUFILE_FILE f(fname,"rb");
+	if(f.fail()) return false;
+
+	BootFingerprint stored;
+	u32 atFrame;
+	if(!readHeader(&f, stored, atFrame))
+	{
+		printf("BootCache: %s is not a boot snapshot\n", fname);
+		return false;
+	}
+
+	if(!(stored == fingerprint))
+	{
+		printf("BootCache: snapshot is stale (%s%s%s%s changed), cold booting\n",
+			stored.rom != fingerprint.rom ? "rom " : "",
+			stored.system != fingerprint.system ? "firmware/bios " : "",
+			stored.settings != fingerprint.settings ? "settings " : "",
+			stored.backup != fingerprint.backup ? "backup " : "");
+		return false;
+	}
+
+	if(!savestate_load(&f))
+	{
+		//the failed load may have left the core half restored
+		printf("BootCache: snapshot failed to load, cold booting\n");
+		NDS_Reset();
+		return false;
+	}
+
+	printf("BootCache: restored boot at frame %u\n", atFrame);
+	return true;
+}
+
+static void save()
+{
+	char fname[MAX_PATH];
+	cachePath(fname);
+
+	EMUFILE_MEMORY ms;
+	if(!savestate_save(&ms, Z_DEFAULT_COMPRESSION))
+	{
+		printf("BootCache: savestate failed, nothing cached\n");
+		return;
+	}
+
+	EMUFILE_FILE f(fname,"wb");
+	if(f.fail())
+	{
+		printf("BootCache: can't create %s\n", fname);
+		return;
+	}
+	f.fwrite(BOOTCACHE_MAGIC,8);
+	write32le(BOOTCACHE_VERSION,&f);
+	const u32 words[5] = { fingerprint.rom, fingerprint.system, fingerprint.settings, fingerprint.backup, frame };
+	writeArrayLE(words,5,&f);
+	f.fwrite(ms.buf(),ms.size());
+
+	printf("BootCache: boot cached at frame %u\n", frame);
+}
+
+//--------------------------------------------------------------------------------
+
+bool BootCache_Start()
+{
+	capturing = false;
+	if(!CommonSettings.BootCache) return false;
+
+#ifdef _MOVIETIME_
+	//a movie has to play back from power on
+	if(movieMode != MOVIEMODE_INACTIVE) return false;
+#endif
+
+	computeFingerprint(fingerprint);
+
+	char fname[MAX_PATH];
+	cachePath(fname);
+	if(load(fname))
+		return true;
+
+	frame = 0;
+	capturing = true;
+	return false;
+}
+
+void BootCache_Cancel()
+{
+	capturing = false;
+}
+
+void BootCache_FrameEnded()
+{
+	if(!capturing) return;
+
+	frame++;
+
+	//LagFrameFlag is cleared by the arm9 reading the keypad during this frame
+	const bool done = CommonSettings.BootCacheFrame
+		? frame >= CommonSettings.BootCacheFrame
+		: !LagFrameFlag;
+
+	if(done)
+	{
+		capturing = false;
+		save();
+	}
+	else if(frame >= BOOTCACHE_MAX_FRAMES && !CommonSettings.BootCacheFrame)
+	{
+		printf("BootCache: no input poll after %u frames, not caching\n", frame);
+		capturing = false;
+	}
+}
@@ -0,0 +1,50 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _BOOTCACHE_H_
+#define _BOOTCACHE_H_
+
+#include "types.h"
+
+//fast boot snapshots.
+//the first boot of a rom runs normally and a savestate is taken once the boot is over: either at a
+//fixed frame or at the first frame in which the game reads the keypad. later starts with the same
+//rom, firmware, bios, backup memory and emulation settings load that state instead of running the
+//intros again. the file lives next to the savestates with a .dsb extension.
+//
+//file layout: "DSMBOOT1", the version, the four fingerprint words, the frame the state was taken at,
+//then an ordinary savestate. all little endian
+
+#define BOOTCACHE_MAGIC "DSMBOOT1"
+#define BOOTCACHE_VERSION 1
+
+//never wait longer than this for the first input poll; a rom which only polls later isn't cached
+#define BOOTCACHE_MAX_FRAMES 3600
+
+//call right after NDS_LoadROM, with the firmware and bios in place. returns true when the boot was
+//restored from the cache; otherwise the snapshot is taken later by BootCache_FrameEnded
+bool BootCache_Start();
+
+//forgets a pending capture
+void BootCache_Cancel();
+
+//called by the core at the end of every emulated frame
+void BootCache_FrameEnded();
+
+#endif
@@ -20,10 +20,12 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "cp15.h"
 #include "debug.h"
 #include "MMU.h"
+#include "MMU_timing.h"
 
 armcp15_t *armcp15_new(armcpu_t * c)
 {
@@ -72,6 +74,7 @@ armcp15_t *armcp15_new(armcpu_t * c)
 		armcp15->regionExecuteSet_USR[i] = 0 ;
 		armcp15->regionExecuteSet_SYS[i] = 0 ;
 	} ;
+	armcp15_maskPrecalc(armcp15);
 
 	return armcp15;
 }
@@ -190,8 +193,104 @@ static void armcp15_setSingleRegionAccess(armcp15_t *armcp15,u32 dAccess,u32 iAc
 	}
 } ;
 
+/* rights of a region as CP15_PERM_* bits */
+static u8 armcp15_regionPerm(u32 dAccess,u32 iAccess,unsigned char num)
+{
+	u8 perm = 0 ;
+	switch (ACCESSTYPE(dAccess,num)) {
+		case 1: perm = CP15_PERM(CP15_ACCESS_READSYS) | CP15_PERM(CP15_ACCESS_WRITESYS) ; break ;
+		case 2: perm = CP15_PERM(CP15_ACCESS_READSYS) | CP15_PERM(CP15_ACCESS_WRITESYS) | CP15_PERM(CP15_ACCESS_READUSR) ; break ;
+		case 3: perm = CP15_PERM(CP15_ACCESS_READSYS) | CP15_PERM(CP15_ACCESS_WRITESYS) | CP15_PERM(CP15_ACCESS_READUSR) | CP15_PERM(CP15_ACCESS_WRITEUSR) ; break ;
+		case 5: perm = CP15_PERM(CP15_ACCESS_READSYS) ; break ;
+		case 6: perm = CP15_PERM(CP15_ACCESS_READSYS) | CP15_PERM(CP15_ACCESS_READUSR) ; break ;
+		default: break ; /* no access or UNP */
+	}
+	switch (ACCESSTYPE(iAccess,num)) {
+		case 1: perm |= CP15_PERM(CP15_ACCESS_EXECSYS) ; break ;
+		case 2:
+		case 3:
+		case 6: perm |= CP15_PERM(CP15_ACCESS_EXECSYS) | CP15_PERM(CP15_ACCESS_EXECUSR) ; break ;
+		default: break ;
+	}
+	return perm ;
+}
+
+/* cache and write buffer bits of a region as CP15_ATTR_* */
+static u8 armcp15_regionAttr(armcp15_t *armcp15,unsigned char num)
+{
+	u8 attr = 0 ;
+	if (BIT_N(armcp15->DCConfig,num) && BIT2(armcp15->ctrl)) attr |= CP15_ATTR_DCACHE ;
+	if (BIT_N(armcp15->ICConfig,num) && BIT12(armcp15->ctrl)) attr |= CP15_ATTR_ICACHE ;
+	if (BIT_N(armcp15->writeBuffCtrl,num)) attr |= CP15_ATTR_BUFFER ;
+	return attr ;
+}
+
+/* rebuild the section/page rights and attribute tables. regions are painted in ascending order
+   since the higher numbered region takes priority where they overlap */
+static void armcp15_tablePrecalc(armcp15_t *armcp15)
+{
+	int i ;
+	u32 pagesUsed = 0 ;
+
+	memset(armcp15->sectionPage,0,sizeof(armcp15->sectionPage)) ;
+	if (!(armcp15->ctrl & 1))
+	{
+		/* protection checking is not enabled */
+		memset(armcp15->sectionPerm,CP15_PERM_ALL,sizeof(armcp15->sectionPerm)) ;
+		/* without it the data cache is off, while the instruction cache covers everything */
+		memset(armcp15->sectionAttr,BIT12(armcp15->ctrl) ? CP15_ATTR_ICACHE : 0,sizeof(armcp15->sectionAttr)) ;
+		return ;
+	}
+	/* background region: no access at all, uncached and unbuffered */
+	memset(armcp15->sectionPerm,0,sizeof(armcp15->sectionPerm)) ;
+	memset(armcp15->sectionAttr,0,sizeof(armcp15->sectionAttr)) ;
+
+	for (i=0;i<8;i++)
+	{
+		const u32 reg = (&armcp15->protectBaseSize0)[i] ;
+		if (!BIT_N(reg,0)) continue ;
+		const u8 perm = armcp15->regionPerm[i] ;
+		const u8 attr = armcp15_regionAttr(armcp15,i) ;
+		const u32 sizeShift = SIZEIDENTIFIER(reg)+1 ;
+
+		if (sizeShift >= 22)
+		{
+			/* whole sections, any page tables below are fully covered now */
+			const u32 first = (sizeShift >= 32) ? 0 : (armcp15->regionSet[i] >> 22) ;
+			const u32 count = (sizeShift >= 32) ? CP15_SECTION_COUNT : (1 << (sizeShift-22)) ;
+			memset(armcp15->sectionPerm+first,perm,count) ;
+			memset(armcp15->sectionAttr+first,attr,count) ;
+			memset(armcp15->sectionPage+first,0,count) ;
+			continue ;
+		}
+
+		/* the region lies within a single section, split it into pages */
+		const u32 section = armcp15->regionSet[i] >> 22 ;
+		u8 page = armcp15->sectionPage[section] ;
+		if (!page)
+		{
+			page = ++pagesUsed ;
+			memset(armcp15->pagePerm[page-1],armcp15->sectionPerm[section],CP15_PAGES_PER_SECTION) ;
+			memset(armcp15->pageAttr[page-1],armcp15->sectionAttr[section],CP15_PAGES_PER_SECTION) ;
+			armcp15->sectionPage[section] = page ;
+		}
+		const u32 first = (armcp15->regionSet[i] >> 12) & 0x3FF ;
+		if (sizeShift >= 12)
+		{
+			memset(armcp15->pagePerm[page-1]+first,perm,1 << (sizeShift-12)) ;
+			memset(armcp15->pageAttr[page-1]+first,attr,1 << (sizeShift-12)) ;
+		}
+		else
+		{
+			armcp15->pagePerm[page-1][first] |= CP15_PERM_EXACT ;
+			/* the attributes only steer timing, so the whole page takes the small region's */
+			armcp15->pageAttr[page-1][first] = attr ;
+		}
+	}
+}
+
 /* precalculate region masks/sets from cp15 register */
-static void armcp15_maskPrecalc(armcp15_t *armcp15)
+void armcp15_maskPrecalc(armcp15_t *armcp15)
 {
 #define precalc(num) {  \
 	u32 mask = 0, set = 0xFFFFFFFF ; /* (x & 0) == 0xFF..FF is allways false (disabled) */  \
@@ -205,6 +304,9 @@ static void armcp15_maskPrecalc(armcp15_t *armcp15)
 		} \
 	}  \
 	armcp15_setSingleRegionAccess(armcp15,armcp15->DaccessPerm,armcp15->IaccessPerm,num,mask,set) ;  \
+	armcp15->regionMask[num] = mask ;  \
+	armcp15->regionSet[num] = set ;  \
+	armcp15->regionPerm[num] = armcp15_regionPerm(armcp15->DaccessPerm,armcp15->IaccessPerm,num) ;  \
 }
 	precalc(0) ;
 	precalc(1) ;
@@ -214,33 +316,25 @@ static void armcp15_maskPrecalc(armcp15_t *armcp15)
 	precalc(5) ;
 	precalc(6) ;
 	precalc(7) ;
+#undef precalc
+	armcp15_tablePrecalc(armcp15) ;
+	/* the timing model remembers the last line it found cached */
+	if (armcp15->cpu == &NDS_ARM9)
+	{
+		MMU_timing.arm9codeCache.ForgetLast() ;
+		MMU_timing.arm9dataCache.ForgetLast() ;
+	}
 }
 
-BOOL armcp15_isAccessAllowed(armcp15_t *armcp15,u32 address,u32 access)
+/* exact check, only needed for pages covered by a region smaller than 4KB */
+BOOL armcp15_isAccessAllowedExact(armcp15_t *armcp15,u32 address,u32 access)
 {
 	int i ;
 	if (!(armcp15->ctrl & 1)) return TRUE ;        /* protection checking is not enabled */
-	for (i=0;i<8;i++) {
-		switch (access) {
-		case CP15_ACCESS_WRITEUSR:
-			if ((address & armcp15->regionWriteMask_USR[i]) == armcp15->regionWriteSet_USR[i]) return TRUE ;
-			break ;
-		case CP15_ACCESS_WRITESYS:
-			if ((address & armcp15->regionWriteMask_SYS[i]) == armcp15->regionWriteSet_SYS[i]) return TRUE ;
-			break ;
-		case CP15_ACCESS_READUSR:
-			if ((address & armcp15->regionReadMask_USR[i]) == armcp15->regionReadSet_USR[i]) return TRUE ;
-			break ;
-		case CP15_ACCESS_READSYS:
-			if ((address & armcp15->regionReadMask_SYS[i]) == armcp15->regionReadSet_SYS[i]) return TRUE ;
-			break ;
-		case CP15_ACCESS_EXECUSR:
-			if ((address & armcp15->regionExecuteMask_USR[i]) == armcp15->regionExecuteSet_USR[i]) return TRUE ;
-			break ;
-		case CP15_ACCESS_EXECSYS:
-			if ((address & armcp15->regionExecuteMask_SYS[i]) == armcp15->regionExecuteSet_SYS[i]) return TRUE ;
-			break ;
-		}
+	for (i=7;i>=0;i--) {
+		/* the highest numbered region containing the address decides */
+		if ((address & armcp15->regionMask[i]) == armcp15->regionSet[i])
+			return (armcp15->regionPerm[i] >> access) & 1 ;
 	}
 	/* when protections are enabled, but no region allows access, deny access */
 	return FALSE ;
@@ -432,9 +526,60 @@ static u32 CP15wait4IRQ(armcpu_t *cpu)
 	cpu->next_instruction = instructAddr;
 	/* CHECKME: IME shouldn't be modified (?) */
 	MMU.reg_IME[0] = 1;
+	NDS_UpdateIRQ(ARMCPU_ARM9);
 	return 1;
 }
 
+/* c7 cache maintenance. the caches only exist in the timing model, so that is all there is to maintain */
+static BOOL armcp15_cacheOp(armcp15_t *armcp15, u32 val, u8 CRm, u8 opcode2)
+{
+	/* a dirty line written back to main memory, 8 words */
+	static const u32 lineWriteBack = 8 * 4;
+
+	const bool arm9 = armcp15->cpu == &NDS_ARM9;
+	bool dirty = false;
+	switch(CRm)
+	{
+	case 5: /* invalidate instruction cache, all or a line */
+		if(opcode2 > 1) return FALSE;
+		if(!arm9) return TRUE;
+		if(opcode2 == 0) MMU_timing.arm9codeCache.InvalidateAll();
+		else MMU_timing.arm9codeCache.Maintain(val, false, false, true);
+		return TRUE;
+	case 6: /* invalidate data cache, all or a line. dirty data is lost */
+		if(opcode2 > 1) return FALSE;
+		if(!arm9) return TRUE;
+		if(opcode2 == 0) MMU_timing.arm9dataCache.InvalidateAll();
+		else MMU_timing.arm9dataCache.Maintain(val, false, false, true);
+		return TRUE;
+	case 10: /* clean data cache line by address or by index, or drain the write buffer */
+		if(opcode2 == 4)
+		{
+			/* the wait isn't charged to the instruction */
+			if(arm9) MMU_timing.arm9writeBuffer.Drain();
+			return TRUE;
+		}
+		if(opcode2 != 1 && opcode2 != 2) return FALSE;
+		if(arm9) dirty = MMU_timing.arm9dataCache.Maintain(val, opcode2 == 2, true, false);
+		break;
+	case 13: /* prefetch instruction cache line */
+		if(opcode2 != 1) return FALSE;
+		if(arm9 && MMU_timing.arm9codeCache.Lookup(val) < 0)
+			MMU_timing.arm9codeCache.Fill(val);
+		return TRUE;
+	case 14: /* clean and invalidate data cache line by address or by index */
+		if(opcode2 != 1 && opcode2 != 2) return FALSE;
+		if(arm9) dirty = MMU_timing.arm9dataCache.Maintain(val, opcode2 == 2, true, true);
+		break;
+	default:
+		return FALSE;
+	}
+
+	if(dirty)
+		MMU_timing.arm9writeBuffer.Push(lineWriteBack);
+	return TRUE;
+}
+
 BOOL armcp15_moveARM2CP(armcp15_t *armcp15, u32 val, u8 CRn, u8 CRm, u8 opcode1, u8 opcode2)
 {
 	if(armcp15->cpu->CPSR.bits.mode == USR) return FALSE;
@@ -451,6 +596,12 @@ BOOL armcp15_moveARM2CP(armcp15_t *armcp15, u32 val, u8 CRn, u8 CRm, u8 opcode1,
 			//zero 31-jan-2010: change from 0x0FFF0000 to 0xFFFF0000 per gbatek
 			armcp15->cpu->intVector = 0xFFFF0000 * (BIT13(val));
 			armcp15->cpu->LDTBit = !BIT15(val); //TBit
+			if(armcp15->cpu == &NDS_ARM9)
+			{
+				MMU_timing.arm9codeCache.SetRoundRobin(BIT14(val));
+				MMU_timing.arm9dataCache.SetRoundRobin(BIT14(val));
+			}
+			armcp15_maskPrecalc(armcp15);
 			//LOG("CP15: ARMtoCP ctrl %08X (val %08X)\n", armcp15->ctrl, val);
 			return TRUE;
 		}
@@ -462,9 +613,11 @@ BOOL armcp15_moveARM2CP(armcp15_t *armcp15, u32 val, u8 CRn, u8 CRm, u8 opcode1,
 			{
 			case 0:
 				armcp15->DCConfig = val;
+				armcp15_maskPrecalc(armcp15);
 				return TRUE;
 			case 1:
 				armcp15->ICConfig = val;
+				armcp15_maskPrecalc(armcp15);
 				return TRUE;
 			default:
 				return FALSE;
@@ -475,6 +628,7 @@ BOOL armcp15_moveARM2CP(armcp15_t *armcp15, u32 val, u8 CRn, u8 CRm, u8 opcode1,
 		if((opcode1==0) && (opcode2==0) && (CRm==0))
 		{
 			armcp15->writeBuffCtrl = val;
+			armcp15_maskPrecalc(armcp15);
 			return TRUE;
 		}
 		return FALSE;
@@ -544,6 +698,8 @@ BOOL armcp15_moveARM2CP(armcp15_t *armcp15, u32 val, u8 CRn, u8 CRm, u8 opcode1,
 			CP15wait4IRQ(armcp15->cpu);
 			return TRUE;
 		}
+		if(opcode1==0)
+			return armcp15_cacheOp(armcp15, val, CRm, opcode2);
 		return FALSE;
 	case 9:
 		if((opcode1==0))
@@ -555,9 +711,11 @@ BOOL armcp15_moveARM2CP(armcp15_t *armcp15, u32 val, u8 CRn, u8 CRm, u8 opcode1,
 				{
 				case 0:
 					armcp15->DcacheLock = val;
+					if(armcp15->cpu == &NDS_ARM9) MMU_timing.arm9dataCache.SetLockdown(val);
 					return TRUE;
 				case 1:
 					armcp15->IcacheLock = val;
+					if(armcp15->cpu == &NDS_ARM9) MMU_timing.arm9codeCache.SetLockdown(val);
 					return TRUE;
 				default:
 					return FALSE;
@@ -568,6 +726,7 @@ BOOL armcp15_moveARM2CP(armcp15_t *armcp15, u32 val, u8 CRn, u8 CRm, u8 opcode1,
 				case 0:
 					armcp15->DTCMRegion = val;
 					MMU.DTCMRegion = val & 0x0FFFFFFC0;
+					MMU_updateFastRegions();
 					return TRUE;
 				case 1:
 					armcp15->ITCMRegion = val;
@@ -23,6 +23,9 @@
 
 #include "armcpu.h"
 
+#define CP15_SECTION_COUNT        1024
+#define CP15_PAGES_PER_SECTION    1024
+
 struct armcp15_t
 {
         u32 IDCode;
@@ -66,6 +69,19 @@ struct armcp15_t
         u32 regionReadSet_SYS[8] ;
         u32 regionExecuteSet_USR[8] ;
         u32 regionExecuteSet_SYS[8] ;
+        /* address match (ignoring rights) and CP15_PERM_* rights of each region, for the exact check */
+        u32 regionMask[8] ;
+        u32 regionSet[8] ;
+        u8 regionPerm[8] ;
+        /* coarse rights table: one entry per 4MB section. sections split between regions
+           point (index+1) at a per-4KB page table from the pool; a region smaller than
+           4MB always lies in one section, so 8 page tables are enough */
+        u8 sectionPerm[CP15_SECTION_COUNT] ;
+        u8 sectionPage[CP15_SECTION_COUNT] ;
+        u8 pagePerm[8][CP15_PAGES_PER_SECTION] ;
+        /* CP15_ATTR_* cache and write buffer bits, laid out like the rights tables */
+        u8 sectionAttr[CP15_SECTION_COUNT] ;
+        u8 pageAttr[8][CP15_PAGES_PER_SECTION] ;
 
 	armcpu_t * cpu;
 
@@ -77,7 +93,8 @@ BOOL armcp15_load(armcp15_t *armcp15, u8 CRd, u8 adr);
 BOOL armcp15_store(armcp15_t *armcp15, u8 CRd, u8 adr);
 BOOL armcp15_moveCP2ARM(armcp15_t *armcp15, u32 * R, u8 CRn, u8 CRm, u8 opcode1, u8 opcode2);
 BOOL armcp15_moveARM2CP(armcp15_t *armcp15, u32 val, u8 CRn, u8 CRm, u8 opcode1, u8 opcode2);
-BOOL armcp15_isAccessAllowed(armcp15_t *armcp15,u32 address,u32 access);
+void armcp15_maskPrecalc(armcp15_t *armcp15);
+BOOL armcp15_isAccessAllowedExact(armcp15_t *armcp15,u32 address,u32 access);
 
 
 #define CP15_ACCESS_WRITE         0
@@ -90,4 +107,73 @@ BOOL armcp15_isAccessAllowed(armcp15_t *armcp15,u32 address,u32 access);
 #define CP15_ACCESS_EXECUSR       CP15_ACCESS_EXECUTE
 #define CP15_ACCESS_EXECSYS       5
 
+/* one bit per CP15_ACCESS_* value in the rights tables */
+#define CP15_PERM(access)         (1 << (access))
+#define CP15_PERM_ALL             0x3F
+/* page is covered by a region smaller than 4KB: only the per-region check is exact */
+#define CP15_PERM_EXACT           0x80
+
+FORCEINLINE BOOL armcp15_isAccessAllowed(armcp15_t *armcp15,u32 address,u32 access)
+{
+	const u32 section = address >> 22;
+	const u8 page = armcp15->sectionPage[section];
+	const u8 perm = page ? armcp15->pagePerm[page-1][(address >> 12) & 0x3FF] : armcp15->sectionPerm[section];
+	if (perm & CP15_PERM_EXACT) return armcp15_isAccessAllowedExact(armcp15,address,access);
+	return (perm >> access) & 1;
+}
+
+/* memory attributes of a region, with the cache enable bits of the control register applied */
+#define CP15_ATTR_DCACHE          1
+#define CP15_ATTR_ICACHE          2
+#define CP15_ATTR_BUFFER          4
+
+FORCEINLINE u8 armcp15_memAttr(armcp15_t *armcp15,u32 address)
+{
+	const u32 section = address >> 22;
+	const u8 page = armcp15->sectionPage[section];
+	return page ? armcp15->pageAttr[page-1][(address >> 12) & 0x3FF] : armcp15->sectionAttr[section];
+}
+
+/* the access type as seen by the protection unit for the current cpu mode */
+FORCEINLINE u32 armcp15_accessMode(armcpu_t *cpu, u32 access)
+{
+	return access | (cpu->CPSR.bits.mode != USR);
+}
+
+/* MPU checked accessors used by the cpu cores. the ARM7 has no protection unit.
+   a denied data access is dropped (reads return 0) and the abort is raised
+   once the instruction completes, see armcpu_exec. the registers are rolled back then */
+template<int PROCNUM> FORCEINLINE bool MMU_dataAccessAllowed(u32 adr, u32 access)
+{
+	if (PROCNUM != ARMCPU_ARM9) return true;
+	if (armcp15_isAccessAllowed((armcp15_t*)NDS_ARM9.coproc[15],adr,armcp15_accessMode(&NDS_ARM9,access))) return true;
+	armcpu_dataAbortDenied(&NDS_ARM9);
+	return false;
+}
+
+template<int PROCNUM> FORCEINLINE u8 MMU_read8_acl(u32 adr)
+{
+	return MMU_dataAccessAllowed<PROCNUM>(adr,CP15_ACCESS_READ) ? _MMU_read08<PROCNUM>(adr) : 0;
+}
+template<int PROCNUM> FORCEINLINE u16 MMU_read16_acl(u32 adr)
+{
+	return MMU_dataAccessAllowed<PROCNUM>(adr,CP15_ACCESS_READ) ? _MMU_read16<PROCNUM>(adr) : 0;
+}
+template<int PROCNUM> FORCEINLINE u32 MMU_read32_acl(u32 adr)
+{
+	return MMU_dataAccessAllowed<PROCNUM>(adr,CP15_ACCESS_READ) ? _MMU_read32<PROCNUM>(adr) : 0;
+}
+template<int PROCNUM> FORCEINLINE void MMU_write8_acl(u32 adr, u8 val)
+{
+	if (MMU_dataAccessAllowed<PROCNUM>(adr,CP15_ACCESS_WRITE)) _MMU_write08<PROCNUM>(adr,val);
+}
+template<int PROCNUM> FORCEINLINE void MMU_write16_acl(u32 adr, u16 val)
+{
+	if (MMU_dataAccessAllowed<PROCNUM>(adr,CP15_ACCESS_WRITE)) _MMU_write16<PROCNUM>(adr,val);
+}
+template<int PROCNUM> FORCEINLINE void MMU_write32_acl(u32 adr, u32 val)
+{
+	if (MMU_dataAccessAllowed<PROCNUM>(adr,CP15_ACCESS_WRITE)) _MMU_write32<PROCNUM>(adr,val);
+}
+
 #endif /* __CP15_H__*/
@@ -0,0 +1,322 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <gccore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "types.h"
+#include "armcpu.h"
+#include "MMU.h"
+#include "mem.h"
+#include "NDSSystem.h"
+#include "cputrace.h"
+
+#define RING_MASK (CPUTRACE_RING_SIZE-1)
+
+bool cpuTraceActive = false;
+
+static CpuTraceConfig config;
+static FILE *tracefp = NULL;
+
+//single producer (the cpu loop), single consumer (the writer thread).
+//each side only ever writes its own index, so no lock is needed
+static CpuTraceRecord *ring = NULL;
+static volatile u32 ringHead = 0;
+static volatile u32 ringTail = 0;
+
+static lwp_t tracethread = LWP_THREAD_NULL;
+static volatile bool tracequit = false;
+
+static bool running = false;
+static bool windowOpen = false;
+static bool triggered = false;
+static u32 frame = 0;
+static u32 instructions = 0;
+static u32 watchValue = 0;
+
+static struct
+{
+	u32 shadow[15];
+	bool resync;
+} traceCpu[2];
+
+//--------------------------------------------------------------------------------
+//ring
+
+static FORCEINLINE CpuTraceRecord &ringReserve()
+{
+	//the writer is behind. the trace has to stay complete, so wait for it rather than drop
+	while(ringHead - ringTail >= CPUTRACE_RING_SIZE)
+		usleep(100);
+	return ring[ringHead & RING_MASK];
+}
+
+static FORCEINLINE void ringCommit()
+{
+	//the record has to be visible before the index which publishes it
+	__sync_synchronize();
+	ringHead++;
+}
+
+static void *trace_thread(void*)
+{
+	for(;;)
+	{
+		const u32 head = ringHead;
+		__sync_synchronize();
+		u32 tail = ringTail;
+
+		if(head == tail)
+		{
+			//records committed between reading head and seeing the flag still have to go out,
+			//so only leave once the ring is empty after the flag was seen
+			if(tracequit)
+			{
+				__sync_synchronize();
+				if(ringHead == tail) break;
+				continue;
+			}
+			usleep(2000);
+			continue;
+		}
+
+		//at most two contiguous runs, split where the ring wraps
+		while(tail != head)
+		{
+			const u32 start = tail & RING_MASK;
+			u32 count = head - tail;
+			if(start + count > CPUTRACE_RING_SIZE)
+				count = CPUTRACE_RING_SIZE - start;
+			fwrite(ring + start, sizeof(CpuTraceRecord), count, tracefp);
+			tail += count;
+		}
+
+		__sync_synchronize();
+		ringTail = tail;
+	}
+
+	return NULL;
+}
+
+//--------------------------------------------------------------------------------
+
+static void updateActive()
+{
+	const bool done = config.maxInstructions && instructions >= config.maxInstructions;
+	cpuTraceActive = running && windowOpen && !done;
+}
+
+static void emitWatch(u32 oldValue, u32 newValue)
+{
+	CpuTraceRecord &rec = ringReserve();
+	rec.kind = CPUTRACE_WATCH;
+	rec.cpu = 0;
+	rec.mask = 0;
+	rec.data[0] = config.watchAddr;
+	rec.data[1] = oldValue;
+	rec.data[2] = newValue;
+	ringCommit();
+}
+
+static u32 readWatch()
+{
+	return T1ReadLong(MMU.MAIN_MEM, config.watchAddr & _MMU_MAIN_MEM_MASK32);
+}
+
+template<int PROCNUM>
+static FORCEINLINE bool checkTriggers(const armcpu_t &cpu)
+{
+	if(config.pcHi && cpu.instruct_adr >= config.pcLo && cpu.instruct_adr <= config.pcHi)
+		return true;
+
+	if(config.watchAddr)
+	{
+		const u32 value = readWatch();
+		if(value != watchValue)
+		{
+			emitWatch(watchValue, value);
+			watchValue = value;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template<int PROCNUM>
+void CpuTrace_Step(u64 cycle)
+{
+	if(!(config.cpuMask & (1<<PROCNUM))) return;
+
+	const armcpu_t &cpu = PROCNUM ? NDS_ARM7 : NDS_ARM9;
+
+	if(!triggered)
+	{
+		if(!checkTriggers<PROCNUM>(cpu)) return;
+		triggered = true;
+	}
+
+	//R15 is left out, the pc is always in the record
+	u32 values[15];
+	u16 mask = 0;
+	int count = 0;
+	u32 *shadow = traceCpu[PROCNUM].shadow;
+	const bool resync = traceCpu[PROCNUM].resync;
+	for(int i=0;i<15;i++)
+	{
+		if(resync || cpu.R[i] != shadow[i])
+		{
+			mask |= 1<<i;
+			values[count++] = shadow[i] = cpu.R[i];
+		}
+	}
+	traceCpu[PROCNUM].resync = false;
+
+	CpuTraceRecord &rec = ringReserve();
+	rec.kind = CPUTRACE_EXEC;
+	rec.cpu = PROCNUM;
+	rec.mask = mask;
+	rec.data[0] = cpu.instruct_adr;
+	rec.data[1] = cpu.instruction;
+	rec.data[2] = cpu.CPSR.val;
+	rec.data[3] = (u32)cycle;
+	for(int i=0;i<3;i++)
+		rec.data[4+i] = (i < count) ? values[i] : 0;
+	ringCommit();
+
+	//the rest of the changed registers, seven to a record
+	u16 remaining = mask;
+	for(int i=0;i<3 && remaining;i++)
+		remaining &= remaining-1;
+	for(int done=3;done<count;done+=7)
+	{
+		CpuTraceRecord &regs = ringReserve();
+		regs.kind = CPUTRACE_REGS;
+		regs.cpu = PROCNUM;
+		regs.mask = 0;
+		for(int i=0;i<7;i++)
+		{
+			if(done+i < count)
+			{
+				regs.mask |= remaining & -remaining;
+				remaining &= remaining-1;
+				regs.data[i] = values[done+i];
+			}
+			else
+				regs.data[i] = 0;
+		}
+		ringCommit();
+	}
+
+	if(config.maxInstructions && ++instructions >= config.maxInstructions)
+		updateActive();
+}
+
+template void CpuTrace_Step<0>(u64 cycle);
+template void CpuTrace_Step<1>(u64 cycle);
+
+void CpuTrace_FrameEnded()
+{
+	if(!running) return;
+
+	if(cpuTraceActive)
+	{
+		CpuTraceRecord &rec = ringReserve();
+		memset(&rec, 0, sizeof(rec));
+		rec.kind = CPUTRACE_FRAME;
+		rec.data[0] = frame;
+		rec.data[1] = (u32)nds_timer;
+		rec.data[2] = (u32)(nds_timer >> 32);
+		ringCommit();
+	}
+
+	frame++;
+	windowOpen = frame >= config.frameStart && (!config.frameEnd || frame < config.frameEnd);
+	updateActive();
+}
+
+//--------------------------------------------------------------------------------
+
+bool CpuTrace_Start(const char *fname, const CpuTraceConfig &cfg)
+{
+	CpuTrace_Stop();
+
+	ring = (CpuTraceRecord*)malloc(sizeof(CpuTraceRecord)*CPUTRACE_RING_SIZE);
+	tracefp = fopen(fname, "wb");
+	if(!ring || !tracefp)
+	{
+		free(ring);
+		if(tracefp) fclose(tracefp);
+		ring = NULL;
+		tracefp = NULL;
+		return false;
+	}
+
+	CpuTraceHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CPUTRACE_MAGIC, 8);
+	header.endian = CPUTRACE_ENDIAN;
+	header.version = CPUTRACE_VERSION;
+	header.recordSize = sizeof(CpuTraceRecord);
+	fwrite(&header, sizeof(header), 1, tracefp);
+
+	config = cfg;
+	if(!config.cpuMask) config.cpuMask = 3;
+	ringHead = ringTail = 0;
+	frame = 0;
+	instructions = 0;
+	triggered = !config.pcHi && !config.watchAddr;
+	if(config.watchAddr)
+		watchValue = readWatch();
+	traceCpu[0].resync = traceCpu[1].resync = true;
+
+	tracequit = false;
+	LWP_CreateThread(&tracethread, trace_thread, NULL, NULL, 0, 40);
+
+	running = true;
+	windowOpen = config.frameStart == 0;
+	updateActive();
+	return true;
+}
+
+void CpuTrace_Stop()
+{
+	if(!running) return;
+
+	running = false;
+	updateActive();
+
+	//the writer drains the ring before it sees the quit flag
+	tracequit = true;
+	LWP_JoinThread(tracethread, NULL);
+	tracethread = LWP_THREAD_NULL;
+
+	fclose(tracefp);
+	tracefp = NULL;
+	free(ring);
+	ring = NULL;
+}
+
+bool CpuTrace_IsRunning()
+{
+	return running;
+}
@@ -0,0 +1,98 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _CPUTRACE_H_
+#define _CPUTRACE_H_
+
+#include "types.h"
+
+//binary execution trace of both cpus.
+//the cpu loop appends fixed size records to a single producer/single consumer ring,
+//which a writer thread drains to disk. nothing is disassembled while tracing;
+//source/tools/tracedump.cpp decodes the file offline.
+//
+//file layout: CpuTraceHeader, then CpuTraceRecords. both are written in host byte order,
+//the header's endian field tells the decoder whether to swap.
+
+#define CPUTRACE_MAGIC "DSMTRACE"
+#define CPUTRACE_VERSION 1
+#define CPUTRACE_ENDIAN 0x01020304
+
+//records in the ring. at 32 bytes each this is 2MB
+#define CPUTRACE_RING_SIZE 65536
+
+enum CPUTRACE_KIND
+{
+	//data[0]=pc data[1]=opcode data[2]=cpsr data[3]=low 32 bits of the cycle stamp
+	//data[4..6]=the first changed registers. mask=every register among R0-R14 which changed
+	//since the previous record of this cpu, any values past the first three follow in REGS records
+	CPUTRACE_EXEC = 1,
+	//data[0..6]=register values continuing the preceding EXEC record. mask=the registers in this record
+	CPUTRACE_REGS = 2,
+	//end of a frame. data[0]=frame number since CpuTrace_Start data[1..2]=nds_timer low/high
+	CPUTRACE_FRAME = 3,
+	//the memory watch fired. data[0]=address data[1]=old value data[2]=new value
+	CPUTRACE_WATCH = 4
+};
+
+struct CpuTraceHeader
+{
+	char magic[8];
+	u32 endian;
+	u32 version;
+	u32 recordSize;
+	u32 reserved;
+};
+
+struct CpuTraceRecord
+{
+	u8 kind;
+	u8 cpu;
+	u16 mask;
+	u32 data[7];
+};
+
+struct CpuTraceConfig
+{
+	//bit 0 traces the arm9, bit 1 the arm7
+	u32 cpuMask;
+	//frames, counted from CpuTrace_Start, during which records are taken. end 0 means no end
+	u32 frameStart, frameEnd;
+	//when pcHi is non-zero, tracing only begins once a traced cpu executes inside [pcLo,pcHi]
+	u32 pcLo, pcHi;
+	//when non-zero, tracing only begins once the main memory word at watchAddr changes
+	u32 watchAddr;
+	//stop after this many instructions once triggered. 0 means no limit
+	u32 maxInstructions;
+};
+
+//true while the cpu loop has to report instructions
+extern bool cpuTraceActive;
+
+bool CpuTrace_Start(const char *fname, const CpuTraceConfig &config);
+void CpuTrace_Stop();
+bool CpuTrace_IsRunning();
+
+//called by the cpu loop before each instruction, only while active
+template<int PROCNUM> void CpuTrace_Step(u64 cycle);
+
+//called by the core at the end of every emulated frame
+void CpuTrace_FrameEnded();
+
+#endif
@@ -22,6 +22,8 @@
 #include "debug.h"
 
 #include <algorithm>
+#include <map>
+#include <string>
 #include <stdarg.h>
 #include <stdio.h>
 #include "MMU.h"
@@ -62,43 +64,26 @@ static bool debugStatsSort(int num1, int num2) {
 	}
 }
 
+//folds the counts of opcodes which share a name into the first of them
+static void combineByName(u32 *hits, const char * const *names, int count)
+{
+	std::map<std::string,int> first;
+	for(int j=0;j<count;j++) {
+		std::pair<std::map<std::string,int>::iterator,bool> ins = first.insert(std::make_pair(std::string(names[j]),j));
+		if(ins.second)
+			continue;
+		hits[ins.first->second] += hits[j];
+		hits[j] = 0xFFFFFFFF;
+	}
+}
+
 void DebugStatistics::print()
 {
 	//consolidate opcodes with the same names
 	for(int i=0;i<2;i++) { 
 		combinedHits[i] = DEBUG_statistics.instructionHits[i];
-
-		for(int j=0;j<4096;j++) {
-			if(combinedHits[i].arm[j] == 0xFFFFFFFF) 
-				continue;
-			std::string name = arm_instruction_names[j];
-			for(int k=j+1;k<4096;k++) {
-				if(combinedHits[i].arm[k] == 0xFFFFFFFF) 
-					continue;
-				if(name == arm_instruction_names[k]) {
-					//printf("combining %s with %d and %d\n",name.c_str(),combinedHits[i].arm[j],combinedHits[i].arm[k]);
-					combinedHits[i].arm[j] += combinedHits[i].arm[k];
-					combinedHits[i].arm[k] = 0xFFFFFFFF;
-				}
-				
-			}
-		}
-
-		for(int j=0;j<1024;j++) {
-			if(combinedHits[i].thumb[j] == 0xFFFFFFFF) 
-				continue;
-			std::string name = thumb_instruction_names[j];
-			for(int k=j+1;k<1024;k++) {
-				if(combinedHits[i].thumb[k] == 0xFFFFFFFF) 
-					continue;
-				if(name == thumb_instruction_names[k]) {
-					//printf("combining %s with %d and %d\n",name.c_str(),combinedHits[i].arm[j],combinedHits[i].arm[k]);
-					combinedHits[i].thumb[j] += combinedHits[i].thumb[k];
-					combinedHits[i].thumb[k] = 0xFFFFFFFF;
-				}
-				
-			}
-		}
+		combineByName(combinedHits[i].arm, arm_instruction_names, 4096);
+		combineByName(combinedHits[i].thumb, thumb_instruction_names, 1024);
 	}
 
 	InstructionHits sorts[2];
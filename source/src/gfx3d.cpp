@@ -329,6 +329,17 @@ int _hack_getMatrixStackLevel(int which) { return mtxStack[which].position; }
 static CACHE_ALIGN float  mtxCurrent [4][16];
 static CACHE_ALIGN float  mtxTemporal[16];
 
+//the fixed point geometry engine (CommonSettings.GFX3D_FixedPointGeometry).
+//while it is enabled these are the real matrices, and mtxCurrent only holds float copies of them
+//for the renderers. the float stacks still keep the stack positions and go into the savestate
+static bool fixedGeometry = false;
+static CACHE_ALIGN s32 mtxCurrentFixed[4][16];
+static CACHE_ALIGN s32 mtxTemporalFixed[16];
+static CACHE_ALIGN s32 mtxStackFixed[4][32][16];
+//projection * position, rebuilt when either changes
+static CACHE_ALIGN s32 mtxClipFixed[16];
+static bool mtxClipFixedDirty = true;
+
 static u32 mode = 0;
 
 // Indexes for matrix loading/multiplication
@@ -347,6 +358,8 @@ static BOOL              inBegin = FALSE;
 // Data for basic transforms
 static CACHE_ALIGN float trans[4] = {0.0, 0.0, 0.0, 0.0};
 static CACHE_ALIGN float scale[4] = {0.0, 0.0, 0.0, 0.0};
+static s32               transFixed[3] = {0, 0, 0};
+static s32               scaleFixed[3] = {0, 0, 0};
 
 static int               transind = 0;
 static int               scaleind = 0;
@@ -376,6 +389,7 @@ static u32 BTind = 0;
 static u32 PTind = 0;
 static u16 BTcoords[6] = {0, 0, 0, 0, 0, 0};
 static CACHE_ALIGN float PTcoords[4] = {0.0, 0.0, 0.0, 1.0};
+static s32 PTresultFixed[4] = {0, 0, 0, 1<<12};
 
 //raw ds format poly attributes
 static u32 polyAttr=0,textureFormat=0, texturePalette=0, polyAttrPending=0;
@@ -407,6 +421,24 @@ static int texCoordinateTransform = 0;
 static CACHE_ALIGN float cacheLightDirection[4][4];
 static CACHE_ALIGN float cacheHalfVector[4][4];
 
+//the lighting unit. it works in the hardware's fixed point: directions with 9 fractional bits,
+//levels with 8, and the material x light color products precomputed per light and channel.
+//everything here follows from the light and material registers and cacheLightDirection
+static struct {
+	s32 dir[4][3];				//transformed light direction
+	s32 half[4][3];				//(dir + line of sight) / 2
+	s32 spec[4][3];				//specular * light color
+	s32 diff[4][3];				//diffuse * light color
+	s32 amb[4][3];				//ambient * light color, shifted up to the level scale
+	s32 emission[3];
+	u8 shininess[128];
+} lighting;
+
+//the squared specular term for every level, in place of pow()
+static u8 shininessSquareTable[256];
+
+static void gfx3d_glLighting_cache();
+
 //------------------
 
 #define RENDER_FRONT_SURFACE 0x80
@@ -451,6 +483,63 @@ static void makeCmdLut();
 
 static BOOL flushPending = FALSE;
 static BOOL drawPending = FALSE;
+
+//whole frame render reuse. a paused game or a static menu flushes the same scene frame after frame, and
+//rendering it again gives the same picture. the flushed lists are hashed by gfx3d_doFlush and the render
+//state is folded in right before rendering; when the result matches the frame whose render is still in
+//the converted buffers, the render is skipped. texture memory can't be written while it is mapped for
+//textures, so a counter of texture and palette remaps stands in for its contents
+static u64 flushHash = 0;
+static u64 renderedHash = 0;
+static GPU3DInterface *renderedCore = NULL;
+static u32 texMappingGeneration = 0;
+
+static FORCEINLINE u64 frameHash(u64 h, u32 w)
+{
+	h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+	return h ^ (h >> 29);
+}
+
+static FORCEINLINE u64 frameHashFloats(u64 h, const float *f, int count)
+{
+	for(int i=0;i<count;i++)
+	{
+		union { float f; u32 u; } bits;
+		bits.f = f[i];
+		h = frameHash(h, bits.u);
+	}
+	return h;
+}
+
+static FORCEINLINE u64 frameHashRegs(u64 h, u32 adr, int words)
+{
+	for(int i=0;i<words;i++)
+		h = frameHash(h, T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x40], adr + i*4));
+	return h;
+}
+
+//the converted buffers no longer hold the render of any known frame
+static void frameReuseInvalidate()
+{
+	renderedCore = NULL;
+}
+
+void gfx3d_TexMappingChanged()
+{
+	texMappingGeneration++;
+}
+
+void gfx3d_GetRenderReuse(GFX3D_RenderReuse &out)
+{
+	out.hash = renderedHash;
+	out.valid = renderedCore != NULL && renderedCore == gpu3D;
+}
+
+void gfx3d_SetRenderReuse(const GFX3D_RenderReuse &in)
+{
+	renderedHash = in.hash;
+	renderedCore = in.valid ? gpu3D : NULL;
+}
 //------------------------------------------------------------
 
 static void makeTables() {
@@ -481,6 +570,10 @@ static void makeTables() {
 	for (int i = 0; i < 1024; i++)
 		normalTable[i] = ((signed short)(i<<6)) / (float)(1<<15);
 
+	//2*level^2-1, in 8 bit fixed point, clamped at 0
+	for(int i = 0; i < 256; i++)
+		shininessSquareTable[i] = (u8)std::max(0, ((i*i)>>7) - 0x100);
+
 	//--DCN: mixtable555 isn't even used!
 	/*
 	for(int a=0;a<=31;a++)  {
@@ -553,6 +646,17 @@ void gfx3d_reset(){
 	MatrixStackInit(&mtxStack[2]);
 	MatrixStackInit(&mtxStack[3]);
 
+	fixedGeometry = CommonSettings.GFX3D_FixedPointGeometry;
+	for(int i=0;i<4;i++){
+		MatrixIdentityFixed(mtxCurrentFixed[i]);
+		for(int j=0;j<32;j++)
+			MatrixIdentityFixed(mtxStackFixed[i][j]);
+	}
+	MatrixIdentityFixed(mtxTemporalFixed);
+	mtxClipFixedDirty = true;
+	memset(transFixed, 0, sizeof(transFixed));
+	memset(scaleFixed, 0, sizeof(scaleFixed));
+
 	clCmd = 0;
 	clInd = 0;
 
@@ -572,6 +676,7 @@ void gfx3d_reset(){
 	viewport = 0xBFFF0000;
 
 	memset(gfx3d_convertedScreen,0,sizeof(gfx3d_convertedScreen));
+	frameReuseInvalidate();
 
 	gfx3d.clearDepth = gfx3d_extendDepth_15_to_24(0x7FFF);
 	
@@ -580,6 +685,8 @@ void gfx3d_reset(){
 
 	GFX_PIPEclear();
 	GFX_FIFOclear();
+
+	gfx3d_glLighting_cache();
 }
 
 
@@ -587,6 +694,36 @@ void gfx3d_reset(){
 //=================================================================================
 //=================================================================================
 
+//after a fixed point matrix changed: refresh its float copy and drop the clip matrix
+static void mtxFixedChanged(int m){
+	MatrixToFloat(mtxCurrent[m], mtxCurrentFixed[m]);
+	if(m < 2) mtxClipFixedDirty = true;
+}
+
+static const s32* mtxClipFixed_get(){
+	if(mtxClipFixedDirty){
+		MatrixCopyFixed(mtxClipFixed, mtxCurrentFixed[0]);
+		MatrixMultiplyFixed(mtxClipFixed, mtxCurrentFixed[1]);
+		mtxClipFixedDirty = false;
+	}
+	return mtxClipFixed;
+}
+
+//a 10 bit signed field as 1.9 fixed point
+static FORCEINLINE s32 normalFixed(u32 v){
+	return ((s32)(v<<22))>>22;
+}
+
+//texture coordinate generation from a vertex (shift 24) or a normal (shift 21), in 12.4 fixed point.
+//texcoords are 16 bits wide in the hardware and wrap as such
+static void gfx3d_texCoordTransformFixed(const s32 *v, int shift){
+	const s32 *m = mtxCurrentFixed[3];
+	const s32 s = (s32)(currentTexCoord.s * 16.0f);
+	const s32 t = (s32)(currentTexCoord.t * 16.0f);
+	lastTexCoord.s = (s16)(s + (s32)(((s64)v[0]*m[0] + (s64)v[1]*m[4] + (s64)v[2]*m[8]) >> shift)) / 16.0f;
+	lastTexCoord.t = (s16)(t + (s32)(((s64)v[0]*m[1] + (s64)v[1]*m[5] + (s64)v[2]*m[9]) >> shift)) / 16.0f;
+}
+
 #define vec3dot(a, b)           (((a[0]) * (b[0])) + ((a[1]) * (b[1])) + ((a[2]) * (b[2])))
 #define SUBMITVERTEX(ii, nn) polylist->list[polylist->count].vertIndexes[ii] = tempVertInfo.map[nn];
 //Submit a vertex to the GE
@@ -599,8 +736,11 @@ static void SetVertex(){
 	};
 
 	ALIGN(16) float coordTransformed[4] = { coord[0], coord[1], coord[2], 1.f };
+	s32 coordFixed[4] = { (s16)u16coord[0], (s16)u16coord[1], (s16)u16coord[2], 1<<12 };
 
-	if (texCoordinateTransform == 3){
+	if (texCoordinateTransform == 3 && fixedGeometry){
+		gfx3d_texCoordTransformFixed(coordFixed, 24);
+	}else if (texCoordinateTransform == 3){
 		lastTexCoord.s =((coord[0]*mtxCurrent[3][0] +
 							coord[1]*mtxCurrent[3][4] +
 							coord[2]*mtxCurrent[3][8]) + currentTexCoord.s * 16.0f) / 16.0f;
@@ -621,7 +761,21 @@ static void SetVertex(){
 
 	// do projection
 
-	switch(current3Dcore) {
+	if(fixedGeometry){
+		switch(current3Dcore) {
+			case 1: //GX
+				MatrixMultVec4x4Fixed(mtxCurrentFixed[1], coordFixed);
+				break;
+			case 2: // raster
+				MatrixMultVec4x4Fixed(mtxClipFixed_get(), coordFixed);
+				break;
+			default:
+				break;
+		};
+		for(int i=0;i<4;i++)
+			coordTransformed[i] = coordFixed[i] / 4096.f;
+	}
+	else switch(current3Dcore) {
 		case 1: //GX
 			MatrixMultVec4x4 (mtxCurrent[1], coordTransformed);  
 			break;
@@ -766,6 +920,58 @@ static void gfx3d_glTexImage_cache(){
 	texCoordinateTransform = (textureFormat>>30);
 }
 
+//floor to 1.9 fixed point, which is where the hardware's >>12 after the matrix multiply lands
+static FORCEINLINE s32 lightingFixed(float f){
+	const float scaled = f * 512.0f;
+	s32 v = (s32)scaled;
+	if((float)v > scaled) v--;
+	return v;
+}
+
+static void gfx3d_glLightColor_cache(int index){
+	const u32 color = lightColor[index];
+	for(int c = 0; c < 3; c++){
+		const s32 light = (color >> (c*5)) & 0x1F;
+		lighting.spec[index][c] = ((dsSpecular >> (c*5)) & 0x1F) * light;
+		lighting.diff[index][c] = ((dsDiffuse >> (c*5)) & 0x1F) * light;
+		lighting.amb[index][c] = (((dsAmbient >> (c*5)) & 0x1F) * light) << 8;
+	}
+}
+
+static void gfx3d_glMaterial_cache(){
+	for(int c = 0; c < 3; c++)
+		lighting.emission[c] = (dsEmission >> (c*5)) & 0x1F;
+	for(int i = 0; i < 4; i++)
+		gfx3d_glLightColor_cache(i);
+}
+
+static void gfx3d_glLightDirectionFixed_cache(int index){
+	if(fixedGeometry){
+		const u32 v = lightDirection[index];
+		lighting.dir[index][0] = normalFixed(v&1023);
+		lighting.dir[index][1] = normalFixed((v>>10)&1023);
+		lighting.dir[index][2] = normalFixed((v>>20)&1023);
+		MatrixMultVec3x3Fixed(mtxCurrentFixed[2], lighting.dir[index]);
+	}
+	else for(int c = 0; c < 3; c++)
+		lighting.dir[index][c] = lightingFixed(cacheLightDirection[index][c]);
+	lighting.half[index][0] = lighting.dir[index][0] >> 1;
+	lighting.half[index][1] = lighting.dir[index][1] >> 1;
+	lighting.half[index][2] = (lighting.dir[index][2] - 0x200) >> 1;
+}
+
+static void gfx3d_glShininess_cache(){
+	for(int i = 0; i < 128; i++)
+		lighting.shininess[i] = (u8)(shininessTable[i] * 256.0f);
+}
+
+static void gfx3d_glLighting_cache(){
+	gfx3d_glMaterial_cache();
+	for(int i = 0; i < 4; i++)
+		gfx3d_glLightDirectionFixed_cache(i);
+	gfx3d_glShininess_cache();
+}
+
 static void gfx3d_glLightDirection_cache(int index){
 
 	u32 v = lightDirection[index];
@@ -785,6 +991,7 @@ static void gfx3d_glLightDirection_cache(int index){
 		cacheHalfVector[index][i] = ((cacheLightDirection[index][i] + lineOfSight[i]) / 2.0f);
 	}
 
+	gfx3d_glLightDirectionFixed_cache(index);
 }
 
 //===============================================================================
@@ -811,12 +1018,17 @@ static void gfx3d_glPushMatrix(u32 pad){
 
 	//gxstat &= 0xFFFF00FF;
 
+	if(fixedGeometry)
+		MatrixCopyFixed(mtxStackFixed[mymode][mtxStack[mymode].position], mtxCurrentFixed[mymode]);
 	MatrixStackPushMatrix(&mtxStack[mymode], mtxCurrent[mymode]);
 
 	GFX_DELAY(17);
 
-	if(mymode==2)
+	if(mymode==2){
+		if(fixedGeometry)
+			MatrixCopyFixed(mtxStackFixed[1][mtxStack[1].position], mtxCurrentFixed[1]);
 		MatrixStackPushMatrix (&mtxStack[1], mtxCurrent[1]);
+	}
 
         //gxstat |= ((mtxStack[0].position << 13) | (mtxStack[1].position << 8));
 }
@@ -831,11 +1043,20 @@ static void gfx3d_glPopMatrix(u32 _i){
 	i = (i<<26)>>26;
 
 	MatrixCopy(mtxCurrent[mymode], MatrixStackPopMatrix (&mtxStack[mymode], i));
+	if(fixedGeometry){
+		MatrixCopyFixed(mtxCurrentFixed[mymode], mtxStackFixed[mymode][mtxStack[mymode].position]);
+		mtxFixedChanged(mymode);
+	}
 
 	GFX_DELAY(36);
 
-	if (mymode == 2)
-			MatrixCopy(mtxCurrent[1], MatrixStackPopMatrix (&mtxStack[1], i));
+	if (mymode == 2){
+		MatrixCopy(mtxCurrent[1], MatrixStackPopMatrix (&mtxStack[1], i));
+		if(fixedGeometry){
+			MatrixCopyFixed(mtxCurrentFixed[1], mtxStackFixed[1][mtxStack[1].position]);
+			mtxFixedChanged(1);
+		}
+	}
 
         //gxstat |= ((mtxStack[0].position << 13) | (mtxStack[1].position << 8));
 }
@@ -855,11 +1076,16 @@ static void gfx3d_glStoreMatrix(u32 v){
 	if (v > 31) return;
 
 	MatrixStackLoadMatrix (&mtxStack[mymode], v, mtxCurrent[mymode]);
+	if(fixedGeometry)
+		MatrixCopyFixed(mtxStackFixed[mymode][v], mtxCurrentFixed[mymode]);
 
 	GFX_DELAY(17);
 
-	if(mymode==2)
+	if(mymode==2){
 		MatrixStackLoadMatrix (&mtxStack[1], v, mtxCurrent[1]);
+		if(fixedGeometry)
+			MatrixCopyFixed(mtxStackFixed[1][v], mtxCurrentFixed[1]);
+	}
 
 }
 
@@ -879,28 +1105,69 @@ static void gfx3d_glRestoreMatrix(u32 v){
 
 
 	MatrixCopy (mtxCurrent[mymode], MatrixStackGetPos(&mtxStack[mymode], v));
+	if(fixedGeometry){
+		MatrixCopyFixed(mtxCurrentFixed[mymode], mtxStackFixed[mymode][v]);
+		mtxFixedChanged(mymode);
+	}
 
 	GFX_DELAY(36);
 
-	if (mymode == 2)
+	if (mymode == 2){
 		MatrixCopy (mtxCurrent[1], MatrixStackGetPos(&mtxStack[1], v));
+		if(fixedGeometry){
+			MatrixCopyFixed(mtxCurrentFixed[1], mtxStackFixed[1][v]);
+			mtxFixedChanged(1);
+		}
+	}
 
 }
 
 static void gfx3d_glLoadIdentity(u32 pad){
 	MatrixIdentity (mtxCurrent[mode]);
+	if(fixedGeometry){
+		MatrixIdentityFixed(mtxCurrentFixed[mode]);
+		mtxFixedChanged(mode);
+	}
 
 	GFX_DELAY(19);
 
-	if (mode == 2)
+	if (mode == 2){
 		MatrixIdentity (mtxCurrent[1]);
+		if(fixedGeometry){
+			MatrixIdentityFixed(mtxCurrentFixed[1]);
+			mtxFixedChanged(1);
+		}
+	}
+}
+
+//end of a matrix load in fixed point mode. pos-vector mode loads both matrices
+static void gfx3d_loadMatrixFixed(){
+	if (mode == 2){
+		MatrixCopyFixed(mtxCurrentFixed[1], mtxCurrentFixed[2]);
+		mtxFixedChanged(1);
+	}
+	mtxFixedChanged(mode);
+}
+
+//end of a matrix multiply in fixed point mode
+static void gfx3d_multMatrixFixed(){
+	MatrixMultiplyFixed(mtxCurrentFixed[mode], mtxTemporalFixed);
+	mtxFixedChanged(mode);
+
+	if (mode == 2){
+		MatrixMultiplyFixed(mtxCurrentFixed[1], mtxTemporalFixed);
+		mtxFixedChanged(1);
+		GFX_DELAY_M2(30);
+	}
+	MatrixIdentityFixed(mtxTemporalFixed);
 }
 
 static void gfx3d_glLoadMatrix4x4(u32 v){
 
 	// Zeromus says that this is garbage, and will be replaced in "Vanilla" eventually
 
-	mtxCurrent[mode][ML4x4ind] = (float)((s32)v);
+	if(fixedGeometry) mtxCurrentFixed[mode][ML4x4ind] = (s32)v;
+	else mtxCurrent[mode][ML4x4ind] = (float)((s32)v);
 
 	++ML4x4ind;
 	if(ML4x4ind<16) return;
@@ -908,6 +1175,11 @@ static void gfx3d_glLoadMatrix4x4(u32 v){
 
 	GFX_DELAY(19);
 
+	if(fixedGeometry){
+		gfx3d_loadMatrixFixed();
+		return;
+	}
+
 	if (!mode) vector_fix2float<4>(mtxCurrent[mode], (mtxCurrent[mode][15] ? mtxCurrent[mode][15] : -mtxCurrent[mode][10]));
 	else  vector_fix2float<4>(mtxCurrent[mode], 4096.f); 
 
@@ -920,13 +1192,22 @@ static void gfx3d_glLoadMatrix4x4(u32 v){
 
 static void gfx3d_glLoadMatrix4x3(u32 v){
 
-	mtxCurrent[mode][ML4x3ind] = (float)((s32)v);
+	if(fixedGeometry) mtxCurrentFixed[mode][ML4x3ind] = (s32)v;
+	else mtxCurrent[mode][ML4x3ind] = (float)((s32)v);
 
 	ML4x3ind++;
 	if((ML4x3ind & 0x03) == 3) ML4x3ind++;
 	if(ML4x3ind<16) return;
 	ML4x3ind = 0;
 
+	if(fixedGeometry){
+		mtxCurrentFixed[mode][3] = mtxCurrentFixed[mode][7] = mtxCurrentFixed[mode][11] = 0;
+		mtxCurrentFixed[mode][15] = 1<<12;
+		GFX_DELAY(30);
+		gfx3d_loadMatrixFixed();
+		return;
+	}
+
 	vector_fix2float<4>(mtxCurrent[mode], 4096.f);
 
 	//fill in the unusued matrix values
@@ -943,7 +1224,8 @@ static void gfx3d_glLoadMatrix4x3(u32 v){
 
 static void gfx3d_glMultMatrix4x4(u32 v){
 
-	mtxTemporal[MM4x4ind] = (float)((s32)v);
+	if(fixedGeometry) mtxTemporalFixed[MM4x4ind] = (s32)v;
+	else mtxTemporal[MM4x4ind] = (float)((s32)v);
 
 	MM4x4ind++;
 	if(MM4x4ind<16) return;
@@ -951,6 +1233,11 @@ static void gfx3d_glMultMatrix4x4(u32 v){
 
 	GFX_DELAY(35);
 
+	if(fixedGeometry){
+		gfx3d_multMatrixFixed();
+		return;
+	}
+
 	vector_fix2float<4>(mtxTemporal, 4096.f);
 
 	MatrixMultiply (mtxCurrent[mode], mtxTemporal);
@@ -966,7 +1253,8 @@ static void gfx3d_glMultMatrix4x4(u32 v){
 
 static void gfx3d_glMultMatrix4x3(u32 v){
 
-	mtxTemporal[MM4x3ind] = (float)((s32)v);
+	if(fixedGeometry) mtxTemporalFixed[MM4x3ind] = (s32)v;
+	else mtxTemporal[MM4x3ind] = (float)((s32)v);
 
 	MM4x3ind++;
 	if((MM4x3ind & 0x03) == 3) MM4x3ind++;
@@ -975,6 +1263,13 @@ static void gfx3d_glMultMatrix4x3(u32 v){
 
 	GFX_DELAY(31);
 
+	if(fixedGeometry){
+		mtxTemporalFixed[3] = mtxTemporalFixed[7] = mtxTemporalFixed[11] = 0;
+		mtxTemporalFixed[15] = 1<<12;
+		gfx3d_multMatrixFixed();
+		return;
+	}
+
 	vector_fix2float<4>(mtxTemporal, 4096.f);
 
 	//fill in the unusued matrix values
@@ -996,7 +1291,8 @@ static void gfx3d_glMultMatrix4x3(u32 v){
 
 static void gfx3d_glMultMatrix3x3(u32 v){
 
-	mtxTemporal[MM3x3ind] = (float)((s32)v);
+	if(fixedGeometry) mtxTemporalFixed[MM3x3ind] = (s32)v;
+	else mtxTemporal[MM3x3ind] = (float)((s32)v);
 
 	MM3x3ind++;
 	if((MM3x3ind & 0x03) == 3) MM3x3ind++;
@@ -1005,6 +1301,14 @@ static void gfx3d_glMultMatrix3x3(u32 v){
 
 	GFX_DELAY(28);
 
+	if(fixedGeometry){
+		mtxTemporalFixed[3] = mtxTemporalFixed[7] = mtxTemporalFixed[11] = 0;
+		mtxTemporalFixed[12] = mtxTemporalFixed[13] = mtxTemporalFixed[14] = 0;
+		mtxTemporalFixed[15] = 1<<12;
+		gfx3d_multMatrixFixed();
+		return;
+	}
+
 	vector_fix2float<3>(mtxTemporal, 4096.f);
 	//fill in the unusued matrix values
 	mtxTemporal[3] = mtxTemporal[7] = mtxTemporal[11] = 0;
@@ -1024,13 +1328,18 @@ static void gfx3d_glMultMatrix3x3(u32 v){
 
 static void gfx3d_glScale(u32 v){
 	scale[scaleind] = fix2float(v);
+	scaleFixed[scaleind] = (s32)v;
 
 	++scaleind;
 
 	if(scaleind<3) return;
 	scaleind = 0;
 
-	MatrixScale (mtxCurrent[(mode==2?1:mode)], scale);
+	if(fixedGeometry){
+		MatrixScaleFixed(mtxCurrentFixed[(mode==2?1:mode)], scaleFixed);
+		mtxFixedChanged(mode==2?1:mode);
+	}
+	else MatrixScale (mtxCurrent[(mode==2?1:mode)], scale);
 	//printf("scale: matrix %d to: \n",mode); MatrixPrint(mtxCurrent[1]);
 
 	GFX_DELAY(22);
@@ -1046,18 +1355,27 @@ static void gfx3d_glScale(u32 v){
 static void gfx3d_glTranslate(u32 v){
 
 	trans[transind] = fix2float(v);
+	transFixed[transind] = (s32)v;
 
 	++transind;
 
 	if(transind<3) return;
 	transind = 0;
 
-	MatrixTranslate (mtxCurrent[mode], trans);
+	if(fixedGeometry){
+		MatrixTranslateFixed(mtxCurrentFixed[mode], transFixed);
+		mtxFixedChanged(mode);
+	}
+	else MatrixTranslate (mtxCurrent[mode], trans);
 
 	GFX_DELAY(22);
 
 	if (mode == 2){
-		MatrixTranslate (mtxCurrent[1], trans);
+		if(fixedGeometry){
+			MatrixTranslateFixed(mtxCurrentFixed[1], transFixed);
+			mtxFixedChanged(1);
+		}
+		else MatrixTranslate (mtxCurrent[1], trans);
 		GFX_DELAY_M2(30);
 	}
 	//printf("translate: matrix %d to: \n",mode); MatrixPrint(mtxCurrent[1]);
@@ -1074,80 +1392,64 @@ static void gfx3d_glColor3b(u32 v){
 
 static void gfx3d_glNormal(u32 v){
 
-	ALIGN(16) float normal[4] = { normalTable[v&1023],
-									normalTable[(v>>10)&1023],
-									normalTable[(v>>20)&1023],
-									1};
+	//the normal in 1.9 fixed point, as the lighting unit takes it
+	s32 n[3];
 
-	if (texCoordinateTransform == 2){
-		lastTexCoord.s =((normal[0] *mtxCurrent[3][0] + normal[1] *mtxCurrent[3][4] +
-							normal[2] *mtxCurrent[3][8]) + (currentTexCoord.s*16.0f)) / 16.0f;
-		lastTexCoord.t =((normal[0] *mtxCurrent[3][1] + normal[1] *mtxCurrent[3][5] +
-							normal[2] *mtxCurrent[3][9]) + (currentTexCoord.t*16.0f)) / 16.0f;
-	}
+	if(fixedGeometry){
+		n[0] = normalFixed(v&1023);
+		n[1] = normalFixed((v>>10)&1023);
+		n[2] = normalFixed((v>>20)&1023);
 
-	//use the current normal transform matrix
-	MatrixMultVec3x3 (mtxCurrent[2], normal);
+		if (texCoordinateTransform == 2)
+			gfx3d_texCoordTransformFixed(n, 21);
 
-	//apply lighting model
-	{
-		u8 diffuse[3] = {
-			(dsDiffuse)&0x1F,
-			(dsDiffuse>>5)&0x1F,
-			(dsDiffuse>>10)&0x1F };
-
-		u8 ambient[3] = {
-			(dsAmbient)&0x1F,
-			(dsAmbient>>5)&0x1F,
-			(dsAmbient>>10)&0x1F };
-
-		u8 emission[3] = {
-			(dsEmission)&0x1F,
-			(dsEmission>>5)&0x1F,
-			(dsEmission>>10)&0x1F };
+		MatrixMultVec3x3Fixed(mtxCurrentFixed[2], n);
+	}else{
+		ALIGN(16) float normal[4] = { normalTable[v&1023],
+										normalTable[(v>>10)&1023],
+										normalTable[(v>>20)&1023],
+										1};
+
+		if (texCoordinateTransform == 2){
+			lastTexCoord.s =((normal[0] *mtxCurrent[3][0] + normal[1] *mtxCurrent[3][4] +
+								normal[2] *mtxCurrent[3][8]) + (currentTexCoord.s*16.0f)) / 16.0f;
+			lastTexCoord.t =((normal[0] *mtxCurrent[3][1] + normal[1] *mtxCurrent[3][5] +
+								normal[2] *mtxCurrent[3][9]) + (currentTexCoord.t*16.0f)) / 16.0f;
+		}
 
-		u8 specular[3] = {
-			(dsSpecular)&0x1F,
-			(dsSpecular>>5)&0x1F,
-			(dsSpecular>>10)&0x1F };
+		//use the current normal transform matrix
+		MatrixMultVec3x3 (mtxCurrent[2], normal);
 
-		int vertexColor[3] = { emission[0], emission[1], emission[2] };
+		for(int c=0;c<3;c++)
+			n[c] = lightingFixed(normal[c]);
+	}
 
-		int shininessTable_size = (int)ARRAY_SIZE(shininessTable);
+	//apply lighting model
+	/* This formula is the one used by the DS */
+	/* Reference : http://nocash.emubase.de/gbatek.htm#ds3dpolygonlightparameters */
+	{
+		s32 vertexColor[3] = { lighting.emission[0], lighting.emission[1], lighting.emission[2] };
 
 		for(int i=0; i<4; i++){
 			if(!((lightMask>>i)&1)) continue;
 
-			u8 _lightColor[3] = {
-				(lightColor[i])&0x1F,
-				(lightColor[i]>>5)&0x1F,
-				(lightColor[i]>>10)&0x1F };
-
-			/* This formula is the one used by the DS */
-			/* Reference : http://nocash.emubase.de/gbatek.htm#ds3dpolygonlightparameters */
-			float diffuseLevel = std::max(0.0f, -vec3dot(cacheLightDirection[i], normal));
-			float shininessLevel = pow(std::max(0.0f, vec3dot(-cacheHalfVector[i], normal)), 2);
-			if(dsSpecular & 0x8000){
-				int shininessIndex = (int)(shininessLevel * 128);
-				if(shininessIndex >= shininessTable_size) {
-					//we can't print this right now, because when a game triggers this it triggers it _A_LOT_
-					//so wait until we have per-frame diagnostics.
-					//this was tested using Princess Debut (US) after proceeding through the intro and getting the tiara.
-					//After much research, I determined that this was caused by the game feeding in a totally jacked matrix
-					//to mult4x4 from 0x02129B80 (after feeding two other valid matrices)
-					//the game seems to internally index these as: ?, 0x37, 0x2B <-- error
-					//but, man... this is seriously messed up. there must be something going wrong.
-					//maybe it has something to do with what looks like a mirror room effect that is going on during this time?
-					//PROGINFO("ERROR: shininess table out of bounds.\n  maybe an emulator error; maybe a non-unit normal; setting to 0\n");
-					shininessIndex = 0;
-				}
-				shininessLevel = shininessTable[shininessIndex];
-			}
+			const s32 *dir = lighting.dir[i];
+			const s32 *half = lighting.half[i];
+
+			s32 diffuseLevel = -(dir[0]*n[0] + dir[1]*n[1] + dir[2]*n[2]) >> 10;
+			diffuseLevel = std::min(255, std::max(0, diffuseLevel));
+
+			s32 shininessLevel = -(half[0]*n[0] + half[1]*n[1] + half[2]*n[2]) >> 10;
+			if(shininessLevel < 0) shininessLevel = 0;
+			else if(shininessLevel > 255) shininessLevel = (0x100 - shininessLevel) & 0xFF;
+			shininessLevel = shininessSquareTable[shininessLevel];
+			if(dsSpecular & 0x8000)
+				shininessLevel = lighting.shininess[shininessLevel >> 1];
 
 			for(int c = 0; c < 3; c++){
-				vertexColor[c] += (int)(((specular[c] * _lightColor[c] * shininessLevel)
-								+ (diffuse[c] * _lightColor[c] * diffuseLevel)
-								+ (ambient[c] * _lightColor[c])) / 31.0f);
+				vertexColor[c] += (lighting.spec[i][c] * shininessLevel
+								+ lighting.diff[i][c] * diffuseLevel
+								+ lighting.amb[i][c]) >> 13;
 			}
 		}
 
@@ -1169,7 +1471,13 @@ static void gfx3d_glTexCoord(u32 val){
 	currentTexCoord.s /= 16.0f;
 	currentTexCoord.t /= 16.0f;
 
-	if (texCoordinateTransform == 1){
+	if (texCoordinateTransform == 1 && fixedGeometry){
+		const s32 *m = mtxCurrentFixed[3];
+		const s64 s = (s16)(val&0xFFFF);
+		const s64 t = (s16)(val>>16);
+		lastTexCoord.s = (s16)((s*m[0] + t*m[4] + m[8] + m[12]) >> 12) / 16.0f;
+		lastTexCoord.t = (s16)((s*m[1] + t*m[5] + m[9] + m[13]) >> 12) / 16.0f;
+	}else if (texCoordinateTransform == 1){
 
 		lastTexCoord.s =currentTexCoord.s*mtxCurrent[3][0] + 
 				currentTexCoord.t*mtxCurrent[3][4] +
@@ -1279,6 +1587,7 @@ static void gfx3d_glTexPalette(u32 val){
 static void gfx3d_glMaterial0(u32 val){
 	dsDiffuse = val&0xFFFF;
 	dsAmbient = val>>16;
+	gfx3d_glMaterial_cache();
 
 	if (BIT15(val)){
 		colorRGB[0] = (val)&0x1F;
@@ -1291,6 +1600,7 @@ static void gfx3d_glMaterial0(u32 val){
 static void gfx3d_glMaterial1(u32 val){
         dsSpecular = val&0xFFFF;
         dsEmission = val>>16;
+        gfx3d_glMaterial_cache();
         GFX_DELAY(4);
 }
 
@@ -1311,10 +1621,15 @@ static void gfx3d_glLightDirection (u32 v){
 static void gfx3d_glLightColor (u32 v){
 	int index = v>>30;
 	lightColor[index] = v;
+	gfx3d_glLightColor_cache(index);
 	GFX_DELAY(1);
 }
 
 static void gfx3d_glShininess (u32 val){
+	lighting.shininess[shininessInd] = val & 0xFF;
+	lighting.shininess[shininessInd+1] = (val >> 8) & 0xFF;
+	lighting.shininess[shininessInd+2] = (val >> 16) & 0xFF;
+	lighting.shininess[shininessInd+3] = (val >> 24) & 0xFF;
 	shininessTable[shininessInd++] = ((val & 0xFF) / 256.0f);
 	shininessTable[shininessInd++] = (((val >> 8) & 0xFF) / 256.0f);
 	shininessTable[shininessInd++] = (((val >> 16) & 0xFF) / 256.0f);
@@ -1434,7 +1749,16 @@ static void gfx3d_glBoxTest(u32 v){
 	////---------------------
 
 	//transform all coords
-	for(int i=0;i<8;i++) {
+	if(fixedGeometry){
+		//the corners are exact in float, so the raw values can be taken back out of them
+		const s32 *clip = mtxClipFixed_get();
+		for(int i=0;i<8;i++) {
+			s32 c[4] = { (s32)(verts[i].coord[0]*4096.f), (s32)(verts[i].coord[1]*4096.f), (s32)(verts[i].coord[2]*4096.f), 1<<12 };
+			MatrixMultVec4x4Fixed(clip, c);
+			verts[i].set_coord(c[0]/4096.f, c[1]/4096.f, c[2]/4096.f, c[3]/4096.f);
+		}
+	}
+	else for(int i=0;i<8;i++) {
 		//MatrixMultVec4x4_M2(mtxCurrent[0], verts[i].coord);
 
 		MatrixMultVec4x4(mtxCurrent[1],verts[i].coord);
@@ -1484,8 +1808,18 @@ static void gfx3d_glPosTest(u32 v){
 	
 	PTcoords[3] = 1.0f;
 	
-	MatrixMultVec4x4(mtxCurrent[1], PTcoords);
-	MatrixMultVec4x4(mtxCurrent[0], PTcoords);
+	if(fixedGeometry){
+		PTresultFixed[0] = (s32)(PTcoords[0]*4096.f);
+		PTresultFixed[1] = (s32)(PTcoords[1]*4096.f);
+		PTresultFixed[2] = (s32)(PTcoords[2]*4096.f);
+		PTresultFixed[3] = 1<<12;
+		MatrixMultVec4x4Fixed(mtxClipFixed_get(), PTresultFixed);
+		for(int i=0;i<4;i++)
+			PTcoords[i] = PTresultFixed[i] / 4096.f;
+	}else{
+		MatrixMultVec4x4(mtxCurrent[1], PTcoords);
+		MatrixMultVec4x4(mtxCurrent[0], PTcoords);
+	}
 
 	MMU_new.gxstat.tb = 0;
 
@@ -1499,15 +1833,25 @@ static void gfx3d_glVecTest(u32 v){
 
 	printf("VECTEST\n");
 	
-	CACHE_ALIGN float normal[4] = { normalTable[v&1023],
-									normalTable[(v>>10)&1023],
-									normalTable[(v>>20)&1023],
-									1};
-	MatrixMultVec4x4(mtxCurrent[2], normal);
-	
-	s16 x = (s16)(normal[0]);
-	s16 y = (s16)(normal[1]);
-	s16 z = (s16)(normal[2]);
+	s16 x, y, z;
+	if(fixedGeometry){
+		//1.9 in, 4.12 out, with the result sign extended from 13 bits
+		s32 n[3] = { normalFixed(v&1023)<<3, normalFixed((v>>10)&1023)<<3, normalFixed((v>>20)&1023)<<3 };
+		MatrixMultVec3x3Fixed(mtxCurrentFixed[2], n);
+		x = (s16)(((s32)((u32)n[0]<<19))>>19);
+		y = (s16)(((s32)((u32)n[1]<<19))>>19);
+		z = (s16)(((s32)((u32)n[2]<<19))>>19);
+	}else{
+		CACHE_ALIGN float normal[4] = { normalTable[v&1023],
+										normalTable[(v>>10)&1023],
+										normalTable[(v>>20)&1023],
+										1};
+		MatrixMultVec4x4(mtxCurrent[2], normal);
+		
+		x = (s16)(normal[0]);
+		y = (s16)(normal[1]);
+		z = (s16)(normal[2]);
+	}
 
 	MMU_new.gxstat.tb = 0;          // clear busy
 	T1WriteWord(MMU.MMU_MEM[0][0x40], 0x630, x);
@@ -1592,6 +1936,8 @@ void gfx3d_glAlphaFunc(u32 v){
 }
 
 unsigned int gfx3d_glGetPosRes(u32 index){
+	if(fixedGeometry)
+		return (unsigned int)PTresultFixed[index];
 	return (unsigned int)(PTcoords[index] * 4096.0f);
 }
 
@@ -1855,6 +2201,18 @@ static void gfx3d_doFlush()
 
         int polycount = polylist->count;
 
+        u64 hash = frameHash(0, control);
+        hash = frameHash(hash, (gfx3d.wbuffer ? 1 : 0) | (gfx3d.sortmode ? 2 : 0));
+        hash = frameHash(hash, polycount);
+        hash = frameHash(hash, vertlist->count);
+        for(int i=0; i<vertlist->count; i++)
+        {
+                const VERT &vert = vertlist->list[i];
+                hash = frameHashFloats(hash, vert.coord, 4);
+                hash = frameHashFloats(hash, vert.texcoord, 2);
+                hash = frameHash(hash, vert.color[0] | (vert.color[1]<<8) | (vert.color[2]<<16));
+        }
+
         //find the min and max y values for each poly.
         //TODO - this could be a small waste of time if we are manual sorting the translucent polys
         //TODO - this _MUST_ be moved later in the pipeline, after clipping.
@@ -1863,6 +2221,16 @@ static void gfx3d_doFlush()
         for(int i=0; i<polycount; i++)
         {
                 POLY &poly = polylist->list[i];
+                hash = frameHash(hash, poly.type);
+                hash = frameHash(hash, poly.vertIndexes[0] | (poly.vertIndexes[1]<<16));
+                hash = frameHash(hash, poly.vertIndexes[2] | (poly.vertIndexes[3]<<16));
+                hash = frameHash(hash, poly.polyAttr);
+                hash = frameHash(hash, poly.texParam);
+                hash = frameHash(hash, poly.texPalette);
+                hash = frameHash(hash, poly.viewport);
+                //the gx renderer draws with the projection
+                hash = frameHashFloats(hash, poly.projMatrix, 16);
+
                 float verty = vertlist->list[poly.vertIndexes[0]].y;
                 float vertw = vertlist->list[poly.vertIndexes[0]].w;
                 verty = (verty+vertw)/(2*vertw);
@@ -1906,6 +2274,8 @@ static void gfx3d_doFlush()
                 std::sort(gfx3d.indexlist + opaqueCount, gfx3d.indexlist + polycount, gfx3d_ysort_compare);
         }
 
+        flushHash = hash;
+
         //switch to the new lists
         twiddleLists();
 
@@ -1935,10 +2305,31 @@ void gfx3d_VBlankEndSignal(bool skipFrame)
         if(gpu3D == &gpu3DNull || !CommonSettings.showGpu.main)
         {
                 memset(gfx3d_convertedScreen,0,sizeof(gfx3d_convertedScreen));
+                frameReuseInvalidate();
                 return;
         }
 
+        //the state the renderers read when they run rather than when the lists are flushed
+        u64 hash = frameHash(flushHash, texMappingGeneration);
+        hash = frameHash(hash, gfx3d.alphaTestRef);
+        hash = frameHash(hash, gfx3d.clearColor);
+        hash = frameHash(hash, gfx3d.clearDepth);
+        hash = frameHash(hash, gfx3d.fogColor);
+        hash = frameHash(hash, gfx3d.fogOffset);
+        for(int i=0;i<32;i+=2)
+                hash = frameHash(hash, gfx3d.u16ToonTable[i] | (gfx3d.u16ToonTable[i+1]<<16));
+        hash = frameHashRegs(hash, 0x330, 4); //EDGE_COLOR
+        hash = frameHashRegs(hash, 0x354, 1); //CLEAR_DEPTH, CLRIMAGE_OFFSET
+        hash = frameHashRegs(hash, 0x360, 8); //FOG_TABLE
+        hash = frameHash(hash, (CommonSettings.GFX3D_EdgeMark ? 1 : 0) | (CommonSettings.GFX3D_Fog ? 2 : 0));
+
+        if(gpu3D == renderedCore && hash == renderedHash)
+                return;
+
         gpu3D->NDS_3D_Render();
+
+        renderedCore = gpu3D;
+        renderedHash = hash;
 }
 
 //#define _3D_LOG
@@ -2166,7 +2557,7 @@ SFORMAT SF_GFX3D[]={
 void gfx3d_savestate(EMUFILE* os)
 {
 	//version
-	write32le(4,os);
+	write32le(5,os);
 
 	//dump the render lists
 	OSWRITE(vertlist->count);
@@ -2188,6 +2579,10 @@ void gfx3d_savestate(EMUFILE* os)
 	// evidently these need to be saved because we don't cache the matrix that would need to be used to properly regenerate them
 	OSWRITE(cacheLightDirection);
 	OSWRITE(cacheHalfVector);
+
+	//the same goes for the lighting unit's directions, transformed by the vector matrix of the time LIGHT_VECTOR was written
+	writeArrayLE(&lighting.dir[0][0], 4*3, os);
+	writeArrayLE(&lighting.half[0][0], 4*3, os);
 }
 
 bool gfx3d_loadstate(EMUFILE* is, int size)
@@ -2224,8 +2619,17 @@ bool gfx3d_loadstate(EMUFILE* is, int size)
 			for(int j=0;j<mtxStack[i].size*16;j++)
 				OSREAD(mtxStack[i].matrix[j]);
 		}
+
+		if(fixedGeometry)
+			for(int i=0;i<4;i++)
+				for(int j=0;j<mtxStack[i].size;j++)
+					MatrixFromFloat(mtxStackFixed[i][j], MatrixStackGetPos(&mtxStack[i], j));
 	}
 
+	//the position test result only went into the savestate as floats
+	for(int i=0;i<4;i++)
+		PTresultFixed[i] = (s32)floorf(PTcoords[i] * 4096.0f + 0.5f);
+
 	if(version>=3) {
 			gxf_hardware.loadstate(is);
 	}
@@ -2240,6 +2644,28 @@ bool gfx3d_loadstate(EMUFILE* is, int size)
 			OSREAD(cacheHalfVector);
 	}
 
+	//the current and temporal matrices only went into the savestate (SF_GFX3D, read before this chunk) as floats
+	if(fixedGeometry)
+	{
+		for(int i=0;i<4;i++)
+			MatrixFromFloat(mtxCurrentFixed[i], mtxCurrent[i]);
+		MatrixFromFloat(mtxTemporalFixed, mtxTemporal);
+		mtxClipFixedDirty = true;
+	}
+
+	gfx3d_glMaterial_cache();
+	gfx3d_glShininess_cache();
+	if(version >= 5){
+		//the light directions can't be transformed again here, the vector matrix has moved on since
+		if(readArrayLE(&lighting.dir[0][0], 4*3, is) != 1) return false;
+		if(readArrayLE(&lighting.half[0][0], 4*3, is) != 1) return false;
+	}
+	else for(int i=0;i<4;i++)
+		gfx3d_glLightDirectionFixed_cache(i);
+
+	//the converted buffers came from the state
+	frameReuseInvalidate();
+
 	return true;
 }
 
@@ -2310,154 +2736,109 @@ static FORCEINLINE VERT clipPoint(VERT* inside, VERT* outside, int coord, int wh
 
 #ifdef OPTIMIZED_CLIPPING_METHOD
 
-#define MAX_SCRATCH_CLIP_VERTS (4*6 + 40)
-static VERT scratchClipVerts [MAX_SCRATCH_CLIP_VERTS];
-static int numScratchClipVerts = 0;
-
-template <int coord, int which, class Next>
-class ClipperPlane
+//one Sutherland-Hodgman pass. the poly is passed around as vert pointers so that
+//only the verts created at the plane are actually built
+template<int coord, int which>
+int GFX3D_Clipper::clipVsPlane(VERT** in, int count, VERT** out)
 {
-public:
-	ClipperPlane(Next& next) : m_next(next) {}
-
-	void init(VERT* verts)
-	{
-		m_prevVert =  NULL;
-		m_firstVert = NULL;
-		m_next.init(verts);
-	}
+	int outCount = 0;
+	VERT* vert0 = in[count-1];
+	bool out0 = (which==-1) ? (vert0->coord[coord] < -vert0->coord[3]) : (vert0->coord[coord] > vert0->coord[3]);
 
-	void clipVert(VERT* vert)
+	for(int i=0;i<count;i++)
 	{
-		if(m_prevVert)
-			this->clipSegmentVsPlane(m_prevVert, vert);
-		else
-			m_firstVert = vert;
-		m_prevVert = vert;
-	}
+		VERT* vert1 = in[i];
+		const bool out1 = (which==-1) ? (vert1->coord[coord] < -vert1->coord[3]) : (vert1->coord[coord] > vert1->coord[3]);
 
-	// closes the loop and returns the number of clipped output verts
-	int finish()
-	{
-		this->clipVert(m_firstVert);
-		return m_next.finish();
-	}
+		//CONSIDER: should we try and clip things behind the eye? does this code even successfully do it? not sure.
 
-private:
-
-	VERT* m_prevVert;
-	VERT* m_firstVert;
-	Next& m_next;
-
-	FORCEINLINE void clipSegmentVsPlane(VERT* vert0, VERT* vert1)
-	{
-			float* vert0coord = vert0->coord;
-			float* vert1coord = vert1->coord;
-			bool out0, out1;
-			if(which==-1)
-				out0 = vert0coord[coord] < -vert0coord[3];
-			else
-				out0 = vert0coord[coord] > vert0coord[3];
-			if(which==-1)
-				out1 = vert1coord[coord] < -vert1coord[3];
-			else
-				out1 = vert1coord[coord] > vert1coord[3];
-
-			//CONSIDER: should we try and clip things behind the eye? does this code even successfully do it? not sure.
-			//if(coord==2 && which==1) {
-			//      out0 = vert0coord[2] < 0;
-			//      out1 = vert1coord[2] < 0;
-			//}
-
-			//both outside: insert no points
-//                 if(out0 && out1) {
-//                         CLIPLOG(" both outside\n");
-//                 }
-
-			//both inside: insert the next point
-			if(!out0 && !out1)
-			{
-				//CLIPLOG(" both inside\n");
-				m_next.clipVert(vert1);
-			}
+		//exiting volume: insert the clipped point
+		//entering volume: insert clipped point and the next (interior) point
+		if(out0 != out1)
+		{
+			assert((u32)numScratchClipVerts < MAX_SCRATCH_CLIP_VERTS);
+			VERT* clipped = &scratchClipVerts[numScratchClipVerts++];
+			*clipped = out1 ? clipPoint<coord, which>(vert0,vert1) : clipPoint<coord, which>(vert1,vert0);
+			out[outCount++] = clipped;
+		}
 
-			//exiting volume: insert the clipped point
-			if(!out0 && out1)
-			{
-				//CLIPLOG(" exiting\n");
-				assert((u32)numScratchClipVerts < MAX_SCRATCH_CLIP_VERTS);
-				scratchClipVerts[numScratchClipVerts] = clipPoint<coord, which>(vert0,vert1);
-				m_next.clipVert(&scratchClipVerts[numScratchClipVerts++]);
-			}
+		//both inside, or entering: insert the next point
+		if(!out1)
+			out[outCount++] = vert1;
 
-			//entering volume: insert clipped point and the next (interior) point
-			if(out0 && !out1) {
-				//CLIPLOG(" entering\n");
-				assert((u32)numScratchClipVerts < MAX_SCRATCH_CLIP_VERTS);
-				scratchClipVerts[numScratchClipVerts] = clipPoint<coord, which>(vert1,vert0);
-				m_next.clipVert(&scratchClipVerts[numScratchClipVerts++]);
-				m_next.clipVert(vert1);
-			}
+		vert0 = vert1;
+		out0 = out1;
 	}
-};
 
-class ClipperOutput
+	return outCount;
+}
+
+void GFX3D_Clipper::clipPoly(POLY* poly, VERT** verts)
 {
-public:
-	void init(VERT* verts)
-	{
-		m_nextDestVert = verts;
-		m_numVerts = 0;
-	}
-	void clipVert(VERT* vert)
-	{
-		assert((u32)m_numVerts < MAX_CLIPPED_VERTS);
-		*m_nextDestVert++ = *vert;
-		m_numVerts++;
-	}
-	int finish()
+	//CLIPLOG("==Begin poly==\n");
+
+	const int type = poly->type;
+	u8 codeAnd = 0x3F, codeOr = 0;
+	for(int i=0;i<type;i++)
 	{
-		return m_numVerts;
+		const u8 code = outcode(verts[i]);
+		codeAnd &= code;
+		codeOr |= code;
 	}
-private:
-	VERT* m_nextDestVert;
-	int m_numVerts;
-};
 
-// see "Template juggling with Sutherland-Hodgman" http://www.codeguru.com/cpp/misc/misc/graphics/article.php/c8965__2/
-// for the idea behind setting things up like this.
-static ClipperOutput clipperOut;
-typedef ClipperPlane<2, 1,ClipperOutput> Stage6; static Stage6 clipper6 (clipperOut); // back plane //TODO - we need to parameterize back plane clipping
-typedef ClipperPlane<2,-1,Stage6> Stage5;        static Stage5 clipper5 (clipper6); // front plane
-typedef ClipperPlane<1, 1,Stage5> Stage4;        static Stage4 clipper4 (clipper5); // top plane
-typedef ClipperPlane<1,-1,Stage4> Stage3;        static Stage3 clipper3 (clipper4); // bottom plane
-typedef ClipperPlane<0, 1,Stage3> Stage2;        static Stage2 clipper2 (clipper3); // right plane
-typedef ClipperPlane<0,-1,Stage2> Stage1;        static Stage1 clipper  (clipper2); // left plane
+	//every vert is outside of the same plane: nothing can be visible
+	if(codeAnd)
+		return;
 
-void GFX3D_Clipper::clipPoly(POLY* poly, VERT** verts)
-{
-	//CLIPLOG("==Begin poly==\n");
+	TClippedPoly &outPoly = clippedPolys[clippedPolyCounter];
 
-	int type = poly->type;
-	numScratchClipVerts = 0;
+	//entirely inside, which is the common case: no clipping needed
+	if(!codeOr)
+	{
+		for(int i=0;i<type;i++)
+			outPoly.clipVerts[i] = *verts[i];
+		outPoly.type = type;
+		outPoly.poly = poly;
+		clippedPolyCounter++;
+		return;
+	}
 
-	clipper.init(clippedPolys[clippedPolyCounter].clipVerts);
+	//run only the planes which are actually crossed
+	VERT* bufA[MAX_SCRATCH_CLIP_VERTS];
+	VERT* bufB[MAX_SCRATCH_CLIP_VERTS];
+	VERT** in = bufA;
+	VERT** out = bufB;
+	int count = type;
 	for(int i=0;i<type;i++)
-			clipper.clipVert(verts[i]);
-	int outType = clipper.finish();
+		in[i] = verts[i];
+	numScratchClipVerts = 0;
 
-	assert((u32)outType < MAX_CLIPPED_VERTS);
-	if(outType < 3)
+#define CLIP_STAGE(PLANE,COORD,WHICH) \
+	if(count && (codeOr & PLANE)) { \
+		count = clipVsPlane<COORD,WHICH>(in,count,out); \
+		VERT** swap = in; in = out; out = swap; \
+	}
+	CLIP_STAGE(CLIP_LEFT,0,-1);
+	CLIP_STAGE(CLIP_RIGHT,0,1);
+	CLIP_STAGE(CLIP_BOTTOM,1,-1);
+	CLIP_STAGE(CLIP_TOP,1,1);
+	CLIP_STAGE(CLIP_FRONT,2,-1);
+	CLIP_STAGE(CLIP_BACK,2,1); //TODO - we need to parameterize back plane clipping
+#undef CLIP_STAGE
+
+	assert((u32)count <= MAX_CLIPPED_VERTS);
+	if(count < 3 || count > MAX_CLIPPED_VERTS)
 	{
 		//a totally clipped poly. discard it.
 		//or, a degenerate poly. we're not handling these right now
+		return;
 	}
-	else
-	{
-		clippedPolys[clippedPolyCounter].type = outType;
-		clippedPolys[clippedPolyCounter].poly = poly;
-		clippedPolyCounter++;
-	}
+
+	for(int i=0;i<count;i++)
+		outPoly.clipVerts[i] = *in[i];
+	outPoly.type = count;
+	outPoly.poly = poly;
+	clippedPolyCounter++;
 }
 
 void GFX3D_Clipper::clipSegmentVsPlane(VERT** verts, const int coord, int which)
@@ -270,6 +270,19 @@ struct VIEWPORT {
 //four corners of the hexagon, and you will observe a decagon
 #define MAX_CLIPPED_VERTS 10
 
+//the planes of the view volume as outcode bits, in the order they are clipped against
+enum CLIP_PLANE
+{
+	CLIP_LEFT = 0x01, CLIP_RIGHT = 0x02,
+	CLIP_BOTTOM = 0x04, CLIP_TOP = 0x08,
+	CLIP_FRONT = 0x10, CLIP_BACK = 0x20
+};
+
+//enough for a quad crossing all six planes; non-convex polys can produce a few more per plane
+#define MAX_SCRATCH_CLIP_VERTS (4*6 + 40)
+
+//all working state is per instance, so several clippers may run on different
+//polygon ranges at the same time
 class GFX3D_Clipper
 {
 public:
@@ -283,6 +296,15 @@ public:
 	
 	//the entry point for poly clipping
 	void clipPoly(POLY* poly, VERT** verts);
+
+	//6 bit CLIP_PLANE mask of the planes a vert lies outside of
+	static FORCEINLINE u8 outcode(const VERT* vert)
+	{
+		const float w = vert->coord[3];
+		return (vert->coord[0] < -w ? CLIP_LEFT : 0) | (vert->coord[0] > w ? CLIP_RIGHT : 0)
+			| (vert->coord[1] < -w ? CLIP_BOTTOM : 0) | (vert->coord[1] > w ? CLIP_TOP : 0)
+			| (vert->coord[2] < -w ? CLIP_FRONT : 0) | (vert->coord[2] > w ? CLIP_BACK : 0);
+	}
 	
 	//the output of clipping operations goes into here.
 	//be sure you init it before clipping!
@@ -291,6 +313,12 @@ public:
 	void reset() { clippedPolyCounter=0; }
 
 private:
+	//verts created at the crossed planes while clipping the current poly
+	VERT scratchClipVerts[MAX_SCRATCH_CLIP_VERTS];
+	int numScratchClipVerts;
+
+	template<int coord, int which> int clipVsPlane(VERT** in, int count, VERT** out);
+
 	TClippedPoly tempClippedPoly;
 	TClippedPoly outClippedPoly;
 	FORCEINLINE void clipSegmentVsPlane(VERT** verts, const int coord, int which);
@@ -404,6 +432,19 @@ u32 gfx3d_glGetPosRes(u32 index);
 u16 gfx3d_glGetVecRes(u32 index);
 void gfx3d_VBlankSignal();
 void gfx3d_VBlankEndSignal(bool skipFrame);
+//called when the vram mapped for textures or texture palettes changes
+void gfx3d_TexMappingChanged();
+
+//which frame's render the converted buffers hold, for whole frame render reuse.
+//loading a state forgets it, since the buffers come from the state. run-ahead restores its own snapshot
+//from this same session every frame, so it takes this beforehand and hands it back afterwards
+struct GFX3D_RenderReuse
+{
+	u64 hash;
+	bool valid;
+};
+void gfx3d_GetRenderReuse(GFX3D_RenderReuse &out);
+void gfx3d_SetRenderReuse(const GFX3D_RenderReuse &in);
 void gfx3d_Control(u32 v);
 void gfx3d_execute3D();
 void gfx3d_sendCommandToFIFO(u32 val);
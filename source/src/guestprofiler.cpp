@@ -0,0 +1,330 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "types.h"
+#include "armcpu.h"
+#include "MMU.h"
+#include "Disassembler.h"
+#include "guestprofiler.h"
+
+#define PROF_LOG_DIR "sd:/profiler"
+#define PROF_LOG_FILE "sd:/profiler/guest.log"
+
+#define PROF_TABLE_SIZE 4096
+#define PROF_TABLE_MASK (PROF_TABLE_SIZE-1)
+#define PROF_MAX_PROBE 32
+#define PROF_STACK_DEPTH 64
+#define PROF_STACK_MASK (PROF_STACK_DEPTH-1)
+//how far down the shadow stack a return is looked for, to get past frames left by longjmp-like code
+#define PROF_RETURN_SEARCH 8
+#define PROF_MAX_DUMP 32
+
+bool guestProfilerActive = false;
+
+//open addressed histogram. a slot is in use when its count is non-zero
+struct ProfHistogram
+{
+	u64 keys[PROF_TABLE_SIZE];
+	u32 counts[PROF_TABLE_SIZE];
+	u32 dropped;
+
+	void clear()
+	{
+		memset(counts, 0, sizeof(counts));
+		dropped = 0;
+	}
+
+	void add(u64 key, u32 amount = 1)
+	{
+		u32 h = (u32)(key ^ (key >> 32)) * 0x9E3779B1;
+		h = (h >> 20) & PROF_TABLE_MASK;
+		for(int i=0;i<PROF_MAX_PROBE;i++)
+		{
+			if(!counts[h])
+			{
+				keys[h] = key;
+				counts[h] = amount;
+				return;
+			}
+			if(keys[h] == key)
+			{
+				counts[h] += amount;
+				return;
+			}
+			h = (h+1) & PROF_TABLE_MASK;
+		}
+		dropped += amount;
+	}
+};
+
+struct ProfFrame
+{
+	u32 func;
+	u32 ret;
+};
+
+struct ProfCpu
+{
+	ProfHistogram pcs;
+	ProfHistogram funcs;
+	ProfHistogram edges;
+	ProfFrame stack[PROF_STACK_DEPTH];
+	u32 top, depth;
+	s32 countdown;
+	u32 samples;
+
+	u32 currentFunc() const { return depth ? stack[(top-1) & PROF_STACK_MASK].func : 0; }
+};
+
+static ProfCpu *profCpu = NULL;
+static u32 sampleInterval = 0;
+
+//--------------------------------------------------------------------------------
+
+//addresses carry the thumb state in bit 0, as in the BX convention
+static FORCEINLINE bool isCall(u32 instruction, bool thumb)
+{
+	if(thumb)
+	{
+		return (instruction & 0xF800) == 0xF800 //BL, second half
+			|| (instruction & 0xF800) == 0xE800 //BLX, second half
+			|| (instruction & 0xFF80) == 0x4780; //BLX Rm
+	}
+	return ((instruction & 0x0F000000) == 0x0B000000 && (instruction >> 28) != 0xF) //BL
+		|| (instruction & 0xFE000000) == 0xFA000000 //BLX imm
+		|| (instruction & 0x0FFFFFF0) == 0x012FFF30; //BLX Rm
+}
+
+template<int PROCNUM>
+void GuestProfiler_Step(u32 adr, u32 instruction, bool thumb, u32 cycles)
+{
+	ProfCpu &cpu = profCpu[PROCNUM];
+	const armcpu_t &arm = PROCNUM ? NDS_ARM7 : NDS_ARM9;
+	const u32 size = thumb ? 2 : 4;
+	const u32 newpc = arm.instruct_adr | arm.CPSR.bits.T;
+
+	//only control flow is interesting for the call tracking
+	if((newpc & ~1) != adr + size)
+	{
+		if(isCall(instruction, thumb))
+		{
+			cpu.edges.add(((u64)cpu.currentFunc() << 32) | newpc);
+			ProfFrame &frame = cpu.stack[cpu.top & PROF_STACK_MASK];
+			frame.func = newpc;
+			frame.ret = adr + size;
+			cpu.top++;
+			if(cpu.depth < PROF_STACK_DEPTH) cpu.depth++;
+		}
+		else
+		{
+			//anything that lands on a pending return address counts as a return, which covers
+			//BX LR, POP {PC}, LDMFD ..,{PC} and MOV PC,LR alike
+			const u32 limit = std::min<u32>(cpu.depth, PROF_RETURN_SEARCH);
+			for(u32 i=0;i<limit;i++)
+			{
+				if(cpu.stack[(cpu.top-1-i) & PROF_STACK_MASK].ret == (newpc & ~1))
+				{
+					cpu.top -= i+1;
+					cpu.depth -= i+1;
+					break;
+				}
+			}
+		}
+	}
+
+	cpu.countdown -= (s32)cycles;
+	if(cpu.countdown > 0) return;
+	cpu.countdown += (s32)sampleInterval;
+
+	cpu.samples++;
+	cpu.pcs.add(adr | (thumb ? 1 : 0));
+	cpu.funcs.add(cpu.currentFunc());
+}
+
+template void GuestProfiler_Step<0>(u32 adr, u32 instruction, bool thumb, u32 cycles);
+template void GuestProfiler_Step<1>(u32 adr, u32 instruction, bool thumb, u32 cycles);
+
+//--------------------------------------------------------------------------------
+
+void GuestProfiler_Reset()
+{
+	if(!profCpu) return;
+
+	for(int i=0;i<2;i++)
+	{
+		ProfCpu &cpu = profCpu[i];
+		cpu.pcs.clear();
+		cpu.funcs.clear();
+		cpu.edges.clear();
+		cpu.top = cpu.depth = 0;
+		cpu.countdown = (s32)sampleInterval;
+		cpu.samples = 0;
+	}
+}
+
+void GuestProfiler_Start(u32 interval)
+{
+	if(!profCpu)
+		profCpu = (ProfCpu*)malloc(sizeof(ProfCpu)*2);
+	if(!profCpu)
+		return;
+
+	sampleInterval = interval ? interval : 1;
+	GuestProfiler_Reset();
+	guestProfilerActive = true;
+}
+
+void GuestProfiler_Stop()
+{
+	if(!profCpu) return;
+
+	guestProfilerActive = false;
+	GuestProfiler_Dump();
+	free(profCpu);
+	profCpu = NULL;
+}
+
+static void funcName(char *buf, size_t size, u32 func)
+{
+	if(func)
+		snprintf(buf, size, "sub_%08X%s", func & ~1, (func & 1) ? "_thumb" : "");
+	else
+		snprintf(buf, size, "<root>");
+}
+
+//the disassembler output goes into a JSON string
+static void jsonEscape(char *dst, size_t size, const char *src)
+{
+	size_t n = 0;
+	for(; *src && n+2 < size; src++)
+	{
+		if(*src == '"' || *src == '\\') dst[n++] = '\\';
+		dst[n++] = (*src == '\t') ? ' ' : *src;
+	}
+	dst[n] = 0;
+}
+
+template<int PROCNUM>
+static void disassemble(u32 key, char *out, size_t size)
+{
+	char txt[256];
+	const u32 adr = key & ~1;
+	txt[0] = 0;
+	if(key & 1)
+	{
+		const u32 i = _MMU_read16<PROCNUM, MMU_AT_CODE>(adr);
+		des_thumb_instructions_set[i>>6](adr, i, txt);
+	}
+	else
+	{
+		const u32 i = _MMU_read32<PROCNUM, MMU_AT_CODE>(adr);
+		des_arm_instructions_set[INSTRUCTION_INDEX(i)](adr, i, txt);
+	}
+	jsonEscape(out, size, txt);
+}
+
+//indices of the used slots, most hits first
+static int topEntries(const ProfHistogram &hist, int *out, int max)
+{
+	static int order[PROF_TABLE_SIZE];
+	int count = 0;
+	for(int i=0;i<PROF_TABLE_SIZE;i++)
+		if(hist.counts[i]) order[count++] = i;
+
+	struct ByCount
+	{
+		const ProfHistogram &hist;
+		ByCount(const ProfHistogram &h) : hist(h) {}
+		bool operator()(int a, int b) const { return hist.counts[a] > hist.counts[b]; }
+	};
+	const int n = std::min(count, max);
+	std::partial_sort(order, order+n, order+count, ByCount(hist));
+	memcpy(out, order, n*sizeof(int));
+	return n;
+}
+
+template<int PROCNUM>
+static void dumpCpu(FILE *f, const char *timestr)
+{
+	const ProfCpu &cpu = profCpu[PROCNUM];
+	const char *cpuname = PROCNUM ? "arm7" : "arm9";
+	const double total = cpu.samples ? (double)cpu.samples : 1.0;
+	int top[PROF_MAX_DUMP];
+	char name[64], callee[64], disasm[512];
+
+	int n = topEntries(cpu.funcs, top, PROF_MAX_DUMP);
+	for(int i=0;i<n;i++)
+	{
+		const u32 count = cpu.funcs.counts[top[i]];
+		funcName(name, sizeof(name), (u32)cpu.funcs.keys[top[i]]);
+		fprintf(f, "{\"scope\":\"%s %s\",\"kind\":\"func\",\"calls\":%u,\"pct_total\":%.3f,\"timestamp\":\"%s\"}\n",
+			cpuname, name, count, count*100.0/total, timestr);
+	}
+
+	n = topEntries(cpu.pcs, top, PROF_MAX_DUMP);
+	for(int i=0;i<n;i++)
+	{
+		const u32 key = (u32)cpu.pcs.keys[top[i]];
+		const u32 count = cpu.pcs.counts[top[i]];
+		disassemble<PROCNUM>(key, disasm, sizeof(disasm));
+		fprintf(f, "{\"scope\":\"%s %08X\",\"kind\":\"pc\",\"calls\":%u,\"pct_total\":%.3f,\"disasm\":\"%s\",\"timestamp\":\"%s\"}\n",
+			cpuname, key & ~1, count, count*100.0/total, disasm, timestr);
+	}
+
+	//edges count calls rather than samples
+	n = topEntries(cpu.edges, top, PROF_MAX_DUMP);
+	for(int i=0;i<n;i++)
+	{
+		const u64 key = cpu.edges.keys[top[i]];
+		funcName(name, sizeof(name), (u32)(key >> 32));
+		funcName(callee, sizeof(callee), (u32)key);
+		fprintf(f, "{\"scope\":\"%s %s -> %s\",\"kind\":\"edge\",\"calls\":%u,\"timestamp\":\"%s\"}\n",
+			cpuname, name, callee, cpu.edges.counts[top[i]], timestr);
+	}
+
+	fprintf(f, "{\"scope\":\"%s\",\"kind\":\"summary\",\"calls\":%u,\"interval\":%u,\"dropped\":%u,\"timestamp\":\"%s\"}\n",
+		cpuname, cpu.samples, sampleInterval, cpu.pcs.dropped + cpu.funcs.dropped, timestr);
+}
+
+void GuestProfiler_Dump()
+{
+	if(!profCpu) return;
+
+	mkdir(PROF_LOG_DIR, 0755);
+	FILE *f = fopen(PROF_LOG_FILE, "a");
+	if(!f) return;
+
+	time_t tnow = time(NULL);
+	struct tm tmv;
+	char timestr[64];
+	gmtime_r(&tnow, &tmv);
+	strftime(timestr, sizeof(timestr), "%Y-%m-%dT%H:%M:%SZ", &tmv);
+
+	dumpCpu<ARMCPU_ARM9>(f, timestr);
+	dumpCpu<ARMCPU_ARM7>(f, timestr);
+
+	fclose(f);
+}
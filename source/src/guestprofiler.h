@@ -0,0 +1,45 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _GUESTPROFILER_H_
+#define _GUESTPROFILER_H_
+
+#include "types.h"
+
+//sampling profiler for the emulated code.
+//every N cycles of each cpu the address being executed is counted, both per instruction and
+//per function. functions are found by following BL/BLX and the matching returns, so the report
+//also contains the call edges. reports are appended to sd:/profiler/guest.log as JSONL,
+//in the same shape as the host profiler's records.
+
+extern bool guestProfilerActive;
+
+//interval is in cycles of the respective cpu
+void GuestProfiler_Start(u32 interval);
+
+//stops sampling and writes a report
+void GuestProfiler_Stop();
+
+void GuestProfiler_Reset();
+void GuestProfiler_Dump();
+
+//called by the cpu loop with the instruction which was just executed, only while active
+template<int PROCNUM> void GuestProfiler_Step(u32 adr, u32 instruction, bool thumb, u32 cycles);
+
+#endif
@@ -27,6 +27,7 @@
 #include <sdcard/wiisd_io.h>
 #include <ogc/disc_io.h>
 #include <sys/time.h>
+#include <time.h>
 #include <wiiuse/wpad.h>
 #include <sys/dir.h>
 #include <ogc/lwp_watchdog.h>
@@ -45,6 +46,14 @@
 #include "GXRender.h"
 #include "rasterize.h"
 #include "filebrowser.h"
+#include "bootcache.h"
+#include "runahead.h"
+#include "screenshot.h"
+#include "record.h"
+#include "guestprofiler.h"
+#include "cputrace.h"
+#include "watch.h"
+#include "path.h"
 
 //#include <sdcard/wiisd_io.h>
 #include <ogc/usbstorage.h>
@@ -93,6 +102,12 @@ volatile bool execute = false;
 static bool show_console = true;
 static int SkipFrame = 0;
 static int SkipFrameTracker = 0;
+static int RunAheadFrames = 0;
+static u32 FrameDumpEvery = 0;
+static bool RecordAV = false;
+static u32 GuestProfileInterval = 0;
+static u32 CpuTraceMask = 0;
+static bool LoadWatchList = false;
 static u32 pad, wpad;
 int FPS;
 static bool g_pendingProfilerEnabled = false;
@@ -125,6 +140,8 @@ static void Draw(void);
 void ShowFPS();
 void DSExec();
 void Pause();
+static void StartFrameDump();
+static void TakeScreenshot();
 static void *draw_thread(void*);
 void Execute();
 void create_dummy_firmware();
@@ -268,6 +285,47 @@ int main(int argc, char **argv)
 		exit(0);
 	}
 
+	if (BootCache_Start())
+		printf("Boot restored from the boot cache.\n");
+
+	if (FrameDumpEvery) StartFrameDump();
+
+	if (RecordAV) {
+		// e.g. sd:/DS/SAVES/game.rgb and game.wav
+		char base[MAX_PATH];
+		path.getpathnoext(path.AVI_FILES, base);
+		if (Record_Begin(base))
+			SDLogger_Log("Recording to %s.rgb/.wav", base);
+	}
+
+	// the report goes to sd:/profiler/guest.log when NDS_DeInit stops it
+	if (GuestProfileInterval)
+		GuestProfiler_Start(GuestProfileInterval);
+
+	if (CpuTraceMask) {
+		// traced from the first frame. at 32 bytes a record the limit keeps the file around 512MB
+		CpuTraceConfig config;
+		memset(&config, 0, sizeof(config));
+		config.cpuMask = CpuTraceMask;
+		config.maxInstructions = 16*1024*1024;
+
+		char fname[MAX_PATH];
+		path.getpathnoext(path.STATES, fname);
+		strcat(fname, ".trc");
+		if (CpuTrace_Start(fname, config))
+			SDLogger_Log("CPU trace written to %s", fname);
+	}
+
+	if (LoadWatchList) {
+		// per game list next to the cheats, e.g. sd:/DS/SAVES/game.wch. see Watch_LoadList for the format
+		char fname[MAX_PATH];
+		path.getpathnoext(path.CHEATS, fname);
+		strcat(fname, ".wch");
+		int added = Watch_LoadList(fname);
+		if (added >= 0)
+			SDLogger_Log("%d watchpoints loaded from %s", added, fname);
+	}
+
 	execute = true;
 
 	log_console_enable_video(false);
@@ -706,6 +764,16 @@ void Execute() {
 	LWP_JoinThread(vidthread, NULL);
 	vidthread = LWP_THREAD_NULL;
 
+	RunAhead_Free();
+
+	// the hits of the watchpoints loaded at startup
+	if (Watch_Count()) {
+		char fname[MAX_PATH];
+		path.getpathnoext(path.CHEATS, fname);
+		strcat(fname, ".wjl");
+		Watch_JournalSave(fname);
+	}
+
 	NDS_DeInit();
 
 	GX_AbortFrame();
@@ -795,11 +863,14 @@ void DSExec()
 			SkipFrame = 0;
 	}
 
+	if (pad & PAD_BUTTON_DOWN)
+		TakeScreenshot();
+
 	if(	(wpad & WPAD_BUTTON_HOME) || ((pad & PAD_TRIGGER_Z) && (pad  & PAD_TRIGGER_R) && (pad & PAD_TRIGGER_L)) || 
 		(wpad & WPAD_CLASSIC_BUTTON_HOME))
 		quit_game = true;
 
-	NDS_exec<TRUE>(0);
+	RunAhead_Exec(RunAheadFrames);
 
 	// update FPS counters first so Draw() can render the latest value
 	if (showfps) ShowFPS();
@@ -811,6 +882,35 @@ void DSExec()
 	Profiler::TickIfNeeded();
 }
 
+// frames go next to the saves, e.g. sd:/DS/SAVES/game_000042.png
+static void StartFrameDump()
+{
+	char base[MAX_PATH];
+	char fmt[MAX_PATH];
+	path.getpathnoext(path.SCREENSHOTS, base);
+
+	// the name becomes a printf pattern, so a '%' in the rom name has to be doubled
+	int len = 0;
+	for (const char *c = base; *c && len < MAX_PATH - 16; c++) {
+		if (*c == '%') fmt[len++] = '%';
+		fmt[len++] = *c;
+	}
+	strcpy(fmt + len, "_%06u.png");
+
+	if (FrameDump_Start(fmt, FrameDumpEvery))
+		SDLogger_Log("Frame dump started: every %u frames", FrameDumpEvery);
+}
+
+static void TakeScreenshot()
+{
+	static u32 shots = 0;
+	char base[MAX_PATH];
+	char fname[MAX_PATH];
+	path.getpathnoext(path.SCREENSHOTS, base);
+	snprintf(fname, MAX_PATH, "%s_%u_%u.png", base, (u32)time(NULL), shots++);
+	NDS_WritePNG(fname);
+}
+
 void Pause(){
 	for(;;){
 		WPAD_ScanPads();
@@ -837,6 +937,15 @@ bool PickDevice() {
 	};
 	static const char* showFpsOpts[] = { "No", "Yes" }; // new Show FPS options
 	static const char* profilerOpts[] = { "Off", "On" }; // Host Profiler toggle
+	static const char* bootCacheOpts[] = { "Off", "On" }; // Fast boot snapshot toggle
+	static const char* runAheadOpts[] = { "Off", "1", "2", "3", "4" }; // Run-ahead frames
+	static const char* fixedGeomOpts[] = { "Off", "On" }; // 20.12 fixed point geometry engine
+	static const char* frameDumpOpts[] = { "Off", "1", "2", "4", "8" }; // dump every Nth frame to PNG
+	static const char* recordOpts[] = { "Off", "On" }; // lossless audio/video recording
+	static const char* guestProfOpts[] = { "Off", "256", "1024", "4096" }; // guest code sampling interval in cycles
+	static const char* cpuTraceOpts[] = { "Off", "ARM9", "ARM7", "Both" }; // binary execution trace
+	static const char* watchOpts[] = { "Off", "On" }; // load the game's watchpoint list
+	static const char* tiledTexOpts[] = { "Off", "On" }; // 4x4 tiled textures in the software rasterizer
 
 	// Menu items: add more entries here to extend the menu
 	static MenuItem menuItems[] = {
@@ -844,7 +953,16 @@ bool PickDevice() {
 		{ "Select Renderer:", rendererOpts, 3, 2 }, // default Soft (sel=2)
 		{ "SkipFrame:",       skipOpts,    21, 0 }, // default 0
 		{ "Show FPS:",        showFpsOpts,  2, 0 }, // default No (sel=0)
-		{ "Host Profiler:",   profilerOpts, 2, 0 }  // default Off (sel=0)
+		{ "Host Profiler:",   profilerOpts, 2, 0 }, // default Off (sel=0)
+		{ "Boot Cache:",      bootCacheOpts, 2, 0 }, // default Off (sel=0)
+		{ "Run Ahead:",       runAheadOpts, 5, 0 }, // default Off (sel=0)
+		{ "Fixed Point 3D:",  fixedGeomOpts, 2, 0 }, // default Off (sel=0)
+		{ "Frame Dump Every:", frameDumpOpts, 5, 0 }, // default Off (sel=0)
+		{ "Record A/V:",      recordOpts,   2, 0 }, // default Off (sel=0)
+		{ "Guest Profiler:",  guestProfOpts, 4, 0 }, // default Off (sel=0)
+		{ "CPU Trace:",       cpuTraceOpts, 4, 0 }, // default Off (sel=0)
+		{ "Watchpoints:",     watchOpts,    2, 0 }, // default Off (sel=0)
+		{ "Tiled Textures:",  tiledTexOpts, 2, 1 }  // default On (sel=1)
 	};
 
 	const int menuCount = sizeof(menuItems) / sizeof(menuItems[0]);
@@ -966,6 +1084,33 @@ bool PickDevice() {
 			// inside PickDevice(), replace the profiler code with:
 			g_pendingProfilerEnabled = profilerEnabled;
 
+			// Boot cache selection is menuItems[5].sel -> 0 = Off, 1 = On
+			CommonSettings.BootCache = (menuItems[5].sel != 0);
+
+			// Run-ahead selection is menuItems[6].sel -> number of frames, 0 = Off
+			RunAheadFrames = menuItems[6].sel;
+
+			// Fixed point geometry is menuItems[7].sel -> 0 = Off, 1 = On. latched by gfx3d_reset when the rom loads
+			CommonSettings.GFX3D_FixedPointGeometry = (menuItems[7].sel != 0);
+
+			// Frame dump is menuItems[8].sel -> 0 = Off, otherwise every 1, 2, 4 or 8 frames
+			FrameDumpEvery = menuItems[8].sel ? (1u << (menuItems[8].sel - 1)) : 0;
+
+			// A/V recording is menuItems[9].sel -> 0 = Off, 1 = On
+			RecordAV = (menuItems[9].sel != 0);
+
+			// Guest profiler is menuItems[10].sel -> 0 = Off, otherwise a sample every 256, 1024 or 4096 cycles
+			GuestProfileInterval = menuItems[10].sel ? (64u << (2 * menuItems[10].sel)) : 0;
+
+			// CPU trace is menuItems[11].sel -> the option index is the cpu mask, bit 0 = ARM9, bit 1 = ARM7
+			CpuTraceMask = menuItems[11].sel;
+
+			// Watchpoints is menuItems[12].sel -> 0 = Off, 1 = load <rom>.wch and journal its hits
+			LoadWatchList = (menuItems[12].sel != 0);
+
+			// Tiled textures is menuItems[13].sel -> 0 = Off, 1 = On. only affects the Soft renderer
+			CommonSettings.GFX3D_TiledTextures = (menuItems[13].sel != 0);
+
 			if (!wantUSB) {
 				SDLogger_Log("TRACE: PickDevice - SD chosen, breaking out");
 				// SD chosen: proceed normally
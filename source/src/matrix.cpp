@@ -234,6 +234,86 @@ void MatrixStackLoadMatrix (MatrixStack *stack, int pos, const float *ptr){
 	MatrixCopy (&stack->matrix[pos*16], ptr);
 }
 
+//-----------------------------------------
+//fixed point
+
+#define fx32_mul(a,b) ((s64)(a)*(s64)(b))
+#define fx32_shiftdown(v) ((s32)((v)>>12))
+
+void MatrixIdentityFixed(s32 *matrix){
+	memset (matrix, 0, sizeof(s32)*16);
+	matrix[0] = matrix[5] = matrix[10] = matrix[15] = 1<<12;
+}
+
+void MatrixCopyFixed(s32 *matrixDST, const s32 *matrixSRC){
+	memcpy (matrixDST, matrixSRC, sizeof(s32)*16);
+}
+
+void MatrixToFloat(float *matrixDST, const s32 *matrixSRC){
+	for(int i=0;i<16;i++)
+		matrixDST[i] = matrixSRC[i] / 4096.f;
+}
+
+void MatrixFromFloat(s32 *matrixDST, const float *matrixSRC){
+	for(int i=0;i<16;i++)
+		matrixDST[i] = (s32)floorf(matrixSRC[i] * 4096.f + 0.5f);
+}
+
+void MatrixMultVec4x4Fixed(const s32 *matrix, s32 *vecPtr){
+	const s64 x = vecPtr[0];
+	const s64 y = vecPtr[1];
+	const s64 z = vecPtr[2];
+	const s64 w = vecPtr[3];
+
+	vecPtr[0] = fx32_shiftdown(x*matrix[0] + y*matrix[4] + z*matrix[ 8] + w*matrix[12]);
+	vecPtr[1] = fx32_shiftdown(x*matrix[1] + y*matrix[5] + z*matrix[ 9] + w*matrix[13]);
+	vecPtr[2] = fx32_shiftdown(x*matrix[2] + y*matrix[6] + z*matrix[10] + w*matrix[14]);
+	vecPtr[3] = fx32_shiftdown(x*matrix[3] + y*matrix[7] + z*matrix[11] + w*matrix[15]);
+}
+
+void MatrixMultVec3x3Fixed(const s32 *matrix, s32 *vecPtr){
+	const s64 x = vecPtr[0];
+	const s64 y = vecPtr[1];
+	const s64 z = vecPtr[2];
+
+	vecPtr[0] = fx32_shiftdown(x*matrix[0] + y*matrix[4] + z*matrix[ 8]);
+	vecPtr[1] = fx32_shiftdown(x*matrix[1] + y*matrix[5] + z*matrix[ 9]);
+	vecPtr[2] = fx32_shiftdown(x*matrix[2] + y*matrix[6] + z*matrix[10]);
+}
+
+void MatrixMultiplyFixed(s32 *matrix, const s32 *rightMatrix){
+	s32 tmpMatrix[16];
+
+	for(int row=0;row<16;row+=4){
+		const s32 *r = rightMatrix + row;
+		for(int col=0;col<4;col++){
+			tmpMatrix[row+col] = fx32_shiftdown(fx32_mul(matrix[col],r[0]) + fx32_mul(matrix[col+4],r[1])
+										+ fx32_mul(matrix[col+8],r[2]) + fx32_mul(matrix[col+12],r[3]));
+		}
+	}
+
+	memcpy (matrix, tmpMatrix, sizeof(s32)*16);
+}
+
+void MatrixTranslateFixed(s32 *matrix, const s32 *ptr){
+	for(int i=0;i<4;i++){
+		const s64 temp = ((s64)matrix[i+12]<<12) + fx32_mul(matrix[i],ptr[0])
+						+ fx32_mul(matrix[i+4],ptr[1]) + fx32_mul(matrix[i+8],ptr[2]);
+		matrix[i+12] = fx32_shiftdown(temp);
+	}
+}
+
+void MatrixScaleFixed(s32 *matrix, const s32 *ptr){
+	for(int i=0;i<4;i++){
+		matrix[i]   = fx32_shiftdown(fx32_mul(matrix[i],ptr[0]));
+		matrix[i+4] = fx32_shiftdown(fx32_mul(matrix[i+4],ptr[1]));
+		matrix[i+8] = fx32_shiftdown(fx32_mul(matrix[i+8],ptr[2]));
+	}
+}
+
+#undef fx32_mul
+#undef fx32_shiftdown
+
 void Vector2Copy(float *dst, const float *src){
 	dst[0] = src[0];
 	dst[1] = src[1];
@@ -57,6 +57,18 @@ float*	MatrixStackGetPos			(MatrixStack *stack, int pos);
 float*	MatrixStackGet				(MatrixStack *stack);
 void	MatrixStackLoadMatrix		(MatrixStack *stack, int pos, const float *ptr);
 
+//20.12 fixed point versions, following the geometry engine's arithmetic:
+//products are summed at 64 bits, then shifted down and truncated to 32 bits once per element
+void	MatrixIdentityFixed			(s32 *matrix);
+void	MatrixCopyFixed				(s32 *matrixDST, const s32 *matrixSRC);
+void	MatrixToFloat				(float *matrixDST, const s32 *matrixSRC);
+void	MatrixFromFloat				(s32 *matrixDST, const float *matrixSRC);
+void	MatrixMultVec4x4Fixed		(const s32 *matrix, s32 *vecPtr);
+void	MatrixMultVec3x3Fixed		(const s32 *matrix, s32 *vecPtr);
+void	MatrixMultiplyFixed			(s32 *matrix, const s32 *rightMatrix);
+void	MatrixTranslateFixed		(s32 *matrix, const s32 *ptr);
+void	MatrixScaleFixed			(s32 *matrix, const s32 *ptr);
+
 void Vector2Copy(float *dst, const float *src);
 void Vector2Add(float *dst, const float *src);
 void Vector2Subtract(float *dst, const float *src);
@@ -267,12 +267,8 @@ bool BackupDevice::save_state(EMUFILE* os)
 {
 	u32 version = 1;
 	//v0
-	write32le(version,os);
-	write32le(write_enable,os);
-	write32le(com,os);
-	write32le(addr_size,os);
-	write32le(addr_counter,os);
-	write32le((u32)state,os);
+	const u32 header[6] = { version, write_enable ? 1 : 0, com, addr_size, addr_counter, (u32)state };
+	writeArrayLE(header,6,os);
 	writebuffer(data,os);
 	writebuffer(data_autodetect,os);
 	//v1
@@ -285,13 +281,13 @@ bool BackupDevice::load_state(EMUFILE* is)
 	u32 version;
 	if(read32le(&version,is)!=1) return false;
 	if(version>=0){
-		readbool(&write_enable,is);
-		read32le(&com,is);
-		read32le(&addr_size,is);
-		read32le(&addr_counter,is);
-		u32 temp;
-		read32le(&temp,is);
-		state = (STATE)temp;
+		u32 header[5];
+		if(readArrayLE(header,5,is) != 1) return false;
+		write_enable = header[0] != 0;
+		com = header[1];
+		addr_size = header[2];
+		addr_counter = header[3];
+		state = (STATE)header[4];
 		readbuffer(data,is);
 		readbuffer(data_autodetect,is);
 	}
@@ -257,8 +257,12 @@ int MovieData::dump(EMUFILE* fp, bool binary)
 	{
 		//put one | to start the binary dump
 		fp->fputc('|');
+		//the records are gathered in memory and go out in one write. the pad stays in host order
+		//like it always has, so the byte order helpers don't apply to this format
+		EMUFILE_MEMORY ms(records.size()*6);
 		for(int i=0;i<(int)records.size();i++)
-			records[i].dumpBinary(this,fp,i);
+			records[i].dumpBinary(this,&ms,i);
+		if(ms.size()) fp->fwrite(ms.buf(),ms.size());
 	}
 	else
 		for(int i=0;i<(int)records.size();i++)
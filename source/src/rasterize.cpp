@@ -67,13 +67,28 @@ static u8 decal_table[32][64][64];
 static u8 index_lookup_table[65];
 static u8 index_start_table[8];
 
-static GFX3D_Clipper clipper;
+//one clipper per rasterizer core, each working on its own range of the poly list
+static GFX3D_Clipper clipper[4];
 static GFX3D_Clipper::TClippedPoly *clippedPolys = NULL;
 static TexCacheItem* polyTexKeys[POLYLIST_SIZE];
 static bool polyVisible[POLYLIST_SIZE];
 static bool polyBackfacing[POLYLIST_SIZE];
 static int clippedPolyCounter;
 
+//the textures resolved this frame, keyed by texparam and texpal. a scene draws thousands of polys with a
+//few dozen textures, so each pair goes through the texcache once per frame instead of once per texture change.
+//entries are stamped with the frame they were filled in, so nothing has to be cleared between frames
+#define FRAME_TEXTURES_SIZE 4096
+struct FrameTexture
+{
+	u32 format, texpal;
+	u32 stamp;
+	TexCacheItem* item;
+};
+static FrameTexture frameTextures[FRAME_TEXTURES_SIZE];
+static u32 frameTexturesStamp = 0;
+static int frameTexturesCount;
+
 
 
 ////optimized float floor useful in limited cases
@@ -452,8 +467,13 @@ public:
 			s32 iv = s32floor(v);
 			dowrap(iu,iv);
 
+			//the wrap modes work on coordinates, so they are the same for both layouts
+			const TexCacheItem* tex = unit->lastTexKey;
 			FragmentColor color;
-			color.color = ((u32*)unit->lastTexKey->decoded)[(iv<<wshift)+iu];
+			if(tex->tiled)
+				color.color = ((u32*)tex->decoded)[TexCache_TiledIndex(iu,iv,wshift)];
+			else
+				color.color = ((u32*)tex->decoded)[(iv<<wshift)+iu];
 			return color;
 		}
 
@@ -926,6 +946,42 @@ static void* execRasterizerUnit(void* arg)
 	return 0;
 }
 
+struct ClipRange
+{
+	int first, last;
+};
+static ClipRange clipRanges[4];
+
+static void clipPolyRange(int which)
+{
+	GFX3D_Clipper &unit = clipper[which];
+	const ClipRange &range = clipRanges[which];
+
+	//a poly clips to at most one poly, so a range can build its output in place
+	unit.clippedPolys = clippedPolys + range.first;
+	unit.clippedPolyCounter = 0;
+	for(int i=range.first;i<range.last;i++)
+	{
+		POLY* poly = &gfx3d.polylist->list[gfx3d.indexlist[i]];
+		VERT* clipVerts[4] = {
+			&gfx3d.vertlist->list[poly->vertIndexes[0]],
+			&gfx3d.vertlist->list[poly->vertIndexes[1]],
+			&gfx3d.vertlist->list[poly->vertIndexes[2]],
+			poly->type==4
+				?&gfx3d.vertlist->list[poly->vertIndexes[3]]
+				:NULL
+		};
+
+		unit.clipPoly(poly,clipVerts);
+	}
+}
+
+static void* execClipPolyRange(void* arg)
+{
+	clipPolyRange((int)arg);
+	return 0;
+}
+
 static char SoftRastInit(void)
 {
 	if(!rasterizerUnitTasksInited)
@@ -974,7 +1030,7 @@ static char SoftRastInit(void)
 			Why is this POLYLIST_SIZE*2?  I can't for the life of me find where you need 2*POLLYLIST_SIZE
 
 		*/
-		clipper.clippedPolys = clippedPolys = new GFX3D_Clipper::TClippedPoly[POLYLIST_SIZE];
+		clippedPolys = new GFX3D_Clipper::TClippedPoly[POLYLIST_SIZE];
 
 		for(int i=0;i<64;i++)
 		{
@@ -1132,6 +1188,43 @@ static void SoftRastConvertFramebuffer()
 	memcpy(gfx3d_convertedScreen,screenColor,256*192*4);
 }
 
+static void frameTexturesBegin()
+{
+	frameTexturesCount = 0;
+	if(++frameTexturesStamp == 0)
+	{
+		memset(frameTextures, 0, sizeof(frameTextures));
+		frameTexturesStamp = 1;
+	}
+}
+
+//texcache items aren't evicted until the frame is over, so the handles stay good until then
+static TexCacheItem* frameTexturesResolve(u32 format, u32 texpal)
+{
+	u32 slot = (format ^ (format>>13) ^ (texpal*0x9E3779B1)) & (FRAME_TEXTURES_SIZE-1);
+	for(;;)
+	{
+		FrameTexture &entry = frameTextures[slot];
+		if(entry.stamp != frameTexturesStamp)
+		{
+			TexCacheItem* item = TexCache_SetTexture(TexFormat_15bpp,format,texpal);
+			//keep the probes short; a frame with more unique textures than that just isn't remembered
+			if(frameTexturesCount < FRAME_TEXTURES_SIZE/2)
+			{
+				entry.format = format;
+				entry.texpal = texpal;
+				entry.stamp = frameTexturesStamp;
+				entry.item = item;
+				frameTexturesCount++;
+			}
+			return item;
+		}
+		if(entry.format == format && entry.texpal == texpal)
+			return entry.item;
+		slot = (slot+1) & (FRAME_TEXTURES_SIZE-1);
+	}
+}
+
 static void SoftRastRender()
 {
 	Fragment clearFragment;
@@ -1257,24 +1350,31 @@ static void SoftRastRender()
 	for(int i=0;i<gfx3d.vertlist->count;i++)
 		gfx3d.vertlist->list[i].color_to_float();
 
-	//submit all polys to clipper
-	clipper.clippedPolyCounter = 0;
-	for(int i=0;i<gfx3d.polylist->count;i++)
+	//submit all polys to the clippers, split in one range per core.
+	//(polys are clipped in list order, so the output stays sorted)
+	const int polyCount = gfx3d.polylist->count;
+	const int clipCores = (polyCount < 256) ? 1 : rasterizerCores;
+	for(int i=0;i<clipCores;i++)
 	{
-		POLY* poly = &gfx3d.polylist->list[gfx3d.indexlist[i]];
-		VERT* clipVerts[4] = {
-			&gfx3d.vertlist->list[poly->vertIndexes[0]],
-			&gfx3d.vertlist->list[poly->vertIndexes[1]],
-			&gfx3d.vertlist->list[poly->vertIndexes[2]],
-			poly->type==4
-				?&gfx3d.vertlist->list[poly->vertIndexes[3]]
-				:NULL
-		};
-
-		clipper.clipPoly(poly,clipVerts);
+		clipRanges[i].first = polyCount * i / clipCores;
+		clipRanges[i].last = polyCount * (i+1) / clipCores;
+	}
+	if(clipCores==1)
+		clipPolyRange(0);
+	else
+	{
+		for(int i=0;i<clipCores;i++) rasterizerUnitTask[i].execute(execClipPolyRange,(void*)i);
+		for(int i=0;i<clipCores;i++) rasterizerUnitTask[i].finish();
+	}
 
+	//pack the ranges together
+	clippedPolyCounter = clipper[0].clippedPolyCounter;
+	for(int i=1;i<clipCores;i++)
+	{
+		if(clippedPolyCounter != clipRanges[i].first)
+			memmove(clippedPolys + clippedPolyCounter, clipper[i].clippedPolys, clipper[i].clippedPolyCounter * sizeof(GFX3D_Clipper::TClippedPoly));
+		clippedPolyCounter += clipper[i].clippedPolyCounter;
 	}
-	clippedPolyCounter = clipper.clippedPolyCounter;
 
 	//printf("%d %d %d %d\n",gfx3d.viewport.x,gfx3d.viewport.y,gfx3d.viewport.width,gfx3d.viewport.height);
 //			printf("%f\n",vert.coord[0]);
@@ -1323,6 +1423,7 @@ static void SoftRastRender()
 	TexCacheItem* lastTexKey = NULL;
 	u32 lastTextureFormat = 0, lastTexturePalette = 0;
 	bool needInitTexture = true;
+	frameTexturesBegin();
 	for(int i=0;i<clippedPolyCounter;i++)
 	{
 		GFX3D_Clipper::TClippedPoly &clippedPoly = clippedPolys[i];
@@ -1378,7 +1479,7 @@ static void SoftRastRender()
 		//make sure all the textures we'll need are cached
 		if(needInitTexture || lastTextureFormat != poly->texParam || lastTexturePalette != poly->texPalette)
 		{
-			lastTexKey = TexCache_SetTexture(TexFormat_15bpp,poly->texParam,poly->texPalette);
+			lastTexKey = frameTexturesResolve(poly->texParam,poly->texPalette);
 			lastTextureFormat = poly->texParam;
 			lastTexturePalette = poly->texPalette;
 			needInitTexture = false;
@@ -21,6 +21,8 @@
 
 #include "readwrite.h"
 #include "types.h"
+#include <string.h>
+#include <algorithm>
 
 //well. just for the sake of consistency
 int write8le(u8 b, EMUFILE*os)
@@ -117,6 +119,85 @@ int read64le(u64 *Bufo, EMUFILE *is)
 	return 1;
 }
 
+//byte swaps count elements of size bytes each, in place
+static void swapArray(u8 *buf, int size, u32 count)
+{
+	switch(size)
+	{
+	case 2:
+		for(u32 i=0;i<count;i++)
+			((u16*)buf)[i] = LE_TO_LOCAL_16(((u16*)buf)[i]);
+		break;
+	case 4:
+		for(u32 i=0;i<count;i++)
+			((u32*)buf)[i] = LE_TO_LOCAL_32(((u32*)buf)[i]);
+		break;
+	case 8:
+		for(u32 i=0;i<count;i++)
+			((u64*)buf)[i] = LE_TO_LOCAL_64(((u64*)buf)[i]);
+		break;
+	default:
+		for(u32 i=0;i<count;i++)
+			FlipByteOrder(buf + i*size, size);
+		break;
+	}
+}
+
+///writes count little endian elements of size bytes each with as few fwrites as possible.
+///the source is left untouched; on big endian hosts it is swapped a chunk at a time through a stack buffer
+int writeArrayLE(const void *arr, int size, u32 count, EMUFILE *os)
+{
+	const u32 total = (u32)size*count;
+#ifdef LOCAL_LE
+	if(total) os->fwrite((char*)arr,total);
+#else
+	if(size == 1)
+	{
+		if(total) os->fwrite((char*)arr,total);
+		return total;
+	}
+
+	u8 chunk[4096];
+	const u32 perChunk = sizeof(chunk)/size;
+	if(perChunk == 0)
+	{
+		//elements larger than the chunk. nothing in the savestates is, but keep it correct
+		for(u32 i=0;i<count;i++)
+		{
+			std::vector<u8> tmp((const u8*)arr + i*size, (const u8*)arr + (i+1)*size);
+			FlipByteOrder(&tmp[0], size);
+			os->fwrite((char*)&tmp[0],size);
+		}
+		return total;
+	}
+
+	const u8 *src = (const u8*)arr;
+	for(u32 done=0;done<count;)
+	{
+		const u32 n = std::min(perChunk, count-done);
+		memcpy(chunk, src + done*size, n*size);
+		swapArray(chunk, size, n);
+		os->fwrite((char*)chunk,n*size);
+		done += n;
+	}
+#endif
+	return total;
+}
+
+///reads count little endian elements of size bytes each with a single fread, then swaps them in place.
+///returns the number of whole elements read
+int readArrayLE(void *arr, int size, u32 count, EMUFILE *is)
+{
+	const u32 total = (u32)size*count;
+	if(!total) return count;
+	const u32 got = is->_fread((char*)arr,total) / size;
+#ifndef LOCAL_LE
+	if(size != 1)
+		swapArray((u8*)arr, size, got);
+#endif
+	return got;
+}
+
 int readbool(bool *b, EMUFILE* is)
 {
 	u32 temp = 0;
@@ -56,7 +56,25 @@ int readle(T *Bufo, EMUFILE*is)
 	}
 }
 
+//bulk versions for runs of same sized values: one read or a few chunked writes per array
+//instead of one call per element. the stream format is the same as calling readle/write*le per element
+int writeArrayLE(const void *arr, int size, u32 count, EMUFILE *os);
+int readArrayLE(void *arr, int size, u32 count, EMUFILE *is);
 
+template<typename T>
+int writeArrayLE(const T *arr, u32 count, EMUFILE *os)
+{
+	CTASSERT(sizeof(T)==1||sizeof(T)==2||sizeof(T)==4||sizeof(T)==8);
+	return writeArrayLE((const void*)arr,sizeof(T),count,os);
+}
+
+//returns 1 when all count elements were read, like readle
+template<typename T>
+int readArrayLE(T *arr, u32 count, EMUFILE *is)
+{
+	CTASSERT(sizeof(T)==1||sizeof(T)==2||sizeof(T)==4||sizeof(T)==8);
+	return readArrayLE((void*)arr,sizeof(T),count,is) == (int)count ? 1 : 0;
+}
 
 int readbool(bool *b, EMUFILE* is);
 void writebool(bool b, EMUFILE* os);
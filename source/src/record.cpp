@@ -0,0 +1,300 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <gccore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "GPU.h"
+#include "SPU.h"
+#include "record.h"
+
+#define REC_PIXELS (256*192*2)
+
+struct RecordFrame
+{
+	u16 pixels[REC_PIXELS];
+	s16 samples[RECORD_MAX_FRAME_SAMPLES*2];
+	u32 numSamples;
+	//false for the extra blocks holding the samples of a frame which didn't fit into one
+	bool hasVideo;
+};
+
+static RecordFrame *frames = NULL;
+
+//frames waiting for the worker, in emulation order, and the unused ones
+static int queue[RECORD_POOL_SIZE];
+static int queueHead, queueCount;
+static int freeFrames[RECORD_POOL_SIZE];
+static int freeCount;
+
+//the frame the core is currently filling with samples
+static int current = -1;
+
+static lwp_t recthread = LWP_THREAD_NULL;
+static mutex_t recmutex = LWP_MUTEX_NULL;
+static cond_t workcond = LWP_COND_NULL;
+static cond_t donecond = LWP_COND_NULL;
+static bool recquit = false;
+
+static FILE *videofp = NULL;
+static FILE *audiofp = NULL;
+static u32 audioBytes = 0;
+static u32 framesWritten = 0;
+static bool writeFailed = false;
+
+//--------------------------------------------------------------------------------
+//output (worker side)
+
+static void put32le(u8 *buf, u32 val)
+{
+	buf[0]=(u8)val;
+	buf[1]=(u8)(val>>8);
+	buf[2]=(u8)(val>>16);
+	buf[3]=(u8)(val>>24);
+}
+
+static void put16le(u8 *buf, u16 val)
+{
+	buf[0]=(u8)val;
+	buf[1]=(u8)(val>>8);
+}
+
+static bool writeWavHeader(FILE *fp, u32 dataSize)
+{
+	u8 header[44];
+	memcpy(header, "RIFF", 4);
+	put32le(header+4, 36 + dataSize);
+	memcpy(header+8, "WAVE", 4);
+	memcpy(header+12, "fmt ", 4);
+	put32le(header+16, 16);
+	put16le(header+20, 1);	// PCM
+	put16le(header+22, 2);	// Stereo
+	put32le(header+24, DESMUME_SAMPLE_RATE);
+	put32le(header+28, DESMUME_SAMPLE_RATE*2*2);
+	put16le(header+32, 2*2);
+	put16le(header+34, 16);
+	memcpy(header+36, "data", 4);
+	put32le(header+40, dataSize);
+
+	return fwrite(header,44,1,fp)==1;
+}
+
+static void swapToLE(u16 *buf, u32 count)
+{
+#ifdef __BIG_ENDIAN__
+	for(u32 i=0;i<count;i++)
+		buf[i] = LOCAL_TO_LE_16(buf[i]);
+#endif
+}
+
+static bool writeFrame(RecordFrame &frame)
+{
+	//the pool buffer is ours until it is handed back, so it is swapped in place
+	swapToLE((u16*)frame.samples, frame.numSamples*2);
+
+	if(frame.hasVideo)
+	{
+		swapToLE(frame.pixels, REC_PIXELS);
+		if(fwrite(frame.pixels, sizeof(frame.pixels), 1, videofp) != 1)
+			return false;
+	}
+	if(frame.numSamples && fwrite(frame.samples, frame.numSamples*2*2, 1, audiofp) != 1)
+		return false;
+
+	audioBytes += frame.numSamples*2*2;
+	return true;
+}
+
+static void *record_thread(void*)
+{
+	LWP_MutexLock(recmutex);
+	for(;;)
+	{
+		while(!queueCount && !recquit)
+			LWP_CondWait(workcond, recmutex);
+		if(!queueCount) break;
+
+		const int frame = queue[queueHead];
+		const bool hasVideo = frames[frame].hasVideo;
+		LWP_MutexUnlock(recmutex);
+
+		//once a write has failed the rest of the recording is dropped, but the frames keep
+		//getting recycled so the core never stalls on a full card
+		if(!writeFailed && !writeFrame(frames[frame]))
+		{
+			printf("Record: write failed, recording stopped after %u frames\n", framesWritten);
+			writeFailed = true;
+		}
+
+		LWP_MutexLock(recmutex);
+		if(!writeFailed && hasVideo) framesWritten++;
+		queueHead = (queueHead+1) % RECORD_POOL_SIZE;
+		queueCount--;
+		freeFrames[freeCount++] = frame;
+		LWP_CondSignal(donecond);
+	}
+	LWP_MutexUnlock(recmutex);
+
+	return NULL;
+}
+
+//--------------------------------------------------------------------------------
+//submission (emulation side)
+
+static int Record_AcquireFrame()
+{
+	LWP_MutexLock(recmutex);
+	//back-pressure: the recording is lossless, so the core waits for the worker instead of dropping
+	while(!freeCount)
+		LWP_CondWait(donecond, recmutex);
+	const int frame = freeFrames[--freeCount];
+	LWP_MutexUnlock(recmutex);
+
+	frames[frame].numSamples = 0;
+	return frame;
+}
+
+//hands the current frame to the worker and starts filling a new one
+static void Record_QueueCurrent(bool hasVideo)
+{
+	frames[current].hasVideo = hasVideo;
+
+	LWP_MutexLock(recmutex);
+	queue[(queueHead+queueCount) % RECORD_POOL_SIZE] = current;
+	queueCount++;
+	LWP_CondSignal(workcond);
+	LWP_MutexUnlock(recmutex);
+
+	current = Record_AcquireFrame();
+}
+
+bool Record_Begin(const char *basename)
+{
+	Record_End();
+	if(!basename) return false;
+
+	char fname[MAX_PATH];
+	snprintf(fname, MAX_PATH, "%s.rgb", basename);
+	videofp = fopen(fname, "wb");
+	snprintf(fname, MAX_PATH, "%s.wav", basename);
+	audiofp = fopen(fname, "wb");
+	frames = (RecordFrame*)malloc(sizeof(RecordFrame)*RECORD_POOL_SIZE);
+
+	if(!videofp || !audiofp || !frames || !writeWavHeader(audiofp, 0))
+	{
+		if(videofp) fclose(videofp);
+		if(audiofp) fclose(audiofp);
+		free(frames);
+		videofp = audiofp = NULL;
+		frames = NULL;
+		return false;
+	}
+
+	queueHead = queueCount = 0;
+	for(int i=0;i<RECORD_POOL_SIZE;i++)
+		freeFrames[i] = i;
+	freeCount = RECORD_POOL_SIZE;
+	audioBytes = 0;
+	framesWritten = 0;
+	writeFailed = false;
+	recquit = false;
+
+	if (recmutex == LWP_MUTEX_NULL)
+		LWP_MutexInit(&recmutex, false);
+	if (workcond == LWP_COND_NULL)
+		LWP_CondInit(&workcond);
+	if (donecond == LWP_COND_NULL)
+		LWP_CondInit(&donecond);
+
+	//below the emulation thread, so the card writes only use otherwise idle time
+	LWP_CreateThread(&recthread, record_thread, NULL, NULL, 0, 40);
+
+	current = Record_AcquireFrame();
+	return true;
+}
+
+void Record_End()
+{
+	if(recthread == LWP_THREAD_NULL) return;
+
+	//the partially filled frame is dropped; its samples belong to a frame that was never shown
+	current = -1;
+
+	//the worker drains the queue before it sees the quit flag
+	LWP_MutexLock(recmutex);
+	recquit = true;
+	LWP_CondSignal(workcond);
+	LWP_MutexUnlock(recmutex);
+	LWP_JoinThread(recthread, NULL);
+	recthread = LWP_THREAD_NULL;
+
+	fclose(videofp);
+	fseek(audiofp, 0, SEEK_SET);
+	writeWavHeader(audiofp, audioBytes);
+	fclose(audiofp);
+	videofp = audiofp = NULL;
+
+	free(frames);
+	frames = NULL;
+
+	printf("Record: %u frames written\n", framesWritten);
+}
+
+bool Record_IsActive()
+{
+	return current >= 0;
+}
+
+u32 Record_FrameCount()
+{
+	return framesWritten;
+}
+
+void Record_SoundUpdate(const s16 *samples, int numSamples)
+{
+	if(current < 0 || numSamples <= 0) return;
+
+	for(;;)
+	{
+		RecordFrame &frame = frames[current];
+		u32 room = RECORD_MAX_FRAME_SAMPLES - frame.numSamples;
+		u32 count = (u32)numSamples < room ? (u32)numSamples : room;
+		memcpy(frame.samples + frame.numSamples*2, samples, count*2*2);
+		frame.numSamples += count;
+
+		samples += count*2;
+		numSamples -= count;
+		if(!numSamples) break;
+
+		//more samples than fit into one frame, e.g. from a long mixing block.
+		//the full block goes out ahead of the frame as audio only, so nothing is dropped and the order holds
+		Record_QueueCurrent(false);
+	}
+}
+
+void Record_FrameEnded()
+{
+	if(current < 0) return;
+
+	memcpy(frames[current].pixels, GPU_screen, sizeof(frames[current].pixels));
+	Record_QueueCurrent(true);
+}
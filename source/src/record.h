@@ -0,0 +1,56 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _RECORD_H_
+#define _RECORD_H_
+
+#include "types.h"
+
+//lossless audio/video recording of the emulated frames.
+//the core hands over both screens and the exact SPU_core sample block of every frame;
+//a worker thread does the byte swapping and all of the file output.
+//
+//Record_Begin("sd:/rec/movie") writes
+//  movie.rgb - raw video, 256x384 bgr555le, one frame after the other
+//  movie.wav - 16 bit stereo PCM at DESMUME_SAMPLE_RATE
+//frame N of the video and the samples produced while emulating it are always written together,
+//so the streams stay aligned. e.g.
+//  ffmpeg -f rawvideo -pix_fmt bgr555le -s 256x384 -r 59.8261 -i movie.rgb -i movie.wav out.mkv
+
+//number of frames which may be waiting for the worker. the core blocks when they are all in use
+#define RECORD_POOL_SIZE 8
+
+//more than the ~803 samples a frame produces at 48khz, to leave room for rounding.
+//should a frame produce more, the excess goes out in extra audio only blocks ahead of it
+#define RECORD_MAX_FRAME_SAMPLES 1024
+
+bool Record_Begin(const char *basename);
+void Record_End();
+bool Record_IsActive();
+
+//number of frames written so far
+u32 Record_FrameCount();
+
+//called by the core with every block of samples mixed by SPU_Emulate_core
+void Record_SoundUpdate(const s16 *samples, int numSamples);
+
+//called by the core at the end of every emulated frame
+void Record_FrameEnded();
+
+#endif
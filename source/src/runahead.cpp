@@ -0,0 +1,85 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>
+
+#include "types.h"
+#include "NDSSystem.h"
+#include "GPU.h"
+#include "emufile.h"
+#include "saves.h"
+#include "gfx3d.h"
+#include "cputrace.h"
+#include "guestprofiler.h"
+#include "runahead.h"
+
+//grows to the size of a state on the first frame and is reused from then on
+static EMUFILE_MEMORY *snapshot = NULL;
+
+//the frame to be shown, kept aside while the snapshot restore puts the real GPU_screen back
+static CACHE_ALIGN u8 shown[sizeof(GPU_screen)];
+
+void RunAhead_Exec(int frames)
+{
+	//instruction level hooks can't tell speculative frames apart, so they get the plain path
+	if(frames <= 0 || cpuTraceActive || guestProfilerActive)
+	{
+		NDS_exec<TRUE>();
+		return;
+	}
+	if(frames > RUNAHEAD_MAX_FRAMES)
+		frames = RUNAHEAD_MAX_FRAMES;
+
+	if(!snapshot)
+		snapshot = new EMUFILE_MEMORY();
+
+	//the picture shown at the end of a frame is the 2D drawn during it over the 3D scene rendered at the end
+	//of the frame before. so of the speculative frames only the last draws 2D and only the one before it
+	//renders 3D. the real frame always renders its 3D: the converted buffers and the pending draw go into
+	//the snapshot, and the next real frame's display capture and 3D layer read them.
+	//frames with a display capture on draw their 2D regardless, the capture is part of the state
+	NDS_ForceFrameSkip(true, false);
+	NDS_exec<TRUE>();
+
+	if(!savestate_snapshot(snapshot))
+		return;
+
+	//the converted 3D buffers go into the snapshot, so once it is restored they hold the real frame's render again
+	GFX3D_RenderReuse reuse;
+	gfx3d_GetRenderReuse(reuse);
+
+	NDS_SetSpeculative(true);
+	for(int i=1;i<=frames;i++)
+	{
+		NDS_ForceFrameSkip(i != frames, i != frames-1);
+		NDS_exec<TRUE>();
+	}
+
+	memcpy(shown, GPU_screen, sizeof(GPU_screen));
+	if(savestate_restore(snapshot))
+		gfx3d_SetRenderReuse(reuse);
+	NDS_SetSpeculative(false);
+	memcpy(GPU_screen, shown, sizeof(GPU_screen));
+}
+
+void RunAhead_Free()
+{
+	delete snapshot;
+	snapshot = NULL;
+}
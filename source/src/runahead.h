@@ -0,0 +1,40 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _RUNAHEAD_H_
+#define _RUNAHEAD_H_
+
+#include "types.h"
+
+//run-ahead input latency reduction.
+//each frame is emulated for real (heard, not shown), snapshotted in memory, and then the emulation runs
+//a few frames further with the same input. the last of those is what ends up in GPU_screen; afterwards
+//the snapshot is restored. a game which reacts to input a frame or two late appears to react at once.
+//every host frame costs frames+1 emulated frames, but only one of them is drawn
+
+#define RUNAHEAD_MAX_FRAMES 4
+
+//emulates one frame like NDS_exec<TRUE>, running ahead by the given number of frames.
+//with 0, or while a trace or the guest profiler is running, it is a plain NDS_exec
+void RunAhead_Exec(int frames);
+
+//releases the snapshot buffer
+void RunAhead_Free();
+
+#endif
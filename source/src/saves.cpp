@@ -50,6 +50,7 @@
 #include "MMU_timing.h"
 
 #include "path.h"
+#include "addons.h"
 
 #ifdef _WINDOWS
 #include "windows/main.h"
@@ -261,7 +262,7 @@ SFORMAT SF_MOVIE[]={
 
 static void mmu_savestate(EMUFILE* os)
 {
-	u32 version = 3;
+	u32 version = 4;
 	write32le(version,os);
 	
 	//version 2:
@@ -279,6 +280,9 @@ static void mmu_savestate(EMUFILE* os)
 	MMU_timing.arm7dataFetch.savestate(os, version);
 	MMU_timing.arm9codeCache.savestate(os, version);
 	MMU_timing.arm9dataCache.savestate(os, version);
+
+	//version 4:
+	MMU_timing.arm9writeBuffer.savestate(os, version);
 }
 
 SFORMAT SF_WIFI[]={
@@ -442,6 +446,21 @@ static bool mmu_loadstate(EMUFILE* is, int size)
 	ok &= MMU_timing.arm9codeCache.loadstate(is, version);
 	ok &= MMU_timing.arm9dataCache.loadstate(is, version);
 
+	if(version < 4)
+	{
+		//the caches start cold, but their replacement mode and lockdown still follow from the cp15,
+		//which was loaded before this chunk
+		const armcp15_t *cp15 = (armcp15_t *)NDS_ARM9.coproc[15];
+		MMU_timing.arm9codeCache.SetRoundRobin(BIT14(cp15->ctrl));
+		MMU_timing.arm9dataCache.SetRoundRobin(BIT14(cp15->ctrl));
+		MMU_timing.arm9codeCache.SetLockdown(cp15->IcacheLock);
+		MMU_timing.arm9dataCache.SetLockdown(cp15->DcacheLock);
+		MMU_timing.arm9writeBuffer.Reset();
+		return ok;
+	}
+
+	ok &= MMU_timing.arm9writeBuffer.loadstate(is, version);
+
 	return ok;
 }
 
@@ -539,6 +558,9 @@ static bool cp15_loadone(armcp15_t *cp15, EMUFILE* is)
     for(int i=0;i<8;i++) if(!read32le(&cp15->regionExecuteSet_USR[i],is)) return false;
     for(int i=0;i<8;i++) if(!read32le(&cp15->regionExecuteSet_SYS[i],is)) return false;
 
+	//the page rights tables aren't saved, rebuild them from the registers
+	armcp15_maskPrecalc(cp15);
+
     return true;
 }
 
@@ -773,21 +795,8 @@ static bool ReadStateChunk(EMUFILE* is, const SFORMAT *sf, int size)
 
 		if((tmp=CheckS(guessSF,sf,sz,count,toa)))
 		{
-		#ifdef LOCAL_LE
-			// no need to ever loop one at a time if not flipping byte order
-			is->fread((char *)tmp->v,sz*count);
-		#else
-			if(sz == 1) {
-				//special case: read a huge byte array
-				is->fread((char *)tmp->v,count);
-			} else {
-				for(unsigned int i=0;i<count;i++)
-				{
-					is->fread((char *)tmp->v + i*sz,sz);
-                    FlipByteOrder((u8*)tmp->v + i*sz,sz);
-				}
-			}
-		#endif
+			//one read for the whole entry, swapped in place afterwards
+			readArrayLE(tmp->v,sz,count,is);
 			guessSF = tmp + 1;
 		}
 		else
@@ -858,22 +867,8 @@ static int SubWrite(EMUFILE* os, const SFORMAT *sf)
 			keyset.insert(sf->desc);
 			#endif
 
-		#ifdef LOCAL_LE
-			// no need to ever loop one at a time if not flipping byte order
-			os->fwrite((char *)sf->v,size*count);
-		#else
-			if(size == 1) {
-				//special case: write a huge byte array
-				os->fwrite((char *)sf->v,count);
-			} else {
-				for(int i=0;i<count;i++) {
-					FlipByteOrder((u8*)sf->v + i*size, size);
-					os->fwrite((char*)sf->v + i*size,size);
-					//Now restore the original byte order.
-					FlipByteOrder((u8*)sf->v + i*size, size);
-				}
-			}
-		#endif
+			//swapped through a bounce buffer, so the live state is never flipped and restored
+			writeArrayLE(sf->v,size,count,os);
 		}
 		sf++;
 	}
@@ -945,13 +940,16 @@ bool savestate_save(EMUFILE* outstream, int compressionLevel)
 	compressionLevel = Z_NO_COMPRESSION;
 	#endif
 
-	EMUFILE_MEMORY ms;
+	//only needed for compression. uncompressed states go straight to the output stream,
+	//which keeps repeated saves into the same memory stream free of allocations
+	EMUFILE_MEMORY* ms = NULL;
 	EMUFILE* os;
 	
 	if(compressionLevel != Z_NO_COMPRESSION)
 	{
 		//generate the savestate in memory first
-		os = (EMUFILE*)&ms;
+		ms = new EMUFILE_MEMORY();
+		os = (EMUFILE*)ms;
 		writechunks(os);
 	}
 	else
@@ -971,7 +969,6 @@ bool savestate_save(EMUFILE* outstream, int compressionLevel)
 	int error = Z_OK;
 	if(compressionLevel != Z_NO_COMPRESSION)
 	{
-		cbuf = ms.buf();
 		uLongf comprlen2;
 		//worst case compression.
 		//zlib says "0.1% larger than sourceLen plus 12 bytes"
@@ -979,7 +976,7 @@ bool savestate_save(EMUFILE* outstream, int compressionLevel)
 		cbuf = new u8[comprlen];
 		// Workaround to make it compile under linux 64bit
 		comprlen2 = comprlen;
-		error = compress2(cbuf,&comprlen2,ms.buf(),len,compressionLevel);
+		error = compress2(cbuf,&comprlen2,ms->buf(),len,compressionLevel);
 		comprlen = (u32)comprlen2;
 	}
 
@@ -995,6 +992,7 @@ bool savestate_save(EMUFILE* outstream, int compressionLevel)
 	{
 		outstream->fwrite((char*)cbuf,comprlen==(u32)-1?len:comprlen);
 		delete[] cbuf;
+		delete ms;
 	}
 
 	return error == Z_OK;
@@ -1021,6 +1019,10 @@ bool savestate_save (const char *file_name)
 
 extern SFORMAT SF_RTC[];
 
+//set while savestate_snapshot writes. ordinary savestates leave the slot 2 pak out, as they always have,
+//but run-ahead has to roll back what its speculative frames did to the GBA save chip
+static bool writingSnapshot = false;
+
 static void writechunks(EMUFILE* os) {
 	savestate_WriteChunk(os,1,SF_ARM9);
 	savestate_WriteChunk(os,2,SF_ARM7);
@@ -1041,6 +1043,8 @@ static void writechunks(EMUFILE* os) {
 #endif	
 	savestate_WriteChunk(os,110,SF_WIFI);
 	savestate_WriteChunk(os,120,SF_RTC);
+	if(writingSnapshot)
+		savestate_WriteChunk(os,130,addons_savestate);
 	savestate_WriteChunk(os,0xFFFFFFFF,(SFORMAT*)0);
 }
 
@@ -1067,9 +1071,7 @@ static bool ReadStateChunks(EMUFILE* is, s32 totalsize)
 			case 7: if(!gpu_loadstate(is,size)) ret=false; break;
 			case 8: if(!spu_loadstate(is,size)) ret=false; break;
 			case 81: if(!mic_loadstate(is,size)) ret=false; break;
-#ifdef _MOVIETIME_
 			case 90: if(!ReadStateChunk(is,SF_GFX3D,size)) ret=false; break;
-#endif
 			case 91: if(!gfx3d_loadstate(is,size)) ret=false; break;
 #ifdef _MOVIETIME_
 			case 100: if(!ReadStateChunk(is,SF_MOVIE, size)) ret=false; break;
@@ -1077,6 +1079,7 @@ static bool ReadStateChunks(EMUFILE* is, s32 totalsize)
 #endif			
 			case 110: if(!ReadStateChunk(is,SF_WIFI,size)) ret=false; break;
 			case 120: if(!ReadStateChunk(is,SF_RTC,size)) ret=false; break;
+			case 130: if(!addons_loadstate(is,size)) ret=false; break;
 			default:
 				ret=false;
 				break;
@@ -1116,6 +1119,10 @@ static void loadstate()
 
 	SetupMMU(nds.debugConsole);
 
+	// the pending irq masks are not saved, they follow from IE/IF/IME
+	NDS_UpdateIRQ(ARMCPU_ARM9);
+	NDS_UpdateIRQ(ARMCPU_ARM7);
+
 	execute = 1;//!driver->EMU_IsEmulationPaused();
 }
 
@@ -1135,13 +1142,16 @@ bool savestate_load(EMUFILE* is)
 
 	if(ssversion != SAVESTATE_VERSION) return false;
 
-	std::vector<u8> buf(len);
+	//compressed states are inflated into buf. uncompressed ones are read straight from the stream,
+	//once it is known to hold the whole state, so nothing is copied or allocated for them
+	std::vector<u8> buf;
 
 	if(comprlen != 0xFFFFFFFF) {
 #ifndef HAVE_LIBZ
 		//without libz, we can't decompress this savestate
 		return false;
 #endif
+		buf.resize(len);
 		std::vector<char> cbuf(comprlen);
 		is->fread(&cbuf[0],comprlen);
 		if(is->fail()) return false;
@@ -1153,7 +1163,7 @@ bool savestate_load(EMUFILE* is)
 			return false;
 #endif
 	} else {
-		is->fread((char*)&buf[0],len-32);
+		if(len < 32 || is->size() - is->ftell() < (int)(len-32)) return false;
 	}
 
 	//GO!! READ THE SAVESTATE
@@ -1177,8 +1187,14 @@ bool savestate_load(EMUFILE* is)
 	//gpu3D->NDS_3D_Reset();
 	//SPU_Reset();
 
-	EMUFILE_MEMORY mstemp(&buf);
-	bool x = ReadStateChunks(&mstemp,(s32)len);
+	bool x;
+	if(comprlen != 0xFFFFFFFF)
+	{
+		EMUFILE_MEMORY mstemp(&buf);
+		x = ReadStateChunks(&mstemp,(s32)len);
+	}
+	else
+		x = ReadStateChunks(is,(s32)len);
 
 	if(!x && !SAV_silent_fail_flag)
 	{
@@ -1207,6 +1223,24 @@ bool savestate_load(const char *file_name)
 	return savestate_load(&f);
 }
 
+bool savestate_snapshot(EMUFILE_MEMORY* ms)
+{
+	//savestate_save writes the header last, at the start, so whatever ms held before is simply overwritten
+	writingSnapshot = true;
+	bool ok = savestate_save(ms, Z_NO_COMPRESSION);
+	writingSnapshot = false;
+	return ok;
+}
+
+bool savestate_restore(EMUFILE_MEMORY* ms)
+{
+	ms->fseek(32, SEEK_SET);
+	if(!ReadStateChunks(ms,ms->size()-32))
+		return false;
+	loadstate();
+	return true;
+}
+
 static std::stack<EMUFILE_MEMORY*> rewindFreeList;
 static std::vector<EMUFILE_MEMORY*> rewindbuffer;
 
@@ -1254,10 +1288,7 @@ void dorewind()
 	printf("%d", size);
 
 	EMUFILE_MEMORY* loadms = rewindbuffer[size-1];
-	loadms->fseek(32, SEEK_SET);
-
-	ReadStateChunks(loadms,loadms->size()-32);
-	loadstate();
+	savestate_restore(loadms);
 
 	if(rewindbuffer.size()>1)
 	{
@@ -70,6 +70,12 @@ void loadstate_slot(int num);
 bool savestate_load(class EMUFILE* is);
 bool savestate_save(class EMUFILE* outstream, int compressionLevel);
 
+//in-session snapshots, as used by rewind and run-ahead: uncompressed, written over the previous contents
+//of ms, and restored without the full emulator reset savestate_load does. once ms has grown to the size
+//of a state neither allocates. only for states taken by this same session
+bool savestate_snapshot(class EMUFILE_MEMORY* ms);
+bool savestate_restore(class EMUFILE_MEMORY* ms);
+
 void dorewind();
 void rewindsave();
 
@@ -0,0 +1,377 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <gccore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "types.h"
+#include "GPU.h"
+#include "screenshot.h"
+
+#define SHOT_WIDTH 256
+#define SHOT_HEIGHT (192*2)
+#define SHOT_ROWBYTES (SHOT_WIDTH*3)
+#define SHOT_FILTERED_SIZE ((SHOT_ROWBYTES+1)*SHOT_HEIGHT)
+
+struct ScreenshotJob
+{
+	u16 pixels[SHOT_WIDTH*SHOT_HEIGHT];
+	char fname[MAX_PATH];
+};
+
+static ScreenshotJob *jobs = NULL;
+
+//jobs waiting for the worker, in submission order, and the unused ones
+static int queue[SCREENSHOT_POOL_SIZE];
+static int queueHead, queueCount;
+static int freeJobs[SCREENSHOT_POOL_SIZE];
+static int freeCount;
+static int busyCount;
+
+static lwp_t shotthread = LWP_THREAD_NULL;
+static mutex_t shotmutex = LWP_MUTEX_NULL;
+static cond_t workcond = LWP_COND_NULL;
+static cond_t donecond = LWP_COND_NULL;
+static bool shotquit = false;
+
+static int compressionLevel = Z_DEFAULT_COMPRESSION;
+
+//worker buffers
+static u8 *filtered = NULL;
+static u8 *compressed = NULL;
+static uLong compressedCapacity = 0;
+
+//5 to 8 bit colour expansion, replicating the high bits so that 31 maps to 255
+static u8 expand5[32];
+
+static struct
+{
+	bool active;
+	char fmt[MAX_PATH];
+	u32 every;
+	u32 frame;
+	u32 sequence;
+} frameDump;
+
+//--------------------------------------------------------------------------------
+//encoding (worker side)
+
+static void convertRow(const u16 *src, u8 *dst)
+{
+	for(int x=0;x<SHOT_WIDTH;x++)
+	{
+		const u16 pixel = src[x];
+		dst[0] = expand5[pixel & 0x1F];
+		dst[1] = expand5[(pixel>>5) & 0x1F];
+		dst[2] = expand5[(pixel>>10) & 0x1F];
+		dst += 3;
+	}
+}
+
+static FORCEINLINE u8 paeth(int a, int b, int c)
+{
+	const int p = a + b - c;
+	const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if(pa <= pb && pa <= pc) return a;
+	if(pb <= pc) return b;
+	return c;
+}
+
+static FORCEINLINE u32 filterCost(const u8 *row)
+{
+	//the usual heuristic: smallest sum of the bytes taken as signed deltas
+	u32 sum = 0;
+	for(int i=0;i<SHOT_ROWBYTES;i++)
+		sum += abs((s8)row[i]);
+	return sum;
+}
+
+//tries all five PNG filters on a row and stores the cheapest, with its type byte, at out
+static void filterRow(const u8 *cur, const u8 *prev, u8 *out)
+{
+	static u8 candidates[5][SHOT_ROWBYTES];
+	static const u8 zeros[SHOT_ROWBYTES] = {0};
+	if(!prev) prev = zeros;
+
+	for(int i=0;i<SHOT_ROWBYTES;i++)
+	{
+		const int a = (i >= 3) ? cur[i-3] : 0;
+		const int b = prev[i];
+		const int c = (i >= 3) ? prev[i-3] : 0;
+		candidates[0][i] = cur[i];
+		candidates[1][i] = cur[i] - a;
+		candidates[2][i] = cur[i] - b;
+		candidates[3][i] = cur[i] - ((a + b) >> 1);
+		candidates[4][i] = cur[i] - paeth(a,b,c);
+	}
+
+	int best = 0;
+	u32 bestCost = filterCost(candidates[0]);
+	for(int f=1;f<5;f++)
+	{
+		const u32 cost = filterCost(candidates[f]);
+		if(cost < bestCost) { bestCost = cost; best = f; }
+	}
+
+	out[0] = best;
+	memcpy(out+1, candidates[best], SHOT_ROWBYTES);
+}
+
+static void en32msb(u8 *buf, u32 val)
+{
+	buf[0]=(u8)(val>>24);
+	buf[1]=(u8)(val>>16);
+	buf[2]=(u8)(val>>8);
+	buf[3]=(u8)val;
+}
+
+static bool writeChunk(FILE *fp, u32 size, const char *type, const u8 *data)
+{
+	u8 tempo[4];
+
+	en32msb(tempo,size);
+	if(fwrite(tempo,4,1,fp)!=1) return false;
+	if(fwrite(type,4,1,fp)!=1) return false;
+	if(size && fwrite(data,1,size,fp)!=size) return false;
+
+	u32 crc = crc32(0,(const u8 *)type,4);
+	if(size)
+		crc = crc32(crc,data,size);
+
+	en32msb(tempo,crc);
+	return fwrite(tempo,4,1,fp)==1;
+}
+
+static bool encodePNG(const ScreenshotJob &job, int level)
+{
+	static u8 rows[2][SHOT_ROWBYTES];
+
+	for(int y=0;y<SHOT_HEIGHT;y++)
+	{
+		u8 *cur = rows[y&1];
+		convertRow(job.pixels + y*SHOT_WIDTH, cur);
+		filterRow(cur, y ? rows[(y-1)&1] : NULL, filtered + y*(SHOT_ROWBYTES+1));
+	}
+
+	uLongf compressedSize = compressedCapacity;
+	if(compress2(compressed, &compressedSize, filtered, SHOT_FILTERED_SIZE, level) != Z_OK)
+		return false;
+
+	FILE *fp = fopen(job.fname, "wb");
+	if(!fp) return false;
+
+	static const u8 header[8]={137,80,78,71,13,10,26,10};
+	u8 ihdr[13];
+	en32msb(ihdr,SHOT_WIDTH);
+	en32msb(ihdr+4,SHOT_HEIGHT);
+	ihdr[8] = 8;	// 8 bits per sample(24 bits per pixel)
+	ihdr[9] = 2;	// Color type; RGB triplet
+	ihdr[10] = 0;	// compression: deflate
+	ihdr[11] = 0;	// Basic adaptive filter set
+	ihdr[12] = 0;	// No interlace.
+
+	bool ok = fwrite(header,8,1,fp)==1
+		&& writeChunk(fp,13,"IHDR",ihdr)
+		&& writeChunk(fp,compressedSize,"IDAT",compressed)
+		&& writeChunk(fp,0,"IEND",NULL);
+
+	fclose(fp);
+	return ok;
+}
+
+static void *screenshot_thread(void*)
+{
+	LWP_MutexLock(shotmutex);
+	for(;;)
+	{
+		while(!queueCount && !shotquit)
+			LWP_CondWait(workcond, shotmutex);
+		if(!queueCount) break;
+
+		const int job = queue[queueHead];
+		queueHead = (queueHead+1) % SCREENSHOT_POOL_SIZE;
+		queueCount--;
+		busyCount++;
+		const int level = compressionLevel;
+		LWP_MutexUnlock(shotmutex);
+
+		if(!encodePNG(jobs[job], level))
+			printf("Screenshot: failed to write %s\n", jobs[job].fname);
+
+		LWP_MutexLock(shotmutex);
+		busyCount--;
+		freeJobs[freeCount++] = job;
+		LWP_CondBroadcast(donecond);
+	}
+	LWP_MutexUnlock(shotmutex);
+
+	return NULL;
+}
+
+//--------------------------------------------------------------------------------
+//submission (emulation side)
+
+static bool Screenshot_Init()
+{
+	if(shotthread != LWP_THREAD_NULL) return true;
+
+	for(int i=0;i<32;i++)
+		expand5[i] = (i<<3) | (i>>2);
+
+	compressedCapacity = compressBound(SHOT_FILTERED_SIZE);
+	jobs = (ScreenshotJob*)malloc(sizeof(ScreenshotJob)*SCREENSHOT_POOL_SIZE);
+	filtered = (u8*)malloc(SHOT_FILTERED_SIZE);
+	compressed = (u8*)malloc(compressedCapacity);
+	if(!jobs || !filtered || !compressed)
+	{
+		free(jobs); free(filtered); free(compressed);
+		jobs = NULL; filtered = compressed = NULL;
+		return false;
+	}
+
+	queueHead = queueCount = busyCount = 0;
+	for(int i=0;i<SCREENSHOT_POOL_SIZE;i++)
+		freeJobs[i] = i;
+	freeCount = SCREENSHOT_POOL_SIZE;
+	shotquit = false;
+
+	if (shotmutex == LWP_MUTEX_NULL)
+		LWP_MutexInit(&shotmutex, false);
+	if (workcond == LWP_COND_NULL)
+		LWP_CondInit(&workcond);
+	if (donecond == LWP_COND_NULL)
+		LWP_CondInit(&donecond);
+
+	//below the emulation thread, so encoding only uses otherwise idle time
+	LWP_CreateThread(&shotthread, screenshot_thread, NULL, NULL, 0, 40);
+	return true;
+}
+
+static bool Screenshot_Queue(const char *fname)
+{
+	if(!Screenshot_Init()) return false;
+
+	LWP_MutexLock(shotmutex);
+	//back-pressure: wait for the worker rather than dropping a shot
+	while(!freeCount)
+		LWP_CondWait(donecond, shotmutex);
+	const int job = freeJobs[--freeCount];
+	LWP_MutexUnlock(shotmutex);
+
+	//the job is ours until it is queued, so the copy happens outside of the lock
+	memcpy(jobs[job].pixels, GPU_screen, sizeof(jobs[job].pixels));
+	strncpy(jobs[job].fname, fname, MAX_PATH-1);
+	jobs[job].fname[MAX_PATH-1] = 0;
+
+	LWP_MutexLock(shotmutex);
+	queue[(queueHead+queueCount) % SCREENSHOT_POOL_SIZE] = job;
+	queueCount++;
+	LWP_CondSignal(workcond);
+	LWP_MutexUnlock(shotmutex);
+
+	return true;
+}
+
+bool NDS_WritePNG(const char *fname)
+{
+	return Screenshot_Queue(fname);
+}
+
+void Screenshot_SetCompressionLevel(int level)
+{
+	if(level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION)
+		level = Z_DEFAULT_COMPRESSION;
+	if(shotmutex != LWP_MUTEX_NULL) LWP_MutexLock(shotmutex);
+	compressionLevel = level;
+	if(shotmutex != LWP_MUTEX_NULL) LWP_MutexUnlock(shotmutex);
+}
+
+void Screenshot_Flush()
+{
+	if(shotthread == LWP_THREAD_NULL) return;
+
+	LWP_MutexLock(shotmutex);
+	while(queueCount || busyCount)
+		LWP_CondWait(donecond, shotmutex);
+	LWP_MutexUnlock(shotmutex);
+}
+
+void Screenshot_Shutdown()
+{
+	FrameDump_Stop();
+	if(shotthread == LWP_THREAD_NULL) return;
+
+	//the worker drains the queue before it sees the quit flag
+	LWP_MutexLock(shotmutex);
+	shotquit = true;
+	LWP_CondSignal(workcond);
+	LWP_MutexUnlock(shotmutex);
+	LWP_JoinThread(shotthread, NULL);
+	shotthread = LWP_THREAD_NULL;
+
+	LWP_CondDestroy(workcond);
+	LWP_CondDestroy(donecond);
+	LWP_MutexDestroy(shotmutex);
+	workcond = donecond = LWP_COND_NULL;
+	shotmutex = LWP_MUTEX_NULL;
+
+	free(jobs); free(filtered); free(compressed);
+	jobs = NULL; filtered = compressed = NULL;
+}
+
+//--------------------------------------------------------------------------------
+//frame dumps
+
+bool FrameDump_Start(const char *fmt, u32 everyNthFrame)
+{
+	if(!fmt || !Screenshot_Init()) return false;
+
+	strncpy(frameDump.fmt, fmt, MAX_PATH-1);
+	frameDump.fmt[MAX_PATH-1] = 0;
+	frameDump.every = everyNthFrame ? everyNthFrame : 1;
+	frameDump.frame = 0;
+	frameDump.sequence = 0;
+	frameDump.active = true;
+	return true;
+}
+
+void FrameDump_Stop()
+{
+	frameDump.active = false;
+}
+
+bool FrameDump_IsActive()
+{
+	return frameDump.active;
+}
+
+void FrameDump_FrameEnded()
+{
+	if(!frameDump.active) return;
+
+	if(++frameDump.frame < frameDump.every) return;
+	frameDump.frame = 0;
+
+	char fname[MAX_PATH];
+	snprintf(fname, MAX_PATH, frameDump.fmt, frameDump.sequence++);
+	Screenshot_Queue(fname);
+}
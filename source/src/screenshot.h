@@ -0,0 +1,53 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _SCREENSHOT_H_
+#define _SCREENSHOT_H_
+
+#include "types.h"
+
+//PNG screenshots and frame dumps of both screens.
+//the caller only copies GPU_screen into a pooled buffer; colour expansion, row filtering,
+//deflate and file output are done by a worker thread.
+
+//number of shots which may be waiting for the worker. queueing blocks while they are all in use
+#define SCREENSHOT_POOL_SIZE 4
+
+//queues a screenshot of the current framebuffer
+bool NDS_WritePNG(const char *fname);
+
+//zlib level (0-9, or -1 for zlib's default) used by the worker
+void Screenshot_SetCompressionLevel(int level);
+
+//waits until every queued shot has been written
+void Screenshot_Flush();
+
+//flushes and stops the worker
+void Screenshot_Shutdown();
+
+//dumps every Nth frame. fmt is a printf pattern taking the dump sequence number,
+//e.g. "sd:/dump/frame_%06u.png"
+bool FrameDump_Start(const char *fmt, u32 everyNthFrame);
+void FrameDump_Stop();
+bool FrameDump_IsActive();
+
+//called by the core at the end of every emulated frame
+void FrameDump_FrameEnded();
+
+#endif
@@ -203,6 +203,36 @@ static MemSpan MemSpan_TexPalette(u32 ofs, u32 len)
 	return ret;
 }
 
+//dumps a texture palette as host order colors
+static FORCEINLINE void dumpPalette(MemSpan &mspal, u16 *pal)
+{
+#ifdef WORDS_BIGENDIAN
+	mspal.dump16(pal);
+#else
+	mspal.dump(pal);
+#endif
+}
+
+//rearranges a decoded texture from rows into 4x4 tiles. both sizes are multiples of 8
+static u8* tileTexture(u8* decoded, u32 sizeX, u32 sizeY, u32 len)
+{
+	u32* src = (u32*)decoded;
+	u32* dst = (u32*)memalign(32,len);
+	u32* out = dst;
+	for(u32 y=0;y<sizeY;y+=4)
+		for(u32 x=0;x<sizeX;x+=4)
+			for(u32 ty=0;ty<4;ty++)
+			{
+				const u32* row = src + (y+ty)*sizeX + x;
+				*out++ = row[0];
+				*out++ = row[1];
+				*out++ = row[2];
+				*out++ = row[3];
+			}
+	free(decoded);
+	return (u8*)dst;
+}
+
 #if defined (DEBUG_DUMP_TEXTURE) && defined (WIN32)
 #define DO_DEBUG_DUMP_TEXTURE
 static void DebugDumpTexture(TexCacheItem* item)
@@ -301,16 +331,11 @@ public:
 		}
 
 
-		//dump the palette to a temp buffer, so that we don't have to worry about memory mapping.
+		//the palette is dumped to a temp buffer, so that we don't have to worry about memory mapping.
 		//this isnt such a problem with texture memory, because we read sequentially from it.
 		//however, we read randomly from palette memory, so the mapping is more costly.
-		#ifdef WORDS_BIGENDIAN
-			mspal.dump16(pal);
-		#else
-			mspal.dump(pal);
-		#endif
-
-			//TODO - as a special optimization, keep the last item returned and check it first
+		//a valid cached item needs no palette at all, so the dump waits until something compares or decodes it
+		bool palDumped = false;
 
 		for(std::pair<TTexCacheItemMultimap::iterator,TTexCacheItemMultimap::iterator>
 			iters = index.equal_range(format);
@@ -337,7 +362,12 @@ public:
 			//note that we are considering 4x4 textures to have a palette size of 0.
 			//they really have a potentially HUGE palette, too big for us to handle like a normal palette,
 			//so they go through a different system
-			if(mspal.size != 0 && memcmp(curr->dump.palette,pal,mspal.size)) goto REJECT;
+			if(mspal.size != 0)
+			{
+				dumpPalette(mspal,pal);
+				palDumped = true;
+				if(memcmp(curr->dump.palette,pal,mspal.size)) goto REJECT;
+			}
 
 			//when the texture data doesn't match
 			if(ms.memcmp(&curr->dump.texture[0],curr->dump.textureSize)) goto REJECT;
@@ -386,6 +416,7 @@ public:
 		//dump palette data for cache keying
 		if(palSize)
 		{
+			if(!palDumped) dumpPalette(mspal,pal);
 			memcpy(newitem->dump.palette, pal, palSize*2);
 		}
 
@@ -657,6 +688,13 @@ public:
 			}
 		} //switch(texture format)
 
+		//only the software rasterizer samples from the decoded data; the gx renderer uploads it as is
+		if(TEXFORMAT == TexFormat_15bpp && CommonSettings.GFX3D_TiledTextures && imageSize >= TEXCACHE_TILED_MIN_TEXELS)
+		{
+			newitem->decoded = tileTexture(newitem->decoded,sizeX,sizeY,newitem->decode_len);
+			newitem->tiled = true;
+		}
+
 #ifdef DO_DEBUG_DUMP_TEXTURE
 	DebugDumpTexture(newitem);
 #endif
@@ -30,6 +30,17 @@ enum TexCache_TexFormat
 	TexFormat_15bpp //used by rasterizer
 };
 
+//decoded rasterizer textures of at least this many texels are stored in 4x4 texel tiles (64 bytes, two
+//cache lines) rather than row by row. a poly rotated or seen at an angle walks the texture diagonally,
+//which in a linear layout touches a new cache line for nearly every texel once rows get long
+#define TEXCACHE_TILED_MIN_TEXELS (128*128)
+
+//index of texel (u,v) in a tiled texture whose width is 1<<wshift
+FORCEINLINE u32 TexCache_TiledIndex(u32 u, u32 v, u32 wshift)
+{
+	return ((v&~3)<<wshift) + ((u&~3)<<2) + ((v&3)<<2) + (u&3);
+}
+
 class TexCacheItem;
 
 typedef std::multimap<u32,TexCacheItem*> TTexCacheItemMultimap;
@@ -41,6 +52,7 @@ public:
 		: decode_len(0)
 		, decoded(NULL)
 		, suspectedInvalid(false)
+		, tiled(false)
 		, deleteCallback(NULL)
 		, cacheFormat(TexFormat_None)
 	{}
@@ -55,6 +67,7 @@ public:
 	u32 mode;
 	u8* decoded; //decoded texture data
 	bool suspectedInvalid;
+	bool tiled; //decoded is laid out in tiles, see TexCache_TiledIndex
 	TTexCacheItemMultimap::iterator iterator;
 
 	u32 texformat, texpal;
@@ -26,6 +26,7 @@
 // 
 
 #include "bios.h"
+#include "cp15.h"
 #include "debug.h"
 #include "MMU.h"
 #include "NDSSystem.h"
@@ -55,8 +56,7 @@ TEMPLATE static  u32 FASTCALL OP_UND_THUMB(const u32 i)
 TEMPLATE static  u32 FASTCALL OP_LSL_0(const u32 i)
 {
 	cpu->R[REG_NUM(i, 0)] = cpu->R[REG_NUM(i, 3)];
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0);
 
 	return 1;
 }
@@ -64,10 +64,9 @@ TEMPLATE static  u32 FASTCALL OP_LSL_0(const u32 i)
 TEMPLATE static  u32 FASTCALL OP_LSL(const u32 i)
 {
 	u32 v = (i>>6) & 0x1F;
-	cpu->CPSR.bits.C = BIT_N(cpu->R[REG_NUM(i, 3)], 32-v);
+	const u32 c = BIT_N(cpu->R[REG_NUM(i, 3)], 32-v);
 	cpu->R[REG_NUM(i, 0)] = (cpu->R[REG_NUM(i, 3)] << v);
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+	armcpu_setNZC(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0, c);
 
 	return 1;
 }
@@ -78,26 +77,19 @@ TEMPLATE static  u32 FASTCALL OP_LSL_REG(const u32 i)
 
 	if(v == 0)
 	{
-		cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-		cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+		armcpu_setNZ(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0);
 		return 2;
 	}	
 	if(v<32)
 	{
-		cpu->CPSR.bits.C = BIT_N(cpu->R[REG_NUM(i, 0)], 32-v);
+		const u32 c = BIT_N(cpu->R[REG_NUM(i, 0)], 32-v);
 		cpu->R[REG_NUM(i, 0)] <<= v;
-		cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-		cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+		armcpu_setNZC(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0, c);
 		return 2;
 	}
-	if(v==32)
-		cpu->CPSR.bits.C = BIT0(cpu->R[REG_NUM(i, 0)]);
-	else
-		cpu->CPSR.bits.C = 0;
-
+	const u32 c = (v==32) ? BIT0(cpu->R[REG_NUM(i, 0)]) : 0;
 	cpu->R[REG_NUM(i, 0)] = 0;
-	cpu->CPSR.bits.N = 0;
-	cpu->CPSR.bits.Z = 1;
+	armcpu_setNZC(cpu, 0, 1, c);
 
 	return 2;
 }
@@ -108,10 +100,9 @@ TEMPLATE static  u32 FASTCALL OP_LSL_REG(const u32 i)
 
 TEMPLATE static  u32 FASTCALL OP_LSR_0(const u32 i)
 {
-	cpu->CPSR.bits.C = BIT31(cpu->R[REG_NUM(i, 3)]);
+	const u32 c = BIT31(cpu->R[REG_NUM(i, 3)]);
 	cpu->R[REG_NUM(i, 0)] = 0;
-	cpu->CPSR.bits.N = 0;
-	cpu->CPSR.bits.Z = 1;
+	armcpu_setNZC(cpu, 0, 1, c);
 
 	return 1;
 }
@@ -119,10 +110,9 @@ TEMPLATE static  u32 FASTCALL OP_LSR_0(const u32 i)
 TEMPLATE static  u32 FASTCALL OP_LSR(const u32 i)
 {
 	u32 v = (i>>6) & 0x1F;
-	cpu->CPSR.bits.C = BIT_N(cpu->R[REG_NUM(i, 3)], v-1);
+	const u32 c = BIT_N(cpu->R[REG_NUM(i, 3)], v-1);
 	cpu->R[REG_NUM(i, 0)] = (cpu->R[REG_NUM(i, 3)] >> v);
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+	armcpu_setNZC(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0, c);
 
 	return 1;
 }
@@ -133,25 +123,19 @@ TEMPLATE static  u32 FASTCALL OP_LSR_REG(const u32 i)
 	
 	if(v == 0)
 	{
-		cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-		cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+		armcpu_setNZ(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0);
 		return 2;
 	}	
 	if(v<32)
 	{
-		cpu->CPSR.bits.C = BIT_N(cpu->R[REG_NUM(i, 0)], v-1);
+		const u32 c = BIT_N(cpu->R[REG_NUM(i, 0)], v-1);
 		cpu->R[REG_NUM(i, 0)] >>= v;
-		cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-		cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+		armcpu_setNZC(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0, c);
 		return 2;
 	}
-	if(v==32)
-		cpu->CPSR.bits.C = BIT31(cpu->R[REG_NUM(i, 0)]);
-	else
-		cpu->CPSR.bits.C = 0;
+	const u32 c = (v==32) ? BIT31(cpu->R[REG_NUM(i, 0)]) : 0;
 	cpu->R[REG_NUM(i, 0)] = 0;
-	cpu->CPSR.bits.N = 0;
-	cpu->CPSR.bits.Z = 1;
+	armcpu_setNZC(cpu, 0, 1, c);
 	
 	return 2;
 }
@@ -162,10 +146,9 @@ TEMPLATE static  u32 FASTCALL OP_LSR_REG(const u32 i)
 
 TEMPLATE static  u32 FASTCALL OP_ASR_0(const u32 i)
 {
-	cpu->CPSR.bits.C = BIT31(cpu->R[REG_NUM(i, 3)]);
-	cpu->R[REG_NUM(i, 0)] = cpu->CPSR.bits.C * 0xFFFFFFFF;
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+	const u32 c = BIT31(cpu->R[REG_NUM(i, 3)]);
+	cpu->R[REG_NUM(i, 0)] = c * 0xFFFFFFFF;
+	armcpu_setNZC(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0, c);
 
 	return 1;
 }
@@ -173,10 +156,9 @@ TEMPLATE static  u32 FASTCALL OP_ASR_0(const u32 i)
 TEMPLATE static  u32 FASTCALL OP_ASR(const u32 i)
 {
 	u32 v = (i>>6) & 0x1F;
-	cpu->CPSR.bits.C = BIT_N(cpu->R[REG_NUM(i, 3)], v-1);
+	const u32 c = BIT_N(cpu->R[REG_NUM(i, 3)], v-1);
 	cpu->R[REG_NUM(i, 0)] = (u32)(((s32)cpu->R[REG_NUM(i, 3)]) >> v);
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+	armcpu_setNZC(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0, c);
 
 	return 1;
 }
@@ -187,23 +169,20 @@ TEMPLATE static  u32 FASTCALL OP_ASR_REG(const u32 i)
 	
 	if(v == 0)
 	{
-		cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-		cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+		armcpu_setNZ(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0);
 		return 2;
 	}	
 	if(v<32)
 	{
-		cpu->CPSR.bits.C = BIT_N(cpu->R[REG_NUM(i, 0)], v-1);
+		const u32 c = BIT_N(cpu->R[REG_NUM(i, 0)], v-1);
 		cpu->R[REG_NUM(i, 0)] = (u32)(((s32)cpu->R[REG_NUM(i, 0)]) >> v);
-		cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-		cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+		armcpu_setNZC(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0, c);
 		return 2;
 	}
 	
-	cpu->CPSR.bits.C = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->R[REG_NUM(i, 0)] = cpu->CPSR.bits.C * 0xFFFFFFFF;
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+	const u32 c = BIT31(cpu->R[REG_NUM(i, 0)]);
+	cpu->R[REG_NUM(i, 0)] = c * 0xFFFFFFFF;
+	armcpu_setNZC(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0, c);
 	
 	return 2;
 }
@@ -217,10 +196,9 @@ TEMPLATE static  u32 FASTCALL OP_ADD_IMM3(const u32 i)
 	u32 a = cpu->R[REG_NUM(i, 3)];
 
 	cpu->R[REG_NUM(i, 0)] = a + REG_NUM(i, 6);
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
-	cpu->CPSR.bits.C = UNSIGNED_OVERFLOW(a, REG_NUM(i, 6), cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.V = SIGNED_OVERFLOW(a, REG_NUM(i, 6), cpu->R[REG_NUM(i, 0)]);
+	armcpu_setNZCV(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0,
+		UNSIGNED_OVERFLOW(a, REG_NUM(i, 6), cpu->R[REG_NUM(i, 0)]),
+		SIGNED_OVERFLOW(a, REG_NUM(i, 6), cpu->R[REG_NUM(i, 0)]));
 
 	return 1;
 }
@@ -228,10 +206,9 @@ TEMPLATE static  u32 FASTCALL OP_ADD_IMM3(const u32 i)
 TEMPLATE static  u32 FASTCALL OP_ADD_IMM8(const u32 i)
 {
 	u32 tmp = cpu->R[REG_NUM(i, 8)] + (i & 0xFF);
-	cpu->CPSR.bits.N = BIT31(tmp);
-	cpu->CPSR.bits.Z = tmp == 0;
-	cpu->CPSR.bits.C = UNSIGNED_OVERFLOW(cpu->R[REG_NUM(i, 8)], (i & 0xFF), tmp);
-	cpu->CPSR.bits.V = SIGNED_OVERFLOW(cpu->R[REG_NUM(i, 8)], (i & 0xFF), tmp);
+	armcpu_setNZCV(cpu, BIT31(tmp), tmp == 0,
+		UNSIGNED_OVERFLOW(cpu->R[REG_NUM(i, 8)], (i & 0xFF), tmp),
+		SIGNED_OVERFLOW(cpu->R[REG_NUM(i, 8)], (i & 0xFF), tmp));
 	cpu->R[REG_NUM(i, 8)] = tmp;
 
 	return 1;
@@ -242,10 +219,9 @@ TEMPLATE static  u32 FASTCALL OP_ADD_REG(const u32 i)
 	u32 a = cpu->R[REG_NUM(i, 3)];
 	u32 b = cpu->R[REG_NUM(i, 6)];
 	cpu->R[REG_NUM(i, 0)] = a + b;
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
-	cpu->CPSR.bits.C = UNSIGNED_OVERFLOW(a, b, cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.V = SIGNED_OVERFLOW(a, b, cpu->R[REG_NUM(i, 0)]);
+	armcpu_setNZCV(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0,
+		UNSIGNED_OVERFLOW(a, b, cpu->R[REG_NUM(i, 0)]),
+		SIGNED_OVERFLOW(a, b, cpu->R[REG_NUM(i, 0)]));
 
 	return 1;
 }
@@ -287,10 +263,9 @@ TEMPLATE static  u32 FASTCALL OP_SUB_IMM3(const u32 i)
 {
 	u32 a = cpu->R[REG_NUM(i, 3)];
 	cpu->R[REG_NUM(i, 0)] = a - REG_NUM(i, 6);
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
-	cpu->CPSR.bits.C = !UNSIGNED_UNDERFLOW(a, REG_NUM(i, 6), cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.V = SIGNED_UNDERFLOW(a, REG_NUM(i, 6), cpu->R[REG_NUM(i, 0)]);
+	armcpu_setNZCV(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0,
+		!UNSIGNED_UNDERFLOW(a, REG_NUM(i, 6), cpu->R[REG_NUM(i, 0)]),
+		SIGNED_UNDERFLOW(a, REG_NUM(i, 6), cpu->R[REG_NUM(i, 0)]));
 
 	return 1;
 }
@@ -298,10 +273,9 @@ TEMPLATE static  u32 FASTCALL OP_SUB_IMM3(const u32 i)
 TEMPLATE static  u32 FASTCALL OP_SUB_IMM8(const u32 i)
 {
 	u32 tmp = cpu->R[REG_NUM(i, 8)] - (i & 0xFF);
-	cpu->CPSR.bits.N = BIT31(tmp);
-	cpu->CPSR.bits.Z = tmp == 0;
-	cpu->CPSR.bits.C = !UNSIGNED_UNDERFLOW(cpu->R[REG_NUM(i, 8)], (i & 0xFF), tmp);
-	cpu->CPSR.bits.V = SIGNED_UNDERFLOW(cpu->R[REG_NUM(i, 8)], (i & 0xFF), tmp);
+	armcpu_setNZCV(cpu, BIT31(tmp), tmp == 0,
+		!UNSIGNED_UNDERFLOW(cpu->R[REG_NUM(i, 8)], (i & 0xFF), tmp),
+		SIGNED_UNDERFLOW(cpu->R[REG_NUM(i, 8)], (i & 0xFF), tmp));
 	cpu->R[REG_NUM(i, 8)] = tmp;
 
 	return 1;
@@ -312,10 +286,9 @@ TEMPLATE static  u32 FASTCALL OP_SUB_REG(const u32 i)
 	u32 a = cpu->R[REG_NUM(i, 3)];
 	u32 b = cpu->R[REG_NUM(i, 6)];
 	cpu->R[REG_NUM(i, 0)] = a - b;
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
-	cpu->CPSR.bits.C = !UNSIGNED_UNDERFLOW(a, b, cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.V = SIGNED_UNDERFLOW(a, b, cpu->R[REG_NUM(i, 0)]);
+	armcpu_setNZCV(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0,
+		!UNSIGNED_UNDERFLOW(a, b, cpu->R[REG_NUM(i, 0)]),
+		SIGNED_UNDERFLOW(a, b, cpu->R[REG_NUM(i, 0)]));
 
 	return 1;
 }
@@ -327,8 +300,7 @@ TEMPLATE static  u32 FASTCALL OP_SUB_REG(const u32 i)
 TEMPLATE static  u32 FASTCALL OP_MOV_IMM8(const u32 i)
 {
 	cpu->R[REG_NUM(i, 8)] = (i & 0xFF);
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 8)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 8)] == 0;
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_NUM(i, 8)]), cpu->R[REG_NUM(i, 8)] == 0);
 	
 	return 1;
 }
@@ -354,10 +326,9 @@ TEMPLATE static  u32 FASTCALL OP_CMP_IMM8(const u32 i)
 {
 	u32 tmp = cpu->R[REG_NUM(i, 8)] - (i & 0xFF);
 
-	cpu->CPSR.bits.N = BIT31(tmp);
-	cpu->CPSR.bits.Z = tmp == 0;
-	cpu->CPSR.bits.C = !UNSIGNED_UNDERFLOW(cpu->R[REG_NUM(i, 8)], (i & 0xFF), tmp);
-	cpu->CPSR.bits.V = SIGNED_UNDERFLOW(cpu->R[REG_NUM(i, 8)], (i & 0xFF), tmp);
+	armcpu_setNZCV(cpu, BIT31(tmp), tmp == 0,
+		!UNSIGNED_UNDERFLOW(cpu->R[REG_NUM(i, 8)], (i & 0xFF), tmp),
+		SIGNED_UNDERFLOW(cpu->R[REG_NUM(i, 8)], (i & 0xFF), tmp));
 
 	return 1;
 }
@@ -366,10 +337,9 @@ TEMPLATE static  u32 FASTCALL OP_CMP(const u32 i)
 {
 	u32 tmp = cpu->R[REG_NUM(i, 0)] - cpu->R[REG_NUM(i, 3)];
 
-	cpu->CPSR.bits.N = BIT31(tmp);
-	cpu->CPSR.bits.Z = tmp == 0;
-	cpu->CPSR.bits.C = !UNSIGNED_UNDERFLOW(cpu->R[REG_NUM(i, 0)], cpu->R[REG_NUM(i, 3)], tmp);
-	cpu->CPSR.bits.V = SIGNED_UNDERFLOW(cpu->R[REG_NUM(i, 0)], cpu->R[REG_NUM(i, 3)], tmp);
+	armcpu_setNZCV(cpu, BIT31(tmp), tmp == 0,
+		!UNSIGNED_UNDERFLOW(cpu->R[REG_NUM(i, 0)], cpu->R[REG_NUM(i, 3)], tmp),
+		SIGNED_UNDERFLOW(cpu->R[REG_NUM(i, 0)], cpu->R[REG_NUM(i, 3)], tmp));
 	
 	return 1;
 }
@@ -380,10 +350,9 @@ TEMPLATE static  u32 FASTCALL OP_CMP_SPE(const u32 i)
 
 	u32 tmp = cpu->R[Rn] - cpu->R[REG_POS(i, 3)];
 	
-	cpu->CPSR.bits.N = BIT31(tmp);
-	cpu->CPSR.bits.Z = tmp == 0;
-	cpu->CPSR.bits.C = !UNSIGNED_UNDERFLOW(cpu->R[Rn], cpu->R[REG_POS(i, 3)], tmp);
-	cpu->CPSR.bits.V = SIGNED_UNDERFLOW(cpu->R[Rn], cpu->R[REG_POS(i, 3)], tmp);
+	armcpu_setNZCV(cpu, BIT31(tmp), tmp == 0,
+		!UNSIGNED_UNDERFLOW(cpu->R[Rn], cpu->R[REG_POS(i, 3)], tmp),
+		SIGNED_UNDERFLOW(cpu->R[Rn], cpu->R[REG_POS(i, 3)], tmp));
 	
 	return 1;
 }
@@ -395,8 +364,7 @@ TEMPLATE static  u32 FASTCALL OP_CMP_SPE(const u32 i)
 TEMPLATE static  u32 FASTCALL OP_AND(const u32 i)
 {
 	cpu->R[REG_NUM(i, 0)] &= cpu->R[REG_NUM(i, 3)];
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0);
 	return 1;
 }
 
@@ -407,8 +375,7 @@ TEMPLATE static  u32 FASTCALL OP_AND(const u32 i)
 TEMPLATE static  u32 FASTCALL OP_EOR(const u32 i)
 {
 	cpu->R[REG_NUM(i, 0)] ^= cpu->R[REG_NUM(i, 3)];
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0);
 	
 	return 1;
 }
@@ -425,9 +392,6 @@ TEMPLATE static  u32 FASTCALL OP_ADC_REG(const u32 i)
 	u32 res = a + tmp;
 
 	cpu->R[REG_NUM(i, 0)] = res;
-	
-	cpu->CPSR.bits.N = BIT31(res);
-	cpu->CPSR.bits.Z = res == 0;
 
 #if 0
 	 //the below UNSIGNED_OVERFLOW calculation is the clever way of doing it
@@ -440,8 +404,9 @@ TEMPLATE static  u32 FASTCALL OP_ADC_REG(const u32 i)
 		);
 #endif
 
-	cpu->CPSR.bits.C = UNSIGNED_OVERFLOW(b, (u32) cpu->CPSR.bits.C, tmp) | UNSIGNED_OVERFLOW(tmp, a, res);
-	cpu->CPSR.bits.V = SIGNED_OVERFLOW(b, (u32) cpu->CPSR.bits.C, tmp) | SIGNED_OVERFLOW(tmp, a, res);
+	armcpu_setNZCV(cpu, BIT31(res), res == 0,
+		UNSIGNED_OVERFLOW(b, (u32) cpu->CPSR.bits.C, tmp) | UNSIGNED_OVERFLOW(tmp, a, res),
+		SIGNED_OVERFLOW(b, (u32) cpu->CPSR.bits.C, tmp) | SIGNED_OVERFLOW(tmp, a, res));
 	
 	return 1;
 }
@@ -457,15 +422,10 @@ TEMPLATE static  u32 FASTCALL OP_SBC_REG(const u32 i)
 	u32 res = tmp - b;
 	cpu->R[REG_NUM(i, 0)] = res;
 	
-	cpu->CPSR.bits.N = BIT31(res);
-	cpu->CPSR.bits.Z = res == 0;
-
-	
 	 //zero 31-dec-2008 - apply normatt's fixed logic from the arm SBC instruction
 	 //although it seemed a bit odd to me and to whomever wrote this for SBC not to work similar to ADC..
 	 //but thats how it is.
-	 cpu->CPSR.bits.C = !UNSIGNED_UNDERFLOW(a, b, res);
-	 cpu->CPSR.bits.V = SIGNED_UNDERFLOW(a, b, res);
+	armcpu_setNZCV(cpu, BIT31(res), res == 0, !UNSIGNED_UNDERFLOW(a, b, res), SIGNED_UNDERFLOW(a, b, res));
 	
 	return 1;
 }
@@ -480,23 +440,20 @@ TEMPLATE static  u32 FASTCALL OP_ROR_REG(const u32 i)
 	
 	if(v == 0)
 	{
-			cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-			cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+			armcpu_setNZ(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0);
 			return 2;
 	}
 	
 	v &= 0x1F;
 	if(v == 0)
 	{
-			cpu->CPSR.bits.C = BIT31(cpu->R[REG_NUM(i, 0)]);
-			cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-			cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+			armcpu_setNZC(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0,
+				BIT31(cpu->R[REG_NUM(i, 0)]));
 			return 2;
 	}
-	cpu->CPSR.bits.C = BIT_N(cpu->R[REG_NUM(i, 0)], v-1);
+	const u32 c = BIT_N(cpu->R[REG_NUM(i, 0)], v-1);
 	cpu->R[REG_NUM(i, 0)] = ROR(cpu->R[REG_NUM(i, 0)], v);
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+	armcpu_setNZC(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0, c);
 	
 	return 2;
 }
@@ -508,8 +465,7 @@ TEMPLATE static  u32 FASTCALL OP_ROR_REG(const u32 i)
 TEMPLATE static  u32 FASTCALL OP_TST(const u32 i)
 {
 	u32 tmp = cpu->R[REG_NUM(i, 0)] & cpu->R[REG_NUM(i, 3)];
-	cpu->CPSR.bits.N = BIT31(tmp);
-	cpu->CPSR.bits.Z = (tmp == 0);
+	armcpu_setNZ(cpu, BIT31(tmp), (tmp == 0));
 	
 	return 1;
 }
@@ -524,10 +480,9 @@ TEMPLATE static  u32 FASTCALL OP_NEG(const u32 i)
 	
 	cpu->R[REG_NUM(i, 0)] = -((signed int)a);
 	
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
-	cpu->CPSR.bits.C = !UNSIGNED_UNDERFLOW((u32)0, a, cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.V = SIGNED_UNDERFLOW((u32)0, a, cpu->R[REG_NUM(i, 0)]);
+	armcpu_setNZCV(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0,
+		!UNSIGNED_UNDERFLOW((u32)0, a, cpu->R[REG_NUM(i, 0)]),
+		SIGNED_UNDERFLOW((u32)0, a, cpu->R[REG_NUM(i, 0)]));
 	
 	return 1;
 }
@@ -540,10 +495,9 @@ TEMPLATE static  u32 FASTCALL OP_CMN(const u32 i)
 {
 	u32 tmp = cpu->R[REG_NUM(i, 0)] + cpu->R[REG_NUM(i, 3)];
 
-	cpu->CPSR.bits.N = BIT31(tmp);
-	cpu->CPSR.bits.Z = tmp == 0;
-	cpu->CPSR.bits.C = UNSIGNED_OVERFLOW(cpu->R[REG_NUM(i, 0)], cpu->R[REG_NUM(i, 3)], tmp);
-	cpu->CPSR.bits.V = SIGNED_OVERFLOW(cpu->R[REG_NUM(i, 0)], cpu->R[REG_NUM(i, 3)], tmp);
+	armcpu_setNZCV(cpu, BIT31(tmp), tmp == 0,
+		UNSIGNED_OVERFLOW(cpu->R[REG_NUM(i, 0)], cpu->R[REG_NUM(i, 3)], tmp),
+		SIGNED_OVERFLOW(cpu->R[REG_NUM(i, 0)], cpu->R[REG_NUM(i, 3)], tmp));
 	
 	return 1;
 }
@@ -556,8 +510,7 @@ TEMPLATE static  u32 FASTCALL OP_ORR(const u32 i)
 {
 	cpu->R[REG_NUM(i, 0)] |= cpu->R[REG_NUM(i, 3)];
 
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = (cpu->R[REG_NUM(i, 0)] == 0);
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), (cpu->R[REG_NUM(i, 0)] == 0));
 	
 	return 1;
 }
@@ -570,8 +523,7 @@ TEMPLATE static  u32 FASTCALL OP_BIC(const u32 i)
 {
 	cpu->R[REG_NUM(i, 0)] &= (~cpu->R[REG_NUM(i, 3)]);
 	
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = (cpu->R[REG_NUM(i, 0)] == 0);
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), (cpu->R[REG_NUM(i, 0)] == 0));
 	
 	return 1;
 }
@@ -584,8 +536,7 @@ TEMPLATE static  u32 FASTCALL OP_MVN(const u32 i)
 {
 	cpu->R[REG_NUM(i, 0)] = (~cpu->R[REG_NUM(i, 3)]);
 	
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0);
 	
 	return 1;
 }
@@ -617,8 +568,7 @@ TEMPLATE static  u32 FASTCALL OP_MUL_REG(const u32 i)
 	//------ 
 	
 	cpu->R[REG_NUM(i, 0)] *= v;
-	cpu->CPSR.bits.N = BIT31(cpu->R[REG_NUM(i, 0)]);
-	cpu->CPSR.bits.Z = cpu->R[REG_NUM(i, 0)] == 0;
+	armcpu_setNZ(cpu, BIT31(cpu->R[REG_NUM(i, 0)]), cpu->R[REG_NUM(i, 0)] == 0);
 	//The MUL instruction is defined to leave the C flag unchanged in ARMv5 and above.
 	//In earlier versions of the architecture, the value of the C flag was UNPREDICTABLE
 	//after a MUL instruction.
@@ -947,6 +897,9 @@ TEMPLATE static  u32 FASTCALL OP_LDMIA_THUMB(const u32 i)
 	u32 c = 0, j;
 	u32 erList = 1; //Empty Register List
 
+	//Rb may be in the list; a data abort puts it back
+	if(PROCNUM==ARMCPU_ARM9) cpu->abortBase = adr;
+
 	//if (BIT_N(i, regIndex))
 	//	 printf("LDMIA with Rb in Rlist at %08X\n",cpu->instruct_adr);
 
@@ -0,0 +1,398 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "types.h"
+#include "armcpu.h"
+#include "MMU.h"
+#include "mem.h"
+#include "NDSSystem.h"
+#include "watch.h"
+
+#define PAGE_SHIFT 12
+#define PAGE_COUNT 0x10000
+#define PAGE_INDEX(addr) (((addr) >> PAGE_SHIFT) & (PAGE_COUNT-1))
+
+//which kinds of access are watched somewhere in each 4KB page. the top address nibble isn't part of the
+//index, so aliases of a watched page are flagged as well; the ranges sort those out
+static u8 pages[PAGE_COUNT];
+
+static WatchPoint watches[WATCH_MAX];
+static bool used[WATCH_MAX];
+static int count = 0;
+
+//a callback which touches watched memory itself doesn't hit again
+static bool inHit = false;
+
+static WatchJournalEntry *journal = NULL;
+static u32 journalHead = 0;
+static u32 journalCount = 0;
+static u32 journalDropped = 0;
+
+//--------------------------------------------------------------------------------
+//the accesses the inline shortcuts in MMU.h would have done
+
+static FORCEINLINE bool inDTCM(int PROCNUM, MMU_ACCESS_TYPE AT, u32 addr)
+{
+	//code isn't fetched from dtcm
+	return PROCNUM==ARMCPU_ARM9 && AT != MMU_AT_CODE && (addr&(~0x3FFF)) == MMU.DTCMRegion;
+}
+
+static FORCEINLINE bool inMainMem(u32 addr)
+{
+	return (addr & 0x0F000000) == 0x02000000;
+}
+
+static u32 rawRead(int PROCNUM, MMU_ACCESS_TYPE AT, u32 addr, int size)
+{
+	if(inDTCM(PROCNUM, AT, addr))
+	{
+		if(size == 1) return T1ReadByte(MMU.ARM9_DTCM, addr & 0x3FFF);
+		if(size == 2) return T1ReadWord_guaranteedAligned(MMU.ARM9_DTCM, addr & 0x3FFE);
+		return T1ReadLong_guaranteedAligned(MMU.ARM9_DTCM, addr & 0x3FFC);
+	}
+
+	if(inMainMem(addr))
+	{
+		if(size == 1) return T1ReadByte(MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK);
+		if(size == 2) return T1ReadWord_guaranteedAligned(MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK16);
+		return T1ReadLong_guaranteedAligned(MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK32);
+	}
+
+	if(PROCNUM==ARMCPU_ARM9)
+	{
+		if(size == 1) return _MMU_ARM9_read08(addr);
+		if(size == 2) return _MMU_ARM9_read16(addr);
+		return _MMU_ARM9_read32(addr);
+	}
+	if(size == 1) return _MMU_ARM7_read08(addr);
+	if(size == 2) return _MMU_ARM7_read16(addr);
+	return _MMU_ARM7_read32(addr);
+}
+
+static void rawWrite(int PROCNUM, MMU_ACCESS_TYPE AT, u32 addr, u32 val, int size)
+{
+	if(inDTCM(PROCNUM, AT, addr))
+	{
+		if(size == 1) T1WriteByte(MMU.ARM9_DTCM, addr & 0x3FFF, (u8)val);
+		else if(size == 2) T1WriteWord(MMU.ARM9_DTCM, addr & 0x3FFE, (u16)val);
+		else T1WriteLong(MMU.ARM9_DTCM, addr & 0x3FFC, val);
+		return;
+	}
+
+	if(inMainMem(addr))
+	{
+		if(size == 1) T1WriteByte(MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK, (u8)val);
+		else if(size == 2) T1WriteWord(MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK16, (u16)val);
+		else T1WriteLong(MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK32, val);
+		return;
+	}
+
+	if(PROCNUM==ARMCPU_ARM9)
+	{
+		if(size == 1) _MMU_ARM9_write08(addr, (u8)val);
+		else if(size == 2) _MMU_ARM9_write16(addr, (u16)val);
+		else _MMU_ARM9_write32(addr, val);
+	}
+	else
+	{
+		if(size == 1) _MMU_ARM7_write08(addr, (u8)val);
+		else if(size == 2) _MMU_ARM7_write16(addr, (u16)val);
+		else _MMU_ARM7_write32(addr, val);
+	}
+}
+
+//reading io registers and the gba slot can have side effects, so their old values aren't known
+static FORCEINLINE bool readable(u32 addr)
+{
+	const u32 region = (addr >> 24) & 0xF;
+	return region != 0x4 && (region < 0x8 || region > 0xA);
+}
+
+//--------------------------------------------------------------------------------
+
+static void journalAdd(const WatchAccess &access)
+{
+	if(!journal)
+	{
+		journal = (WatchJournalEntry*)malloc(sizeof(WatchJournalEntry)*WATCH_JOURNAL_SIZE);
+		if(!journal) return;
+	}
+
+	WatchJournalEntry &entry = journal[(journalHead + journalCount) % WATCH_JOURNAL_SIZE];
+	entry.access = access;
+	entry.timestamp = nds_timer;
+
+	if(journalCount < WATCH_JOURNAL_SIZE)
+		journalCount++;
+	else
+	{
+		journalHead = (journalHead + 1) % WATCH_JOURNAL_SIZE;
+		journalDropped++;
+	}
+}
+
+static void hit(int PROCNUM, MMU_ACCESS_TYPE AT, u8 kind, u32 addr, int size, u32 oldValue, u32 newValue, bool oldKnown)
+{
+	if(inHit) return;
+
+	//run-ahead's speculative frames are rolled back and run again for real, where the hit is reported
+	if(NDS_IsSpeculative()) return;
+
+	//mirrors of main memory are matched at 0x02000000
+	u32 match = addr;
+	if(!inDTCM(PROCNUM, AT, addr) && inMainMem(addr))
+		match = 0x02000000 | (addr & _MMU_MAIN_MEM_MASK);
+
+	WatchAccess access;
+	access.addr = addr;
+	access.oldValue = oldValue;
+	access.newValue = newValue;
+	access.pc = (kind == WATCH_EXEC) ? addr : (PROCNUM==ARMCPU_ARM9 ? NDS_ARM9.instruct_adr : NDS_ARM7.instruct_adr);
+	access.cpu = PROCNUM;
+	access.size = size;
+	access.kind = kind;
+	access.dma = AT == MMU_AT_DMA;
+
+	for(int i=0;i<WATCH_MAX;i++)
+	{
+		if(!used[i]) continue;
+		const WatchPoint &wp = watches[i];
+		if(!(wp.kinds & kind)) continue;
+		if(wp.cpuMask && !(wp.cpuMask & (1<<PROCNUM))) continue;
+		if(match >= wp.end || match + size <= wp.start) continue;
+		if((newValue & wp.condMask) != wp.condValue) continue;
+		if(wp.onlyChanges && oldKnown && oldValue == newValue) continue;
+
+		if(wp.journal)
+			journalAdd(access);
+		if(wp.callback)
+		{
+			inHit = true;
+			wp.callback(i, access, wp.param);
+			inHit = false;
+		}
+	}
+}
+
+u32 FASTCALL MMU_watchedRead(int PROCNUM, MMU_ACCESS_TYPE AT, u32 addr, int size)
+{
+	const u32 value = rawRead(PROCNUM, AT, addr, size);
+	const u8 kind = (AT == MMU_AT_CODE) ? WATCH_EXEC : WATCH_READ;
+	if(pages[PAGE_INDEX(addr)] & kind)
+		hit(PROCNUM, AT, kind, addr, size, value, value, true);
+	return value;
+}
+
+void FASTCALL MMU_watchedWrite(int PROCNUM, MMU_ACCESS_TYPE AT, u32 addr, u32 val, int size)
+{
+	if(pages[PAGE_INDEX(addr)] & WATCH_WRITE)
+	{
+		const bool oldKnown = readable(addr);
+		const u32 old = oldKnown ? rawRead(PROCNUM, AT, addr, size) : val;
+		hit(PROCNUM, AT, WATCH_WRITE, addr, size, old, val, oldKnown);
+	}
+	rawWrite(PROCNUM, AT, addr, val, size);
+}
+
+//--------------------------------------------------------------------------------
+
+static void markRange(u32 start, u32 end, u8 kinds)
+{
+	if(end - start >= (u32)PAGE_COUNT << PAGE_SHIFT)
+	{
+		for(int i=0;i<PAGE_COUNT;i++)
+			pages[i] |= kinds;
+		return;
+	}
+	for(u64 a = start & ~((1<<PAGE_SHIFT)-1); a < end; a += 1<<PAGE_SHIFT)
+		pages[PAGE_INDEX((u32)a)] |= kinds;
+}
+
+static void rebuildPages()
+{
+	memset(pages, 0, sizeof(pages));
+
+	const u32 mainSize = _MMU_MAIN_MEM_MASK + 1;
+	for(int i=0;i<WATCH_MAX;i++)
+	{
+		if(!used[i]) continue;
+		const WatchPoint &wp = watches[i];
+		markRange(wp.start, wp.end, wp.kinds);
+
+		//and the same part of every mirror of main memory
+		const u32 lo = std::max<u32>(wp.start, 0x02000000);
+		const u32 hi = std::min<u32>(wp.end, 0x02000000 + mainSize);
+		if(lo < hi)
+			for(u32 mirror = mainSize; mirror < 0x01000000; mirror += mainSize)
+				markRange(lo + mirror, hi + mirror, wp.kinds);
+	}
+}
+
+static bool watched(u32 start, u32 end)
+{
+	for(int i=0;i<WATCH_MAX;i++)
+		if(used[i] && watches[i].start < end && watches[i].end > start)
+			return true;
+	return false;
+}
+
+void MMU_updateFastRegions()
+{
+	_MMU_watchActive = count > 0;
+	if(!count)
+	{
+		_MMU_MAIN_MEM_REGION = 0x02000000;
+		_MMU_DTCM_REGION = MMU.DTCMRegion;
+		_MMU_ITCM_END = 0x02000000;
+		_MMU_ARM7_ERAM_REGION = 0x03800000;
+		_MMU_ARM7_SWIRAM_REGION = 0x03000000;
+		return;
+	}
+
+	rebuildPages();
+
+	//an address with bits set outside the compared mask never matches
+	const u32 never = 0xFFFFFFFF;
+	bool mainMem = watched(0x02000000, 0x03000000);
+	const bool dtcm = watched(MMU.DTCMRegion, MMU.DTCMRegion + 0x4000);
+	//dtcm lies on top of main memory; with its shortcut off, the main memory one would catch its accesses
+	if(dtcm && (MMU.DTCMRegion & 0x0F000000) == 0x02000000)
+		mainMem = true;
+
+	_MMU_MAIN_MEM_REGION = mainMem ? never : 0x02000000;
+	_MMU_DTCM_REGION = dtcm ? never : MMU.DTCMRegion;
+	_MMU_ITCM_END = watched(0, 0x02000000) ? 0 : 0x02000000;
+	_MMU_ARM7_ERAM_REGION = watched(0x03800000, 0x04000000) ? never : 0x03800000;
+	_MMU_ARM7_SWIRAM_REGION = watched(0x03000000, 0x03800000) ? never : 0x03000000;
+}
+
+//--------------------------------------------------------------------------------
+
+int Watch_Add(const WatchPoint &wp)
+{
+	if(wp.end <= wp.start || !wp.kinds) return -1;
+
+	for(int i=0;i<WATCH_MAX;i++)
+	{
+		if(used[i]) continue;
+		watches[i] = wp;
+		used[i] = true;
+		count++;
+		MMU_updateFastRegions();
+		return i;
+	}
+	return -1;
+}
+
+void Watch_Remove(int id)
+{
+	if(id < 0 || id >= WATCH_MAX || !used[id]) return;
+	used[id] = false;
+	count--;
+	MMU_updateFastRegions();
+}
+
+void Watch_Clear()
+{
+	memset(used, 0, sizeof(used));
+	count = 0;
+	MMU_updateFastRegions();
+}
+
+int Watch_Count()
+{
+	return count;
+}
+
+int Watch_LoadList(const char *fname)
+{
+	FILE *f = fopen(fname, "r");
+	if(!f) return -1;
+
+	int added = 0;
+	char line[256];
+	while(fgets(line, sizeof(line), f))
+	{
+		u32 start, end;
+		char kinds[8];
+		if(line[0] == ';' || sscanf(line, "%x %x %7s", &start, &end, kinds) != 3)
+			continue;
+
+		WatchPoint wp;
+		wp.start = start;
+		wp.end = end;
+		wp.journal = true;
+		for(const char *c = kinds; *c; c++)
+		{
+			if(*c == 'R' || *c == 'r') wp.kinds |= WATCH_READ;
+			if(*c == 'W' || *c == 'w') wp.kinds |= WATCH_WRITE;
+			if(*c == 'X' || *c == 'x') wp.kinds |= WATCH_EXEC;
+		}
+		if(Watch_Add(wp) >= 0)
+			added++;
+	}
+
+	fclose(f);
+	return added;
+}
+
+u32 Watch_JournalRead(WatchJournalEntry *out, u32 max)
+{
+	u32 n = 0;
+	for(;n<max && journalCount;n++)
+	{
+		out[n] = journal[journalHead];
+		journalHead = (journalHead + 1) % WATCH_JOURNAL_SIZE;
+		journalCount--;
+	}
+	return n;
+}
+
+u32 Watch_JournalDropped()
+{
+	return journalDropped;
+}
+
+bool Watch_JournalSave(const char *fname)
+{
+	FILE *f = fopen(fname, "w");
+	if(!f) return false;
+
+	static const char kindNames[] = "?RW?X";
+	if(journalDropped)
+		fprintf(f, "; %u older entries were overwritten\n", journalDropped);
+
+	WatchJournalEntry entry;
+	while(Watch_JournalRead(&entry, 1))
+	{
+		const WatchAccess &a = entry.access;
+		fprintf(f, "%llu %s%s pc=%08X %c%d %08X %08X -> %08X\n",
+			(unsigned long long)entry.timestamp, a.cpu ? "ARM7" : "ARM9", a.dma ? " dma" : "",
+			a.pc, kindNames[a.kind], a.size*8, a.addr, a.oldValue, a.newValue);
+	}
+	journalDropped = 0;
+
+	fclose(f);
+	return true;
+}
@@ -0,0 +1,103 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef _WATCH_H_
+#define _WATCH_H_
+
+#include "types.h"
+
+//memory watchpoints.
+//guest memory is split into 4KB pages with a flag byte each, saying which kinds of access are watched
+//there. the table is only looked at on the MMU's cold path: while a region (main memory, dtcm, itcm,
+//the arm7 wram) holds a watchpoint, its inline shortcut in MMU.h is switched off, so accesses there
+//take the cold path and pay for the lookup. with no watchpoints set, nothing is added anywhere.
+//
+//main memory mirrors are folded onto 0x02000000, so watch main memory through that range.
+//a write hit happens before the write and can see the old value; read and exec hits see the value read
+
+#define WATCH_READ   1
+#define WATCH_WRITE  2
+#define WATCH_EXEC   4
+
+#define WATCH_MAX 32
+
+//ring of the last hits of watchpoints with journal set; older entries are overwritten
+#define WATCH_JOURNAL_SIZE 4096
+
+struct WatchAccess
+{
+	u32 addr;
+	u32 oldValue;   //for writes to memory, the value being overwritten. otherwise the same as newValue
+	u32 newValue;   //the value written, read or fetched
+	u32 pc;         //the instruction doing the access
+	u8 cpu;         //ARMCPU_ARM9 or ARMCPU_ARM7
+	u8 size;        //1, 2 or 4
+	u8 kind;        //one of WATCH_READ, WATCH_WRITE or WATCH_EXEC
+	u8 dma;         //done by a dma rather than the cpu
+};
+
+struct WatchJournalEntry
+{
+	WatchAccess access;
+	u64 timestamp;  //nds_timer
+};
+
+typedef void (*WatchCallback)(int id, const WatchAccess &access, void *param);
+
+struct WatchPoint
+{
+	u32 start;
+	u32 end;           //exclusive
+	u8 kinds;          //WATCH_READ | WATCH_WRITE | WATCH_EXEC
+	u8 cpuMask;        //bit 0 for the arm9, bit 1 for the arm7. 0 is both
+	bool journal;      //record hits in the journal
+	u32 condMask;      //only hits where (newValue & condMask) == condValue count. 0 lets everything through
+	u32 condValue;
+	bool onlyChanges;  //writes which store the value already there don't count
+	WatchCallback callback;  //may be NULL
+	void *param;
+
+	WatchPoint()
+		: start(0), end(0), kinds(0), cpuMask(0), journal(false)
+		, condMask(0), condValue(0), onlyChanges(false)
+		, callback(NULL), param(NULL)
+	{}
+};
+
+//returns the id of the new watchpoint, or -1 when all are in use or the range is empty
+int Watch_Add(const WatchPoint &wp);
+void Watch_Remove(int id);
+void Watch_Clear();
+int Watch_Count();
+
+//adds the journaled watchpoints listed in a text file, one per line: start end kinds, e.g.
+//  02001000 02001004 W
+//  0200F000 0200F100 RWX
+//addresses are hex, end is exclusive. lines starting with ; are skipped.
+//returns how many were added, or -1 when the file can't be opened
+int Watch_LoadList(const char *fname);
+
+//copies out up to max journal entries, oldest first, and removes them from the journal
+u32 Watch_JournalRead(WatchJournalEntry *out, u32 max);
+//entries overwritten before they were read
+u32 Watch_JournalDropped();
+//writes the journal as text and empties it
+bool Watch_JournalSave(const char *fname);
+
+#endif
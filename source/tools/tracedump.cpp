@@ -0,0 +1,195 @@
+/*  Copyright (C) 2012 DeSmuMEWii team
+
+    This file is part of DeSmuMEWii
+
+    DeSmuMEWii is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    DeSmuMEWii is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with DeSmuMEWii; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+//offline decoder for the traces written by cputrace.cpp. built on the pc, e.g.
+//  g++ -O2 -I../src -o tracedump tracedump.cpp ../src/Disassembler.cpp
+//usage: tracedump [-d] [-c 7|9] [-f first] [-l last] trace.trc
+//  -d  disassemble each instruction
+//  -c  only show one cpu
+//  -f/-l  only show the given range of frames
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "types.h"
+#include "Disassembler.h"
+#include "cputrace.h"
+
+#define INSTRUCTION_INDEX(i) ((((i)>>16)&0xFF0)|(((i)>>4)&0xF))
+
+static bool swapBytes = false;
+
+static u32 swap32(u32 v)
+{
+	return (v>>24) | ((v>>8)&0xFF00) | ((v<<8)&0xFF0000) | (v<<24);
+}
+
+static bool readRecord(FILE *fp, CpuTraceRecord &rec)
+{
+	if(fread(&rec, sizeof(rec), 1, fp) != 1)
+		return false;
+	if(swapBytes)
+	{
+		rec.mask = (u16)((rec.mask>>8) | (rec.mask<<8));
+		for(int i=0;i<7;i++)
+			rec.data[i] = swap32(rec.data[i]);
+	}
+	return true;
+}
+
+static void usage()
+{
+	fprintf(stderr, "usage: tracedump [-d] [-c 7|9] [-f first] [-l last] trace.trc\n");
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	bool disasm = false;
+	int onlyCpu = -1;
+	u32 firstFrame = 0, lastFrame = 0xFFFFFFFF;
+	const char *fname = NULL;
+
+	for(int i=1;i<argc;i++)
+	{
+		if(!strcmp(argv[i],"-d")) disasm = true;
+		else if(!strcmp(argv[i],"-c") && i+1<argc) onlyCpu = (atoi(argv[++i]) == 7) ? 1 : 0;
+		else if(!strcmp(argv[i],"-f") && i+1<argc) firstFrame = strtoul(argv[++i],NULL,0);
+		else if(!strcmp(argv[i],"-l") && i+1<argc) lastFrame = strtoul(argv[++i],NULL,0);
+		else if(argv[i][0] != '-') fname = argv[i];
+		else usage();
+	}
+	if(!fname) usage();
+
+	FILE *fp = fopen(fname, "rb");
+	if(!fp)
+	{
+		fprintf(stderr, "can't open %s\n", fname);
+		return 1;
+	}
+
+	CpuTraceHeader header;
+	if(fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, CPUTRACE_MAGIC, 8))
+	{
+		fprintf(stderr, "%s is not a cpu trace\n", fname);
+		return 1;
+	}
+	swapBytes = header.endian != CPUTRACE_ENDIAN;
+	if(swapBytes)
+	{
+		header.version = swap32(header.version);
+		header.recordSize = swap32(header.recordSize);
+	}
+	if(header.version != CPUTRACE_VERSION || header.recordSize != sizeof(CpuTraceRecord))
+	{
+		fprintf(stderr, "unsupported trace version %u\n", header.version);
+		return 1;
+	}
+
+	//register files rebuilt from the deltas
+	u32 regs[2][15];
+	memset(regs, 0, sizeof(regs));
+	u32 frame = 0;
+	//the cpus run ahead of each other in turns, so each one unwraps its own stamps
+	u64 timerBase[2] = { 0, 0 };
+	u32 lastCycle[2] = { 0, 0 };
+
+	CpuTraceRecord rec;
+	while(readRecord(fp, rec))
+	{
+		const bool show = frame >= firstFrame && frame <= lastFrame;
+
+		switch(rec.kind)
+		{
+		case CPUTRACE_FRAME:
+			if(show) printf("---- frame %u ends, timer %llu\n", rec.data[0], (unsigned long long)(((u64)rec.data[2]<<32) | rec.data[1]));
+			frame = rec.data[0] + 1;
+			for(int c=0;c<2;c++)
+			{
+				timerBase[c] = ((u64)rec.data[2]<<32) | rec.data[1];
+				lastCycle[c] = rec.data[1];
+			}
+			break;
+
+		case CPUTRACE_WATCH:
+			if(show) printf("---- watch %08X: %08X -> %08X\n", rec.data[0], rec.data[1], rec.data[2]);
+			break;
+
+		case CPUTRACE_EXEC:
+		{
+			const int cpu = rec.cpu & 1;
+			const u32 pc = rec.data[0];
+			const u32 opcode = rec.data[1];
+			const u32 cpsr = rec.data[2];
+			const bool thumb = (cpsr & 0x20) != 0;
+
+			//the cycle stamp only keeps the low half. frame markers give the high half back
+			if(rec.data[3] < lastCycle[cpu]) timerBase[cpu] += 0x100000000ULL;
+			lastCycle[cpu] = rec.data[3];
+			const u64 cycle = (timerBase[cpu] & ~0xFFFFFFFFULL) | rec.data[3];
+
+			//apply the deltas, including the ones carried by the following REGS records
+			u16 pending = rec.mask;
+			int taken = 0;
+			for(int r=0;r<15 && taken<3;r++)
+				if(pending & (1<<r)) { regs[cpu][r] = rec.data[4+taken++]; pending &= ~(1<<r); }
+			while(pending)
+			{
+				CpuTraceRecord more;
+				if(!readRecord(fp, more) || more.kind != CPUTRACE_REGS)
+				{
+					fprintf(stderr, "truncated trace\n");
+					return 1;
+				}
+				int n = 0;
+				for(int r=0;r<15;r++)
+					if(more.mask & (1<<r)) { regs[cpu][r] = more.data[n++]; pending &= ~(1<<r); }
+			}
+
+			if(!show || (onlyCpu >= 0 && onlyCpu != cpu))
+				break;
+
+			printf("%05u %12llu %d:%08X %0*X", frame, (unsigned long long)cycle, cpu ? 7 : 9, pc, thumb ? 4 : 8, opcode);
+			if(disasm)
+			{
+				char txt[256];
+				txt[0] = 0;
+				if(thumb)
+					des_thumb_instructions_set[(opcode>>6)&1023](pc, opcode, txt);
+				else
+					des_arm_instructions_set[INSTRUCTION_INDEX(opcode)](pc, opcode, txt);
+				printf(" %-30s", txt);
+			}
+			printf(" CPSR:%08X", cpsr);
+			for(int r=0;r<15;r++)
+				if(rec.mask & (1<<r)) printf(" R%02d:%08X", r, regs[cpu][r]);
+			printf("\n");
+			break;
+		}
+
+		default:
+			fprintf(stderr, "unknown record kind %d\n", rec.kind);
+			return 1;
+		}
+	}
+
+	fclose(fp);
+	return 0;
+}